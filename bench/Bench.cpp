@@ -0,0 +1,44 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "Bench.h"
+
+#include <fmt/core.h>
+#include <string>
+#include <vector>
+
+namespace bxt::Bench {
+
+std::vector<Benchmark>& registry() {
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+} // namespace bxt::Bench
+
+int main(int argc, char** argv) {
+    auto const& benchmarks = bxt::Bench::registry();
+
+    if (argc < 2) {
+        fmt::print("Usage: {} <benchmark> [arguments]\n\nBenchmarks:\n", argv[0]);
+        for (auto const& benchmark : benchmarks) {
+            fmt::print("  {} {}\n", benchmark.name, benchmark.usage);
+        }
+        return 1;
+    }
+
+    std::string_view const name = argv[1];
+    std::vector<std::string> const arguments(argv + 2, argv + argc);
+
+    for (auto const& benchmark : benchmarks) {
+        if (benchmark.name == name) {
+            return benchmark.run(arguments);
+        }
+    }
+
+    fmt::print(stderr, "Unknown benchmark \"{}\"\n", name);
+    return 1;
+}
@@ -0,0 +1,84 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <fmt/format.h>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace bxt::Bench {
+
+using Arguments = std::span<std::string const>;
+
+struct Benchmark {
+    std::string name;
+    std::string usage;
+    std::function<int(Arguments)> run;
+};
+
+std::vector<Benchmark>& registry();
+
+// Benchmarks register themselves from a static instance in their translation unit
+struct Registration {
+    Registration(std::string name, std::string usage, std::function<int(Arguments)> run) {
+        registry().emplace_back(std::move(name), std::move(usage), std::move(run));
+    }
+};
+
+struct Measurement {
+    std::chrono::nanoseconds elapsed {0};
+    size_t items = 0;
+
+    double items_per_second() const {
+        return elapsed.count() == 0 ? 0.0
+                                    : static_cast<double>(items) * 1e9
+                                          / static_cast<double>(elapsed.count());
+    }
+
+    double microseconds_per_item() const {
+        return items == 0 ? 0.0 : static_cast<double>(elapsed.count()) / 1e3 / items;
+    }
+};
+
+// Runs the body once to warm up and then the given number of rounds, the fastest
+// round is reported. The body gets the round number so it can use fresh state.
+template<typename TBody> Measurement measure(size_t rounds, size_t items, TBody&& body) {
+    body(size_t {0});
+
+    Measurement best {.elapsed = std::chrono::nanoseconds::max(), .items = items};
+    for (size_t round = 1; round <= std::max<size_t>(rounds, 1); ++round) {
+        auto const started_at = std::chrono::steady_clock::now();
+        body(round);
+        best.elapsed = std::min<std::chrono::nanoseconds>(
+            best.elapsed, std::chrono::steady_clock::now() - started_at);
+    }
+
+    return best;
+}
+
+inline void report(std::string_view label, Measurement const& measurement) {
+    fmt::print("{:<40} {:>12.3f} ms {:>14.1f} items/s {:>12.3f} us/item\n", label,
+               static_cast<double>(measurement.elapsed.count()) / 1e6,
+               measurement.items_per_second(), measurement.microseconds_per_item());
+}
+
+// Positional argument with a default, for "count" style parameters
+inline size_t argument(Arguments arguments, size_t position, size_t fallback) {
+    if (position >= arguments.size()) {
+        return fallback;
+    }
+    return std::stoull(arguments[position]);
+}
+
+} // namespace bxt::Bench
@@ -0,0 +1,108 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "Bench.h"
+#include "Fixtures.h"
+#include "persistence/box/BoxOptions.h"
+#include "persistence/box/export/AlpmDBExporter.h"
+#include "persistence/box/store/LMDBPackageStore.h"
+#include "persistence/lmdb/LmdbUnitOfWork.h"
+
+#include <algorithm>
+#include <chrono>
+#include <coro/sync_wait.hpp>
+#include <ctime>
+#include <filesystem>
+#include <fmt/core.h>
+#include <ranges>
+#include <stdexcept>
+#include <vector>
+
+namespace bxt::Bench {
+namespace {
+
+    // CPU time of all threads, the export runs on its pools
+    std::chrono::nanoseconds process_cpu_time() {
+        timespec time {};
+        ::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+        return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+    }
+
+    // Exports one section of the given size from a store snapshot: the records are
+    // read, the databases written and compressed, the links placed. Fails when the
+    // CPU time per package exceeds the budget.
+    int export_section(Arguments arguments) {
+        auto const packages = argument(arguments, 0, 10'000);
+        auto const budget = std::chrono::microseconds(argument(arguments, 1, 100));
+        auto const rounds = argument(arguments, 2, 3);
+
+        TemporaryDirectory directory;
+        auto environment = open_environment(directory.path());
+
+        Core::Application::PackageSectionDTO const section {
+            .branch = "stable", .repository = "core", .architecture = "x86_64"};
+        Sections sections({section});
+        Pool pool;
+        // Recompression would run after the measured export
+        Persistence::Box::BoxOptions box_options {.box_path = directory.path() / "box",
+                                                  .export_recompress_level = 0};
+        Persistence::LmdbUnitOfWorkFactory uow_factory(environment);
+
+        Persistence::Box::LMDBPackageStore store(box_options, environment, pool, sections,
+                                                 "bench::export");
+        if (auto prepared = store.prepare(); !prepared) {
+            throw std::runtime_error(prepared.error().what());
+        }
+
+        auto const records = std::views::iota(size_t {0}, packages)
+                             | std::views::transform([&](size_t index) {
+                                   return make_record(section, box_options.box_path / "pool",
+                                                      index);
+                               })
+                             | std::ranges::to<std::vector>();
+
+        coro::sync_wait([&]() -> coro::task<void> {
+            auto uow = co_await uow_factory(true);
+            if (auto added = co_await store.add(records, uow); !added.has_value()) {
+                throw std::runtime_error(added.error().what());
+            }
+            co_await uow->commit_async();
+        }());
+
+        Persistence::Box::AlpmDBExporter exporter(box_options, store, sections, uow_factory);
+
+        // Unchanged contents are kept by their digest, every round has to write
+        auto const digest_path = box_options.box_path / std::string(section)
+                                 / fmt::format(".{}.db.tar.zst.digest", section.repository);
+
+        auto cpu_time = std::chrono::nanoseconds::max();
+
+        auto const measurement = measure(rounds, packages, [&](size_t) {
+            std::filesystem::remove(digest_path);
+            exporter.add_dirty_sections({section});
+
+            auto const started = process_cpu_time();
+            if (!coro::sync_wait(exporter.export_to_disk({section}))) {
+                throw std::runtime_error("The export failed");
+            }
+            cpu_time = std::min(cpu_time, process_cpu_time() - started);
+        });
+
+        auto const per_package = std::chrono::duration<double, std::micro>(cpu_time) / packages;
+
+        fmt::print("{} packages in one section, best of {} rounds\n", packages, rounds);
+        report("export, wall time", measurement);
+        fmt::print("{:<40} {:>12.3f} us/package, budget {} us\n", "export, CPU time of all threads",
+                   per_package.count(), budget.count());
+
+        return per_package <= budget ? 0 : 1;
+    }
+
+    Registration const registration {"export", "[packages=10000] [budget-us=100] [rounds=3]",
+                                     export_section};
+
+} // namespace
+} // namespace bxt::Bench
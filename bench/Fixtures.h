@@ -0,0 +1,183 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "core/application/dtos/PackageSectionDTO.h"
+#include "core/domain/entities/Section.h"
+#include "core/domain/repositories/ReadOnlyRepositoryBase.h"
+#include "persistence/box/pool/PoolBase.h"
+#include "persistence/box/record/PackageRecord.h"
+#include "utilities/lmdb/Environment.h"
+#include "utilities/lmdb/LMDBOptions.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <filesystem>
+#include <fmt/format.h>
+#include <memory>
+#include <ranges>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace bxt::Bench {
+
+// Scratch directory removed with everything in it when the benchmark ends
+class TemporaryDirectory {
+public:
+    explicit TemporaryDirectory(
+        std::filesystem::path const& parent = std::filesystem::temp_directory_path()) {
+        auto pattern = (parent / "bxt-bench.XXXXXX").string();
+        if (::mkdtemp(pattern.data()) == nullptr) {
+            throw std::filesystem::filesystem_error(
+                "Can't create a scratch directory", pattern,
+                std::error_code(errno, std::system_category()));
+        }
+        m_path = pattern;
+    }
+
+    ~TemporaryDirectory() {
+        std::error_code ec;
+        std::filesystem::remove_all(m_path, ec);
+    }
+
+    TemporaryDirectory(TemporaryDirectory const&) = delete;
+    TemporaryDirectory& operator=(TemporaryDirectory const&) = delete;
+
+    std::filesystem::path const& path() const {
+        return m_path;
+    }
+
+private:
+    std::filesystem::path m_path;
+};
+
+// Sections come from box.yml in the daemon, here they're fixed
+class Sections : public Core::Domain::ReadOnlyRepositoryBase<Core::Domain::Section> {
+    using Section = Core::Domain::Section;
+
+public:
+    explicit Sections(std::vector<Core::Application::PackageSectionDTO> sections)
+        : m_sections(std::move(sections)) {
+    }
+
+    coro::task<TResult> find_by_id_async(TId id,
+                                         std::shared_ptr<Core::Domain::UnitOfWorkBase>) override {
+        for (auto const& section : m_sections) {
+            if (std::string(section) == id) {
+                co_return Core::Application::SectionDTOMapper::to_entity(section);
+            }
+        }
+        co_return bxt::make_error<Core::Domain::ReadError>(
+            Core::Domain::ReadError::EntityNotFound);
+    }
+
+    coro::task<TResult> find_first_async(std::function<bool(Section const&)> condition,
+                                         std::shared_ptr<Core::Domain::UnitOfWorkBase>) override {
+        for (auto const& section : m_sections) {
+            auto entity = Core::Application::SectionDTOMapper::to_entity(section);
+            if (condition(entity)) {
+                co_return entity;
+            }
+        }
+        co_return bxt::make_error<Core::Domain::ReadError>(
+            Core::Domain::ReadError::EntityNotFound);
+    }
+
+    coro::task<TResults> find_async(std::function<bool(Section const&)> condition,
+                                    std::shared_ptr<Core::Domain::UnitOfWorkBase>) override {
+        std::vector<Section> result;
+        for (auto const& section : m_sections) {
+            auto entity = Core::Application::SectionDTOMapper::to_entity(section);
+            if (condition(entity)) {
+                result.emplace_back(std::move(entity));
+            }
+        }
+        co_return result;
+    }
+
+    coro::task<TResults> all_async(std::shared_ptr<Core::Domain::UnitOfWorkBase>) override {
+        co_return m_sections
+            | std::views::transform(Core::Application::SectionDTOMapper::to_entity)
+            | std::ranges::to<std::vector>();
+    }
+
+private:
+    std::vector<Core::Application::PackageSectionDTO> m_sections;
+};
+
+// Records point at files that don't exist, nothing is moved
+struct Pool : public Persistence::Box::PoolBase {
+    Result<Persistence::Box::PackageRecord>
+        move_to(Persistence::Box::PackageRecord const& package) override {
+        return package;
+    }
+
+    Result<void> remove(Persistence::Box::PackageRecord const&) override {
+        return {};
+    }
+
+    Result<void> restore(Persistence::Box::PackageRecord const&,
+                         Persistence::Box::PackageRecord const&) override {
+        return {};
+    }
+
+    Result<Persistence::Box::PackageRecord>
+        path_for_package(Persistence::Box::PackageRecord const& package) const override {
+        return package;
+    }
+};
+
+inline std::shared_ptr<Utilities::LMDB::Environment>
+    open_environment(std::filesystem::path const& directory,
+                     Utilities::LMDB::LMDBOptions options = {}) {
+    options.lmdb_path = directory / "bxtd.lmdb";
+    options.map_size = 1024;
+    // Benchmarks open a fresh set of databases per round
+    options.max_dbs = 1024;
+    std::filesystem::create_directories(options.lmdb_path);
+
+    auto environment = std::make_shared<Utilities::LMDB::Environment>();
+    environment->open(options);
+    return environment;
+}
+
+// A record shaped like a mid-sized Arch package: a full desc and a file list of
+// the given length
+inline Persistence::Box::PackageRecord make_record(Core::Application::PackageSectionDTO section,
+                                                   std::filesystem::path const& pool_path,
+                                                   size_t index,
+                                                   size_t files = 64) {
+    auto const name = fmt::format("package-{:06}", index);
+    auto const filename = fmt::format("{}-1.{}-1-x86_64.pkg.tar.zst", name, index % 100);
+
+    auto desc = fmt::format(
+        "%FILENAME%\n{0}\n\n%NAME%\n{1}\n\n%BASE%\n{1}\n\n%VERSION%\n1.{2}-1\n\n"
+        "%DESC%\nSynthetic package used by the benchmarks\n\n%CSIZE%\n{3}\n\n"
+        "%ISIZE%\n{4}\n\n%MD5SUM%\n{5:032x}\n\n%SHA256SUM%\n{5:064x}\n\n"
+        "%PGPSIG%\niQIzBAABCAAdFiEE{5:032x}\n\n%URL%\nhttps://example.org/{1}\n\n"
+        "%LICENSE%\nGPL-3.0-or-later\n\n%ARCH%\nx86_64\n\n%BUILDDATE%\n1700000000\n\n"
+        "%PACKAGER%\nBench <bench@example.org>\n\n%DEPENDS%\nglibc\ngcc-libs\nzlib\n"
+        "openssl\n\n%MAKEDEPENDS%\ncmake\nninja\n\n",
+        filename, name, index % 100, 1'000'000 + index, 4'000'000 + index, index + 1);
+
+    std::string file_list;
+    for (size_t file = 0; file < files; ++file) {
+        file_list += fmt::format("usr/share/{}/data/file-{:04}.dat\n", name, file);
+    }
+
+    Persistence::Box::PackageRecord record {.id = {.section = section, .name = name}};
+
+    auto& description = record.descriptions[Core::Domain::PoolLocation::Sync];
+    description.filepath = pool_path / filename;
+    description.descfile = Utilities::AlpmDb::Desc(std::move(desc), std::move(file_list));
+    description.extract_fields();
+
+    return record;
+}
+
+} // namespace bxt::Bench
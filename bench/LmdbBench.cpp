@@ -0,0 +1,161 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "Bench.h"
+#include "Fixtures.h"
+#include "utilities/lmdb/Environment.h"
+#include "utilities/lmdb/LMDBOptions.h"
+
+#include <chrono>
+#include <coro/sync_wait.hpp>
+#include <filesystem>
+#include <fmt/core.h>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace bxt::Bench {
+namespace {
+
+    struct Mode {
+        std::string_view name;
+        Utilities::LMDB::LMDBOptions options;
+    };
+
+    std::vector<Mode> modes() {
+        Utilities::LMDB::LMDBOptions no_meta_sync;
+        no_meta_sync.no_meta_sync = true;
+
+        Utilities::LMDB::LMDBOptions no_sync;
+        no_sync.no_sync = true;
+
+        Utilities::LMDB::LMDBOptions write_map;
+        write_map.write_map = true;
+
+        Utilities::LMDB::LMDBOptions write_map_no_sync = write_map;
+        write_map_no_sync.no_sync = true;
+
+        return {{"default", {}},
+                {"lmdb-no-meta-sync", no_meta_sync},
+                {"lmdb-no-sync", no_sync},
+                {"lmdb-write-map", write_map},
+                {"lmdb-write-map + lmdb-no-sync", write_map_no_sync}};
+    }
+
+    // Commits one small write per txn, the way a single package update does. The
+    // database is created in the given directory so the disk under test can be
+    // chosen, the system temp directory is often in memory.
+    int lmdb_commit(Arguments arguments) {
+        auto const commits = argument(arguments, 0, 1000);
+        auto const value_size = argument(arguments, 1, 1024);
+        auto const rounds = argument(arguments, 2, 3);
+
+        std::optional<TemporaryDirectory> directory;
+        if (arguments.size() > 3) {
+            directory.emplace(arguments[3]);
+        } else {
+            directory.emplace();
+        }
+
+        std::string const value(value_size, 'x');
+
+        fmt::print("{} commits of a {} byte value in {}, best of {} rounds\n", commits,
+                   value_size, directory->path().string(), rounds);
+
+        for (auto const& mode : modes()) {
+            auto environment =
+                open_environment(directory->path() / mode.name, mode.options);
+
+            MDB_dbi dbi = 0;
+            {
+                auto txn = coro::sync_wait(environment->begin_rw_txn());
+                dbi = lmdb::dbi::open(txn->value, "bench", MDB_CREATE).handle();
+                environment->commit(txn->value);
+            }
+
+            report(mode.name, measure(rounds, commits, [&](size_t round) {
+                       for (size_t commit = 0; commit < commits; ++commit) {
+                           auto txn = coro::sync_wait(environment->begin_rw_txn());
+                           environment->put(txn->value, dbi,
+                                            fmt::format("{}:{:08}", round, commit), value);
+                           environment->commit(txn->value);
+                       }
+                   }));
+        }
+
+        return 0;
+    }
+
+    Registration const registration {
+        "lmdb-commit", "[commits=1000] [value-size=1024] [rounds=3] [directory]", lmdb_commit};
+
+    // Fills a 1 MiB map while a reader holds its snapshot on another thread, as
+    // an export does. The write has to wait for the reader and grow the map, the
+    // check fails if the write fails instead.
+    int lmdb_grow(Arguments arguments) {
+        auto const hold = std::chrono::milliseconds(argument(arguments, 0, 500));
+        auto const megabytes = argument(arguments, 1, 4);
+
+        TemporaryDirectory directory;
+
+        Utilities::LMDB::LMDBOptions options;
+        options.lmdb_path = directory.path() / "bxtd.lmdb";
+        options.map_size = 1;
+        options.map_growth = 1;
+        std::filesystem::create_directories(options.lmdb_path);
+
+        auto environment = std::make_shared<Utilities::LMDB::Environment>();
+        environment->open(options);
+
+        MDB_dbi dbi = 0;
+        {
+            auto txn = coro::sync_wait(environment->begin_rw_txn());
+            dbi = lmdb::dbi::open(txn->value, "bench", MDB_CREATE).handle();
+            environment->commit(txn->value);
+        }
+
+        auto reader = coro::sync_wait(environment->begin_ro_txn());
+        std::thread releaser([&environment, &reader, hold] {
+            std::this_thread::sleep_for(hold);
+            environment->release_ro_txn(std::move(reader->value));
+        });
+
+        std::string const value(64 * 1024, 'x');
+        auto const started_at = std::chrono::steady_clock::now();
+
+        bool written = true;
+        try {
+            auto txn = coro::sync_wait(environment->begin_rw_txn());
+            for (size_t index = 0; index < megabytes * 16; ++index) {
+                environment->put(txn->value, dbi, fmt::format("{:08}", index), value);
+            }
+            environment->commit(txn->value);
+        } catch (lmdb::error const& error) {
+            fmt::print(stderr, "The write failed: {}\n", error.what());
+            written = false;
+        }
+
+        auto const elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - started_at);
+        releaser.join();
+
+        if (!written) {
+            return 1;
+        }
+
+        fmt::print("{} MiB written into a 1 MiB map in {} ms, the reader held it for {} ms\n",
+                   megabytes, elapsed.count(), hold.count());
+        return 0;
+    }
+
+    Registration const grow_registration {"lmdb-grow", "[hold-ms=500] [megabytes=4]",
+                                          lmdb_grow};
+
+} // namespace
+} // namespace bxt::Bench
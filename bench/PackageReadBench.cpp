@@ -0,0 +1,129 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "Bench.h"
+#include "utilities/alpmdb/Desc.h"
+#include "utilities/alpmdb/DescFormatter.h"
+#include "utilities/alpmdb/PkgInfo.h"
+#include "utilities/hash_from_file.h"
+#include "utilities/libarchive/Reader.h"
+
+#include <archive.h>
+#include <archive_entry.h>
+#include <cstdint>
+#include <filesystem>
+#include <fmt/core.h>
+#include <openssl/md5.h>
+#include <openssl/sha.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace bxt::Bench {
+namespace {
+
+    using namespace Utilities::AlpmDb;
+
+    // The path before the single-pass reader: libarchive reads the package for
+    // the .PKGINFO and the file list, then the file is mapped once per checksum.
+    // Returns the desc, the file list is built for the same work as parse_package.
+    std::string read_in_three_passes(std::filesystem::path const& path) {
+        Archive::Reader reader;
+
+        archive_read_support_filter_all(reader);
+        archive_read_support_format_all(reader);
+
+        if (!reader.open_filename(path)) {
+            throw std::runtime_error(fmt::format("Can't open \"{}\"", path.string()));
+        }
+
+        PkgInfo package_info;
+        std::ostringstream files;
+
+        for (auto& [header, entry] : reader) {
+            if (!header) {
+                continue;
+            }
+            std::string pathname = archive_entry_pathname(*header);
+
+            if (!pathname.ends_with(".PKGINFO") && !pathname.starts_with("/.")) {
+                files << pathname << "\n";
+                continue;
+            }
+
+            auto contents = entry.read_all();
+            if (!contents.has_value()) {
+                throw std::runtime_error(fmt::format("Can't read \"{}\"", path.string()));
+            }
+
+            package_info.parse(
+                std::string_view {reinterpret_cast<char*>(contents->data()), contents->size()});
+        }
+
+        DescFormatter formatter {
+            std::move(package_info), path, "",
+            PackageDigest {.size = std::filesystem::file_size(path),
+                           .md5 = hash_from_file<MD5, MD5_DIGEST_LENGTH>(path),
+                           .sha256 = hash_from_file<SHA256, SHA256_DIGEST_LENGTH>(path)}};
+
+        return formatter.format();
+    }
+
+    std::string read_in_one_pass(std::filesystem::path const& path) {
+        auto desc = Desc::parse_package(path);
+        if (!desc.has_value()) {
+            throw std::runtime_error(
+                fmt::format("Can't read \"{}\": {}", path.string(), desc.error().what()));
+        }
+
+        return desc->desc();
+    }
+
+    // Reads real packages both ways. Both produce the same desc, which is checked
+    // before measuring. The packages are in the page cache after the warm-up
+    // round, so this compares the work per byte rather than the disk.
+    int package_read(Arguments arguments) {
+        if (arguments.size() < 2) {
+            fmt::print(stderr, "Pass the number of rounds and at least one package\n");
+            return 1;
+        }
+
+        auto const rounds = argument(arguments, 0, 3);
+        std::vector<std::filesystem::path> const packages(arguments.begin() + 1,
+                                                          arguments.end());
+
+        uintmax_t bytes = 0;
+        for (auto const& package : packages) {
+            if (read_in_three_passes(package) != read_in_one_pass(package)) {
+                fmt::print(stderr, "The desc of \"{}\" differs between the paths\n",
+                           package.string());
+                return 1;
+            }
+            bytes += std::filesystem::file_size(package);
+        }
+
+        auto const read_all = [&packages](auto read) {
+            return [&packages, read](size_t) {
+                for (auto const& package : packages) {
+                    read(package);
+                }
+            };
+        };
+
+        fmt::print("{} packages, {} MiB, best of {} rounds\n", packages.size(),
+                   bytes / 1024 / 1024, rounds);
+        report("libarchive + MD5 + SHA256 passes",
+               measure(rounds, packages.size(), read_all(read_in_three_passes)));
+        report("single pass", measure(rounds, packages.size(), read_all(read_in_one_pass)));
+
+        return 0;
+    }
+
+    Registration const registration {"package-read", "<rounds> <package>...", package_read};
+
+} // namespace
+} // namespace bxt::Bench
@@ -0,0 +1,119 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "Bench.h"
+#include "utilities/alpmdb/DescFormatter.h"
+#include "utilities/alpmdb/PkgInfo.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace bxt::Bench {
+namespace {
+
+    // Counted by the replaced operator new below, for the whole program
+    std::atomic<size_t> allocations = 0;
+
+    using namespace Utilities::AlpmDb;
+
+    std::string format_desc(std::string_view sample) {
+        PkgInfo package_info;
+        package_info.parse(sample);
+
+        DescFormatter formatter {std::move(package_info), "package-1.0-1-x86_64.pkg.tar.zst", "",
+                                 PackageDigest {.size = 1'000'000,
+                                                .md5 = std::string(32, '0'),
+                                                .sha256 = std::string(64, '0')}};
+
+        return formatter.format();
+    }
+
+    // Parses .PKGINFO files extracted from real packages and formats their descs,
+    // as the package reader does after it found the .PKGINFO
+    int pkginfo(Arguments arguments) {
+        if (arguments.size() < 2) {
+            fmt::print(stderr, "Pass the number of rounds and at least one .PKGINFO\n");
+            return 1;
+        }
+
+        auto const rounds = argument(arguments, 0, 3);
+
+        std::vector<std::string> samples;
+        for (auto const& path : arguments.subspan(1)) {
+            std::ifstream stream(path, std::ios::binary);
+            if (!stream) {
+                fmt::print(stderr, "Can't read \"{}\"\n", path);
+                return 1;
+            }
+            samples.emplace_back(std::istreambuf_iterator<char>(stream),
+                                 std::istreambuf_iterator<char>());
+        }
+
+        // Runs of a single sample are too short to time, every round covers 1000
+        constexpr size_t repeats = 1000;
+        auto const items = samples.size() * repeats;
+
+        fmt::print("{} .PKGINFO samples, {} times per round, best of {} rounds\n",
+                   samples.size(), repeats, rounds);
+
+        report("PkgInfo::parse", measure(rounds, items, [&samples](size_t) {
+                   for (size_t repeat = 0; repeat < repeats; ++repeat) {
+                       for (auto const& sample : samples) {
+                           PkgInfo package_info;
+                           package_info.parse(sample);
+                       }
+                   }
+               }));
+
+        report("PkgInfo::parse + DescFormatter::format",
+               measure(rounds, items, [&samples](size_t) {
+                   for (size_t repeat = 0; repeat < repeats; ++repeat) {
+                       for (auto const& sample : samples) {
+                           format_desc(sample);
+                       }
+                   }
+               }));
+
+        auto const before = allocations.load();
+        for (auto const& sample : samples) {
+            format_desc(sample);
+        }
+        auto const counted = allocations.load() - before;
+
+        fmt::print("{:<40} {:>12.1f} allocations/desc\n", "PkgInfo::parse + DescFormatter::format",
+                   static_cast<double>(counted) / samples.size());
+
+        return 0;
+    }
+
+    Registration const registration {"pkginfo", "<rounds> <.PKGINFO>...", pkginfo};
+
+} // namespace
+} // namespace bxt::Bench
+
+void* operator new(std::size_t size) {
+    bxt::Bench::allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (auto* pointer = std::malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
@@ -0,0 +1,85 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "Bench.h"
+#include "Fixtures.h"
+#include "persistence/box/BoxOptions.h"
+#include "persistence/box/store/LMDBPackageStore.h"
+#include "persistence/lmdb/LmdbUnitOfWork.h"
+
+#include <coro/sync_wait.hpp>
+#include <fmt/core.h>
+#include <ranges>
+#include <stdexcept>
+#include <vector>
+
+namespace bxt::Bench {
+namespace {
+
+    // Adds the records within one write transaction, either one call per record
+    // or a single batched call, and commits
+    int store_write(Arguments arguments) {
+        auto const records = argument(arguments, 0, 10'000);
+        auto const rounds = argument(arguments, 1, 3);
+
+        TemporaryDirectory directory;
+        auto environment = open_environment(directory.path());
+
+        Core::Application::PackageSectionDTO const section {
+            .branch = "stable", .repository = "core", .architecture = "x86_64"};
+        Sections sections({section});
+        Pool pool;
+        Persistence::Box::BoxOptions box_options {.box_path = directory.path() / "box"};
+        Persistence::LmdbUnitOfWorkFactory uow_factory(environment);
+
+        auto const packages =
+            std::views::iota(size_t {0}, records)
+            | std::views::transform([&](size_t index) {
+                  return make_record(section, box_options.box_path / "pool", index);
+              })
+            | std::ranges::to<std::vector>();
+
+        auto const write = [&](std::string_view mode, bool batched) {
+            return measure(rounds, records, [&](size_t round) {
+                // A store per round so every round starts from an empty database
+                Persistence::Box::LMDBPackageStore store(
+                    box_options, environment, pool, sections,
+                    fmt::format("bench::{}::{}", mode, round));
+                if (auto prepared = store.prepare(); !prepared) {
+                    throw std::runtime_error(prepared.error().what());
+                }
+
+                coro::sync_wait([&]() -> coro::task<void> {
+                    auto uow = co_await uow_factory(true);
+                    if (batched) {
+                        auto const added = co_await store.add(packages, uow);
+                        if (!added.has_value()) {
+                            throw std::runtime_error(added.error().what());
+                        }
+                    } else {
+                        for (auto const& package : packages) {
+                            auto const added = co_await store.add(package, uow);
+                            if (!added.has_value()) {
+                                throw std::runtime_error(added.error().what());
+                            }
+                        }
+                    }
+                    co_await uow->commit_async();
+                }());
+            });
+        };
+
+        fmt::print("{} records, best of {} rounds\n", records, rounds);
+        report("add, one call per record", write("single", false));
+        report("add, one batched call", write("batch", true));
+
+        return 0;
+    }
+
+    Registration const registration {"store-write", "[records=10000] [rounds=3]", store_write};
+
+} // namespace
+} // namespace bxt::Bench
@@ -0,0 +1,48 @@
+#!/usr/bin/env bash
+#
+# === This file is part of bxt ===
+#
+#   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+#   SPDX-License-Identifier: AGPL-3.0-or-later
+#
+# Loads /box of a running bxtd and a caddy file server over the same box
+# directory with wrk, so the built-in serving can be compared with the setup
+# from docker-compose.caddy.yml.
+#
+# Usage: serve-load.sh <box-path> <file> [bxtd-url] [duration] [connections]
+#   file is relative to the box, e.g. stable/core/x86_64/core.db
+
+set -euo pipefail
+
+if [[ $# -lt 2 ]]; then
+    sed -n '12,13p' "$0" | cut -c3-
+    exit 1
+fi
+
+box_path=$1
+file=$2
+bxtd_url=${3:-http://127.0.0.1:8080}
+duration=${4:-30s}
+connections=${5:-64}
+caddy_address=127.0.0.1:18080
+
+for tool in wrk caddy; do
+    if ! command -v "$tool" >/dev/null; then
+        echo "$tool is required" >&2
+        exit 1
+    fi
+done
+
+caddy file-server --root "$box_path" --listen "$caddy_address" >/dev/null 2>&1 &
+caddy_pid=$!
+trap 'kill $caddy_pid' EXIT
+sleep 1
+
+run() {
+    echo "== $1"
+    wrk --latency -t "$(nproc)" -c "$connections" -d "$duration" "$2"
+    echo
+}
+
+run "bxtd" "$bxtd_url/box/$file"
+run "caddy" "http://$caddy_address/$file"
@@ -29,6 +29,7 @@
 
 #include <boost/log/trivial.hpp>
 #include <boost/log/utility/setup.hpp>
+#include <chrono>
 #include <cstdlib>
 #include <drogon/HttpAppFramework.h>
 #include <filesystem>
@@ -98,19 +99,20 @@ void setup_di_container(kgr::container& container) {
     // Parse the repository schema from a YAML file and extend the parser with
     // custom options
     container.invoke<di::Utilities::RepoSchema::Parser, di::Infrastructure::ArchRepoOptions,
-                     di::Persistence::Box::PoolOptions>(
-        [](auto& parser, auto& arch_repo_options, auto& pool_options) {
+                     di::Persistence::Box::PoolOptions, di::Persistence::Box::BoxOptions>(
+        [](auto& parser, auto& arch_repo_options, auto& pool_options, auto& box_options) {
             parser.extend(&arch_repo_options);
             parser.extend(&pool_options);
 
             parser.parse("./box.yml");
+
+            if (arch_repo_options.download_path.empty()) {
+                arch_repo_options.download_path = box_options.staging_path() / "sync";
+            }
         });
 
     container.invoke<di::Utilities::LMDB::Environment, di::Utilities::LMDB::LMDBOptions>(
         [](auto lmdbenv, auto& options) {
-            lmdbenv->env().set_mapsize(50UL * 1024UL * 1024UL * 1024UL);
-            lmdbenv->env().set_max_dbs(128);
-
             std::error_code ec;
             if (std::filesystem::create_directories(options.lmdb_path, ec); ec.value()) {
                 logf("Cannot create LMDB folder. The error is \"{}\". Exiting.", ec.message());
@@ -118,7 +120,7 @@ void setup_di_container(kgr::container& container) {
             }
 
             try {
-                lmdbenv->env().open(options.lmdb_path.c_str(), 0, 0664);
+                lmdbenv->open(options);
             } catch (lmdb::error const& er) {
                 logf("Cannot open LMDB database. The error is \"{}\". Exiting.", er.what());
                 exit(1);
@@ -138,10 +140,19 @@ void setup_di_container(kgr::container& container) {
         std::string("bxt::DeployLogEntries"));
 
     container.emplace<di::Persistence::UnitOfWorkFactory>();
+    container.service<di::Persistence::GroupCommitWriter>();
 
     container.emplace<di::Persistence::Box::Pool>();
     container.emplace<di::Persistence::Box::LMDBPackageStore>("bxt::Box");
 
+    container.invoke<di::Persistence::Box::LMDBPackageStore>([](auto& package_store) {
+        if (auto prepared = package_store.prepare(); !prepared) {
+            logf("Cannot prepare the package store. The error is \"{}\". Exiting.",
+                 prepared.error().what());
+            exit(1);
+        }
+    });
+
     container.emplace<di::Persistence::Box::AlpmDBExporter>();
 
     container.service<di::Persistence::Box::BoxRepository>();
@@ -172,6 +183,10 @@ void setup_controllers(drogon::HttpAppFramework& app, kgr::container& container)
         .registerController(container.service<SectionController>())
         .registerController(container.service<bxt::di::Infrastructure::WSController>())
         .registerFilter(container.service<JwtFilter>());
+
+    if (container.service<bxt::di::Persistence::Box::BoxOptions>().serve_box) {
+        app.registerController(container.service<BoxController>());
+    }
 }
 
 void setup_scheduler(auto& app, auto scheduler, auto eventbus) {
@@ -181,6 +196,46 @@ void setup_scheduler(auto& app, auto scheduler, auto eventbus) {
     });
 }
 
+// Commits made with MDB_NOSYNC/MDB_NOMETASYNC reach the disk on the next flush
+void setup_lmdb_sync(kgr::container& container) {
+    auto& options = container.service<bxt::di::Utilities::LMDB::LMDBOptions>();
+    if (!options.needs_periodic_sync()) {
+        return;
+    }
+
+    container.service<bxt::di::Utilities::LMDB::Environment>()->start_periodic_sync(
+        std::chrono::seconds(options.sync_interval));
+}
+
+void setup_stats_log(auto& app, kgr::container& container) {
+    auto const interval =
+        container.service<bxt::di::Persistence::Box::BoxOptions>().stats_interval;
+    if (interval <= 0) {
+        return;
+    }
+
+    app.getLoop()->runEvery(
+        static_cast<double>(interval),
+        [&box_repository = container.service<bxt::di::Persistence::Box::BoxRepository>(),
+         &writeback = container.service<bxt::di::Persistence::Box::WritebackScheduler>()]() {
+            auto const cache = box_repository.cache_stats();
+            bxt::logi("Box: Section cache has {} entries in {} KiB (hits: {}, misses: {}, "
+                      "evictions: {})",
+                      cache.entries, cache.memory / 1024, cache.hits, cache.misses,
+                      cache.evictions);
+
+            auto const exports = writeback.stats();
+            auto const average =
+                exports.published_commits > 0
+                    ? exports.total_delay.count() / static_cast<int64_t>(exports.published_commits)
+                    : 0;
+            bxt::logi("Box: {} sections with {} commits wait for their export, {} commits "
+                      "published (delay last: {} ms, average: {} ms, max: {} ms)",
+                      exports.pending_sections, exports.pending_commits, exports.published_commits,
+                      exports.last_delay.count(), average, exports.max_delay.count());
+        });
+}
+
 void setup_defaults(kgr::container& container) {
     using namespace bxt;
     auto& unit_of_work_factory = container.service<di::Core::Domain::UnitOfWorkBaseFactory>();
@@ -214,6 +269,28 @@ void setup_defaults(kgr::container& container) {
     }
 }
 
+// Uploads and downloads of commits that never finished, nothing refers to them
+// after a restart
+void clear_staging(std::filesystem::path const& staging_path) {
+    std::error_code ec;
+    size_t removed = 0;
+
+    for (auto const& entry : std::filesystem::directory_iterator(staging_path, ec)) {
+        std::error_code remove_ec;
+        std::filesystem::remove_all(entry.path(), remove_ec);
+        if (remove_ec) {
+            bxt::logw("Staging: Can't remove \"{}\", the error is \"{}\"",
+                      entry.path().string(), remove_ec.message());
+            continue;
+        }
+        ++removed;
+    }
+
+    if (removed > 0) {
+        bxt::logi("Staging: Removed {} entries left by unfinished commits", removed);
+    }
+}
+
 int main() {
     setup_logger();
 
@@ -234,7 +311,7 @@ int main() {
             return;
         }
 
-        if (req->path().starts_with("/api/")) {
+        if (req->path().starts_with("/api/") || req->path().starts_with("/box/")) {
             accb();
             return;
         }
@@ -251,17 +328,23 @@ int main() {
         acb(drogon::HttpResponse::newFileResponse(resource));
     };
 
+    auto const staging_path =
+        container.service<bxt::di::Persistence::Box::BoxOptions>().staging_path();
+    clear_staging(staging_path);
+
     auto& drogon_app = drogon::app()
                            .setDocumentRoot("./web/")
                            .registerPreRoutingAdvice(serveFrontendAdvice)
                            .enableCompressedRequest()
                            .addListener("0.0.0.0", 8080)
-                           .setUploadPath("/tmp/bxt/")
+                           .setUploadPath(staging_path.string())
                            .setClientMaxBodySize(256 * 1024 * 1024)
                            .setClientMaxMemoryBodySize(1024 * 1024);
 
     setup_scheduler(drogon_app, container.service<bxt::di::Utilities::IOScheduler>(),
                     container.service<bxt::di::Utilities::EventBus>());
+    setup_lmdb_sync(container);
+    setup_stats_log(drogon_app, container);
     setup_controllers(drogon_app, container);
 
     drogon_app.run();
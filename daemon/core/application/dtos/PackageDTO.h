@@ -11,6 +11,7 @@
 #include "core/domain/value_objects/PackageVersion.h"
 #include "PackageSectionDTO.h"
 #include "parallel_hashmap/phmap.h"
+#include "utilities/alpmdb/ParsedPackageCache.h"
 #include "utilities/log/Logging.h"
 #include "utilities/StaticDTOMapper.h"
 
@@ -71,7 +72,8 @@ template<> struct bxt::Utilities::StaticDTOMapper<Package, PackageDTO> {
         return dto;
     }
 
-    static Package to_entity(PackageDTO const& from) {
+    static Package to_entity(PackageDTO const& from,
+                             bxt::Utilities::AlpmDb::ParsedPackageCache& cache) {
         Package package(
             SectionDTOMapper::to_entity(from.section),
             from.name.empty()
@@ -80,7 +82,7 @@ template<> struct bxt::Utilities::StaticDTOMapper<Package, PackageDTO> {
             from.is_any_architecture);
 
         for (auto const& entry : from.pool_entries) {
-            auto entity = PackagePoolEntry::parse_file_path(entry.second.filepath,
+            auto entity = PackagePoolEntry::parse_file_path(cache, entry.second.filepath,
                                                             entry.second.signature_path);
 
             if (!entity.has_value()) {
@@ -11,25 +11,31 @@
 
 #include <algorithm>
 namespace bxt::Core::Application {
+
+namespace {
+    CrudError commit_error(Domain::UnitOfWorkBase::Error&& error) {
+        return bxt::make_error_with_source<CrudError>(std::move(error),
+                                                      CrudError::ErrorType::InternalError)
+            .error();
+    }
+} // namespace
+
 coro::task<UserService::Result<void>> UserService::add_user(UserDTO const user) {
     auto const user_entity = UserDTOMapper::to_entity(user);
 
-    auto uow = co_await m_uow_factory(true);
+    co_return co_await m_writer.submit<CrudError>(
+        [this, &user_entity](std::shared_ptr<Domain::UnitOfWorkBase> uow)
+            -> coro::task<Result<void>> {
+            auto result = co_await m_repository.save_async(user_entity, uow);
 
-    auto result = co_await m_repository.save_async(user_entity, uow);
+            if (!result.has_value()) {
+                co_return bxt::make_error_with_source<CrudError>(
+                    std::move(result.error()), CrudError::ErrorType::InternalError);
+            }
 
-    if (!result.has_value()) {
-        co_return bxt::make_error_with_source<CrudError>(std::move(result.error()),
-                                                         CrudError::ErrorType::InternalError);
-    }
-    auto commit_ok = co_await uow->commit_async();
-
-    if (!commit_ok) {
-        co_return bxt::make_error_with_source<CrudError>(std::move(commit_ok.error()),
-                                                         CrudError::ErrorType::InternalError);
-    }
-
-    co_return {};
+            co_return {};
+        },
+        commit_error);
 }
 
 coro::task<UserService::Result<void>> UserService::remove_user(std::string const name) {
@@ -37,63 +43,55 @@ coro::task<UserService::Result<void>> UserService::remove_user(std::string const
         co_return bxt::make_error<CrudError>(CrudError::ErrorType::InvalidArgument);
     }
 
-    auto uow = co_await m_uow_factory(true);
-
-    auto result = co_await m_repository.delete_async(name, uow);
-
-    if (!result.has_value()) {
-        co_return bxt::make_error_with_source<CrudError>(std::move(result.error()),
-                                                         CrudError::ErrorType::InternalError);
-    }
+    co_return co_await m_writer.submit<CrudError>(
+        [this, &name](std::shared_ptr<Domain::UnitOfWorkBase> uow) -> coro::task<Result<void>> {
+            auto result = co_await m_repository.delete_async(name, uow);
 
-    auto commit_ok = co_await uow->commit_async();
+            if (!result.has_value()) {
+                co_return bxt::make_error_with_source<CrudError>(
+                    std::move(result.error()), CrudError::ErrorType::InternalError);
+            }
 
-    if (!commit_ok) {
-        co_return bxt::make_error_with_source<CrudError>(std::move(commit_ok.error()),
-                                                         CrudError::ErrorType::InternalError);
-    }
-
-    co_return {};
+            co_return {};
+        },
+        commit_error);
 }
 
 coro::task<UserService::Result<void>> UserService::update_user(UserDTO const user) {
-    auto uow = co_await m_uow_factory(true);
-
-    auto existing_user_entity = co_await m_repository.find_by_id_async(user.name, uow);
-
-    if (!existing_user_entity) {
-        co_return bxt::make_error_with_source<CrudError>(std::move(existing_user_entity.error()),
-                                                         CrudError::ErrorType::EntityNotFound);
-    }
+    co_return co_await m_writer.submit<CrudError>(
+        [this, &user](std::shared_ptr<Domain::UnitOfWorkBase> uow) -> coro::task<Result<void>> {
+            auto existing_user_entity = co_await m_repository.find_by_id_async(user.name, uow);
 
-    if (user.password) {
-        existing_user_entity->set_password(*user.password);
-    }
+            if (!existing_user_entity) {
+                co_return bxt::make_error_with_source<CrudError>(
+                    std::move(existing_user_entity.error()), CrudError::ErrorType::EntityNotFound);
+            }
 
-    if (user.permissions) {
-        std::set<Domain::Permission> permission_entities;
+            if (user.password) {
+                existing_user_entity->set_password(*user.password);
+            }
 
-        std::ranges::transform(*user.permissions,
-                               std::inserter(permission_entities, permission_entities.end()),
-                               [](auto const& p) { return Domain::Permission(p); });
+            if (user.permissions) {
+                std::set<Domain::Permission> permission_entities;
 
-        existing_user_entity->set_permissions(permission_entities);
-    }
+                std::ranges::transform(
+                    *user.permissions,
+                    std::inserter(permission_entities, permission_entities.end()),
+                    [](auto const& p) { return Domain::Permission(p); });
 
-    auto result = co_await m_repository.save_async(*existing_user_entity, uow);
+                existing_user_entity->set_permissions(permission_entities);
+            }
 
-    if (!result.has_value()) {
-        co_return bxt::make_error_with_source<CrudError>(std::move(result.error()),
-                                                         CrudError::ErrorType::InternalError);
-    }
-    auto commit_ok = co_await uow->commit_async();
+            auto result = co_await m_repository.save_async(*existing_user_entity, uow);
 
-    if (!commit_ok) {
-        co_return bxt::make_error_with_source<CrudError>(std::move(commit_ok.error()),
-                                                         CrudError::ErrorType::InternalError);
-    }
+            if (!result.has_value()) {
+                co_return bxt::make_error_with_source<CrudError>(
+                    std::move(result.error()), CrudError::ErrorType::InternalError);
+            }
 
-    co_return {};
+            co_return {};
+        },
+        commit_error);
 }
 
 coro::task<UserService::Result<std::vector<UserDTO>>> UserService::get_users() const {
@@ -8,6 +8,7 @@
 
 #include "core/application/dtos/UserDTO.h"
 #include "core/application/errors/CrudError.h"
+#include "core/domain/repositories/GroupCommitWriterBase.h"
 #include "core/domain/repositories/UserRepository.h"
 #include "utilities/errors/Macro.h"
 
@@ -16,9 +17,11 @@ class UserService {
 public:
     BXT_DECLARE_RESULT(CrudError)
     UserService(bxt::Core::Domain::UserRepository& repository,
-                Domain::UnitOfWorkBaseFactory& uow_factory)
+                Domain::UnitOfWorkBaseFactory& uow_factory,
+                Domain::GroupCommitWriterBase& writer)
         : m_repository(repository)
-        , m_uow_factory(uow_factory) {
+        , m_uow_factory(uow_factory)
+        , m_writer(writer) {
     }
 
     virtual coro::task<Result<void>> add_user(UserDTO const user);
@@ -29,6 +32,7 @@ public:
 private:
     bxt::Core::Domain::UserRepository& m_repository;
     Domain::UnitOfWorkBaseFactory& m_uow_factory;
+    Domain::GroupCommitWriterBase& m_writer;
 };
 
 } // namespace bxt::Core::Application
@@ -65,11 +65,12 @@ std::optional<std::string> Package::parse_file_name(std::string const& filename)
     return name;
 }
 Package::Result<Package>
-    Package::from_file_path(Section const& section,
+    Package::from_file_path(Utilities::AlpmDb::ParsedPackageCache& cache,
+                            Section const& section,
                             PoolLocation const location,
                             std::filesystem::path const& filepath,
                             std::optional<std::filesystem::path> const& signature_path) {
-    auto pool_entry = PackagePoolEntry::parse_file_path(filepath, signature_path);
+    auto pool_entry = PackagePoolEntry::parse_file_path(cache, filepath, signature_path);
 
     if (!pool_entry.has_value()) {
         return bxt::make_error_with_source<ParseError>(std::move(pool_entry.error()));
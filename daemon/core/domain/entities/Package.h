@@ -62,7 +62,8 @@ public:
     static std::optional<std::string> parse_file_name(std::string const& filename);
 
     static Result<Package>
-        from_file_path(Section const& section,
+        from_file_path(Utilities::AlpmDb::ParsedPackageCache& cache,
+                       Section const& section,
                        PoolLocation const location,
                        std::filesystem::path const& filepath,
                        std::optional<std::filesystem::path> const& signature_path = {});
@@ -0,0 +1,76 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "core/domain/repositories/UnitOfWorkBase.h"
+#include "utilities/Error.h"
+
+#include <coro/task.hpp>
+#include <expected>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace bxt::Core::Domain {
+
+/**
+ * @brief Runs small writes of many callers in shared write transactions.
+ *
+ * Mutations are queued and applied in batches, one unit of work and one
+ * commit per batch. A mutation that fails is dropped from its batch and the
+ * rest is applied again without it, so mutations have to be safe to run more
+ * than once and must not keep the unit of work after they return.
+ */
+struct GroupCommitWriterBase {
+    // Returns false to reject the batch's transaction for this mutation
+    using Mutation = std::function<coro::task<bool>(std::shared_ptr<UnitOfWorkBase>)>;
+
+    virtual ~GroupCommitWriterBase() = default;
+
+    // Completes once the batch containing the mutation is committed
+    virtual coro::task<UnitOfWorkBase::Result<void>> submit(Mutation mutation) = 0;
+
+    // Queues the mutation without waiting for it, failures are only logged
+    virtual void post(Mutation mutation, std::string const& name) = 0;
+
+    /**
+     * @brief Submits a mutation reporting its own error type.
+     *
+     * @param mutation The mutation, its error is returned as is.
+     * @param map_commit_error Converts a failed commit of the batch.
+     */
+    template<typename TError>
+    coro::task<std::expected<void, TError>> submit(
+        std::function<coro::task<std::expected<void, TError>>(std::shared_ptr<UnitOfWorkBase>)>
+            mutation,
+        std::function<TError(UnitOfWorkBase::Error&&)> map_commit_error) {
+        std::optional<TError> error;
+
+        auto committed = co_await submit(
+            [&mutation, &error](std::shared_ptr<UnitOfWorkBase> uow) -> coro::task<bool> {
+                auto result = co_await mutation(std::move(uow));
+                if (!result.has_value()) {
+                    error = std::move(result.error());
+                    co_return false;
+                }
+                co_return true;
+            });
+
+        if (error) {
+            co_return std::unexpected(std::move(*error));
+        }
+
+        if (!committed.has_value()) {
+            co_return std::unexpected(map_commit_error(std::move(committed.error())));
+        }
+
+        co_return {};
+    }
+};
+
+} // namespace bxt::Core::Domain
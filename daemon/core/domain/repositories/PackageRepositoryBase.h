@@ -12,16 +12,26 @@
 
 #include <core/domain/entities/Package.h>
 #include <core/domain/repositories/RepositoryBase.h>
+#include <filesystem>
 #include <functional>
+#include <memory>
+#include <vector>
 
 namespace bxt::Core::Domain {
 struct PackageRepositoryBase : public ReadWriteRepositoryBase<Package> {
     template<typename T> using ReadResult = ReadOnlyRepositoryBase<Package>::Result<T>;
     template<typename T> using WriteResult = ReadWriteRepositoryBase<Package>::Result<T>;
+    using TSharedResults = ReadResult<std::shared_ptr<std::vector<Package> const>>;
 
     virtual coro::task<TResults> find_by_section_async(Section const section,
                                                        std::shared_ptr<UnitOfWorkBase> uow) = 0;
 
+    // Same packages as find_by_section_async, the list may be shared with other
+    // readers instead of copied for the caller
+    virtual coro::task<TSharedResults>
+        find_shared_by_section_async(Section const section,
+                                     std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
     virtual coro::task<TResults>
         find_by_section_async(Section const section,
                               std::function<bool(Package const& pkg)> const predicate,
@@ -30,5 +40,14 @@ struct PackageRepositoryBase : public ReadWriteRepositoryBase<Package> {
     virtual coro::task<TResult> find_by_section_async(Section const section,
                                                       Name const name,
                                                       std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
+    // Packages with the given name across all sections
+    virtual coro::task<TResults> find_by_name_async(Name const name,
+                                                    std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
+    // Packages referencing the given pool file
+    virtual coro::task<TResults>
+        find_by_file_path_async(std::filesystem::path const file_path,
+                                std::shared_ptr<UnitOfWorkBase> uow) = 0;
 };
 } // namespace bxt::Core::Domain
@@ -45,6 +45,18 @@ struct UnitOfWorkBase {
     virtual coro::task<Result<void>> begin_ro_async() = 0;
 
     virtual void hook(std::function<void()>&& hook, std::string const& name = "") = 0;
+
+    // Runs before the commit like hook. A failing hook aborts the commit, the
+    // commit returns its error. The undo of a hook that already ran is called,
+    // in reverse order, when a later hook or the commit itself fails.
+    virtual void checked_hook(std::function<Result<void>()>&& hook,
+                              std::string const& name = "",
+                              std::function<void()>&& undo = {}) = 0;
+
+    // Runs once the commit succeeded, the changes are visible to new readers.
+    // Named hooks replace the earlier hook of the same name like hook does.
+    virtual void post_commit_hook(std::function<void()>&& hook,
+                                  std::string const& name = "") = 0;
 };
 
 struct UnitOfWorkBaseFactory {
@@ -0,0 +1,27 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <coro/task.hpp>
+
+namespace bxt::Core::Domain {
+
+/**
+ * @brief Publishes committed changes of the repositories in the background.
+ *
+ * Commits are batched per section and published after a quiet period, or
+ * once the oldest unpublished commit reaches the maximum delay.
+ */
+struct WritebackSchedulerBase {
+    virtual ~WritebackSchedulerBase() = default;
+
+    // Publishes everything committed so far without waiting for the delays.
+    // Returns false if some of it couldn't be published.
+    virtual coro::task<bool> flush() = 0;
+};
+
+} // namespace bxt::Core::Domain
@@ -7,12 +7,15 @@
 
 #include "PackagePoolEntry.h"
 
+#include "utilities/alpmdb/ParsedPackageCache.h"
+
 #include <fstream>
 
 namespace bxt::Core::Domain {
 
 PackagePoolEntry::Result<PackagePoolEntry>
-    PackagePoolEntry::parse_file_path(std::filesystem::path const& file_path,
+    PackagePoolEntry::parse_file_path(Utilities::AlpmDb::ParsedPackageCache& cache,
+                                      std::filesystem::path const& file_path,
                                       std::optional<std::filesystem::path> const& signature_path) {
     std::string const filename = file_path.filename();
 
@@ -39,30 +42,32 @@ PackagePoolEntry::Result<PackagePoolEntry>
                                                          ParsingError::ErrorCode::InvalidVersion);
     }
 
-    PackagePoolEntry result(file_path, {}, {}, *version);
+    auto resolved_signature_path = signature_path;
 
-    if (signature_path.has_value()) {
-        result.m_signature_path = signature_path;
-    } else {
+    if (!resolved_signature_path.has_value()) {
         auto const deduced_signature_path = fmt::format("{}.sig", file_path.string());
 
         if (std::filesystem::exists(deduced_signature_path)) {
-            result.m_signature_path = deduced_signature_path;
+            resolved_signature_path = deduced_signature_path;
         }
     }
 
-    std::ifstream signature_file(result.m_signature_path.value(), std::ios::binary);
+    std::string signature_data;
+
+    if (resolved_signature_path.has_value()) {
+        std::ifstream signature_file(*resolved_signature_path, std::ios::binary);
 
-    std::string signature_data((std::istreambuf_iterator<char>(signature_file)),
-                               std::istreambuf_iterator<char>());
+        signature_data.assign(std::istreambuf_iterator<char>(signature_file),
+                              std::istreambuf_iterator<char>());
+    }
 
-    auto desc = bxt::Utilities::AlpmDb::Desc::parse_package(file_path, signature_data);
+    auto desc = cache.parse(file_path, signature_data);
     if (!desc.has_value()) {
         return bxt::make_error_with_source<ParsingError>(std::move(desc.error()),
                                                          ParsingError::ErrorCode::InvalidPackage);
     }
-    result.m_desc = std::move(desc.value());
 
-    return result;
+    return PackagePoolEntry(file_path, std::move(resolved_signature_path), std::move(*desc),
+                            *version);
 }
 } // namespace bxt::Core::Domain
@@ -13,6 +13,11 @@
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <filesystem>
+#include <memory>
+
+namespace bxt::Utilities::AlpmDb {
+class ParsedPackageCache;
+} // namespace bxt::Utilities::AlpmDb
 
 namespace bxt::Core::Domain {
 class PackagePoolEntry {
@@ -46,7 +51,7 @@ public:
 
     PackagePoolEntry(std::filesystem::path m_file_path,
                      std::optional<std::filesystem::path> m_signature_path,
-                     Utilities::AlpmDb::Desc desc,
+                     std::shared_ptr<Utilities::AlpmDb::Desc const> desc,
                      PackageVersion m_version)
         : m_file_path(std::move(m_file_path))
         , m_signature_path(std::move(m_signature_path))
@@ -66,18 +71,20 @@ public:
         return m_version;
     }
 
-    Utilities::AlpmDb::Desc desc() const {
-        return m_desc;
+    Utilities::AlpmDb::Desc const& desc() const {
+        return *m_desc;
     }
 
+    // The description is the cache's parsed artifact, it's shared and not copied
     static Result<PackagePoolEntry>
-        parse_file_path(std::filesystem::path const& file_path,
+        parse_file_path(Utilities::AlpmDb::ParsedPackageCache& cache,
+                        std::filesystem::path const& file_path,
                         std::optional<std::filesystem::path> const& signature_path);
 
 private:
     std::filesystem::path m_file_path;
     std::optional<std::filesystem::path> m_signature_path;
-    Utilities::AlpmDb::Desc m_desc;
+    std::shared_ptr<Utilities::AlpmDb::Desc const> m_desc;
 
     PackageVersion m_version;
 };
@@ -12,6 +12,8 @@
 #include "core/application/services/PermissionService.h"
 #include "core/application/services/SectionService.h"
 #include "core/application/services/UserService.h"
+#include "core/domain/repositories/GroupCommitWriterBase.h"
+#include "core/domain/repositories/WritebackSchedulerBase.h"
 #include "core/domain/repositories/UnitOfWorkBase.h"
 #include "coro/io_scheduler.hpp"
 #include "event_log/application/services/LogService.h"
@@ -36,6 +38,7 @@
 #include "persistence/box/store/PackageStoreBase.h"
 #include "persistence/box/writeback/WritebackScheduler.h"
 #include "persistence/config/SectionRepository.h"
+#include "persistence/lmdb/GroupCommitWriter.h"
 #include "persistence/lmdb/LmdbUnitOfWork.h"
 #include "persistence/lmdb/LogEntryRepositories.h"
 #include "persistence/lmdb/UserRepository.h"
@@ -43,12 +46,14 @@
 #include "presentation/cli-controllers/DeploymentOptions.h"
 #include "presentation/JwtOptions.h"
 #include "presentation/web-controllers/AuthController.h"
+#include "presentation/web-controllers/BoxController.h"
 #include "presentation/web-controllers/CompareController.h"
 #include "presentation/web-controllers/LogController.h"
 #include "presentation/web-controllers/PackageController.h"
 #include "presentation/web-controllers/SectionController.h"
 #include "presentation/web-controllers/UserController.h"
 #include "presentation/web-filters/JwtFilter.h"
+#include "utilities/alpmdb/ParsedPackageCache.h"
 #include "utilities/configuration/Configuration.h"
 #include "utilities/lmdb/Environment.h"
 #include "utilities/lmdb/LMDBOptions.h"
@@ -74,12 +79,16 @@ namespace Utilities {
 
     struct IOScheduler : kgr::extern_shared_service<coro::io_scheduler> {};
 
+    namespace AlpmDb {
+        struct ParsedPackageCache
+            : kgr::single_service<bxt::Utilities::AlpmDb::ParsedPackageCache> {};
+
+    } // namespace AlpmDb
+
     namespace LMDB {
         struct LMDBOptions : kgr::single_service<bxt::Utilities::LMDB::LMDBOptions> {};
 
-        struct Environment
-            : kgr::shared_service<bxt::Utilities::LMDB::Environment, kgr::dependency<IOScheduler>> {
-        };
+        struct Environment : kgr::shared_service<bxt::Utilities::LMDB::Environment> {};
 
     } // namespace LMDB
 
@@ -109,6 +118,12 @@ namespace Core {
         struct UnitOfWorkBaseFactory
             : kgr::abstract_service<bxt::Core::Domain::UnitOfWorkBaseFactory> {};
 
+        struct GroupCommitWriterBase
+            : kgr::abstract_service<bxt::Core::Domain::GroupCommitWriterBase> {};
+
+        struct WritebackSchedulerBase
+            : kgr::abstract_service<bxt::Core::Domain::WritebackSchedulerBase> {};
+
     } // namespace Domain
 
     namespace Application {
@@ -128,7 +143,8 @@ namespace Core {
         struct UserService
             : kgr::single_service<bxt::Core::Application::UserService,
                                   kgr::dependency<di::Core::Domain::UserRepository,
-                                                  di::Core::Domain::UnitOfWorkBaseFactory>> {};
+                                                  di::Core::Domain::UnitOfWorkBaseFactory,
+                                                  di::Core::Domain::GroupCommitWriterBase>> {};
 
         struct PermissionService
             : kgr::single_service<bxt::Core::Application::PermissionService,
@@ -172,7 +188,8 @@ namespace EventLog {
                                                   Domain::SyncLogEntryRepository,
                                                   Domain::CommitLogEntryRepository,
                                                   Domain::DeployLogEntryRepository,
-                                                  di::Core::Domain::UnitOfWorkBaseFactory>>
+                                                  di::Core::Domain::UnitOfWorkBaseFactory,
+                                                  di::Core::Domain::GroupCommitWriterBase>>
             , kgr::autocall<kgr::invoke<method<&bxt::EventLog::Application::LogService::init>>> {};
 
     } // namespace Application
@@ -192,7 +209,8 @@ namespace Infrastructure {
                               kgr::dependency<di::Utilities::EventBusDispatcher,
                                               di::Core::Domain::PackageRepositoryBase,
                                               di::Core::Domain::ReadOnlySectionRepository,
-                                              di::Core::Domain::UnitOfWorkBaseFactory>>
+                                              di::Core::Domain::UnitOfWorkBaseFactory,
+                                              di::Utilities::AlpmDb::ParsedPackageCache>>
         , kgr::overrides<di::Core::Application::PackageService> {};
 
     struct DeploymentService
@@ -200,7 +218,9 @@ namespace Infrastructure {
                               kgr::dependency<di::Utilities::EventBusDispatcher,
                                               di::Core::Application::PackageService,
                                               di::Core::Domain::ReadOnlySectionRepository,
-                                              di::Core::Domain::UnitOfWorkBaseFactory>>
+                                              di::Core::Domain::UnitOfWorkBaseFactory,
+                                              di::Core::Domain::WritebackSchedulerBase,
+                                              di::Utilities::AlpmDb::ParsedPackageCache>>
         , kgr::overrides<di::Core::Application::DeploymentService> {};
 
     struct ArchRepoOptions : kgr::single_service<bxt::Infrastructure::ArchRepoOptions> {};
@@ -210,7 +230,8 @@ namespace Infrastructure {
                               kgr::dependency<di::Utilities::EventBusDispatcher,
                                               di::Core::Domain::PackageRepositoryBase,
                                               di::Infrastructure::ArchRepoOptions,
-                                              di::Core::Domain::UnitOfWorkBaseFactory>>
+                                              di::Core::Domain::UnitOfWorkBaseFactory,
+                                              di::Utilities::AlpmDb::ParsedPackageCache>>
         , kgr::overrides<di::Core::Application::SyncService> {};
 
 } // namespace Infrastructure
@@ -222,6 +243,12 @@ namespace Persistence {
                               kgr::dependency<di::Utilities::LMDB::Environment>>
         , kgr::overrides<di::Core::Domain::UnitOfWorkBaseFactory> {};
 
+    struct GroupCommitWriter
+        : kgr::single_service<bxt::Persistence::GroupCommitWriter,
+                              kgr::dependency<di::Utilities::LMDB::LMDBOptions,
+                                              di::Core::Domain::UnitOfWorkBaseFactory>>
+        , kgr::overrides<di::Core::Domain::GroupCommitWriterBase> {};
+
     struct UserRepository
         : kgr::single_service<bxt::Persistence::LMDB::UserRepository,
                               kgr::dependency<di::Utilities::LMDB::Environment>>
@@ -272,10 +299,6 @@ namespace Persistence {
                                                   di::Core::Domain::ReadOnlySectionRepository>>
             , kgr::overrides<PackageStoreBase> {};
 
-        struct WritebackScheduler
-            : kgr::single_service<bxt::Persistence::Box::WritebackScheduler,
-                                  kgr::dependency<Utilities::IOScheduler>> {};
-
         struct ExporterBase : kgr::abstract_service<bxt::Persistence::Box::ExporterBase> {};
 
         struct AlpmDBExporter
@@ -286,6 +309,13 @@ namespace Persistence {
                                                   di::Core::Domain::UnitOfWorkBaseFactory>>
             , kgr::overrides<ExporterBase> {};
 
+        struct WritebackScheduler
+            : kgr::single_service<bxt::Persistence::Box::WritebackScheduler,
+                                  kgr::dependency<Utilities::IOScheduler,
+                                                  di::Persistence::Box::BoxOptions,
+                                                  ExporterBase>>
+            , kgr::overrides<di::Core::Domain::WritebackSchedulerBase> {};
+
         struct BoxRepository
             : kgr::single_service<
                   bxt::Persistence::Box::BoxRepository,
@@ -302,14 +332,16 @@ namespace Presentation {
         : kgr::shared_service<bxt::Presentation::PackageController,
                               kgr::dependency<di::Core::Application::PackageService,
                                               di::Core::Application::SyncService,
-                                              di::Core::Application::PermissionService>> {};
+                                              di::Core::Application::PermissionService,
+                                              di::Utilities::AlpmDb::ParsedPackageCache>> {};
 
     struct DeploymentOptions : kgr::single_service<bxt::Presentation::DeploymentOptions> {};
 
     struct DeploymentController
         : kgr::shared_service<bxt::Presentation::DeploymentController,
                               kgr::dependency<di::Presentation::DeploymentOptions,
-                                              di::Core::Application::DeploymentService>> {};
+                                              di::Core::Application::DeploymentService,
+                                              di::Utilities::AlpmDb::ParsedPackageCache>> {};
 
     struct CompareController
         : kgr::shared_service<bxt::Presentation::CompareController,
@@ -339,6 +371,11 @@ namespace Presentation {
                               kgr::dependency<di::Core::Application::SectionService,
                                               di::Core::Application::PermissionService>> {};
 
+    struct BoxController
+        : kgr::shared_service<bxt::Presentation::BoxController,
+                              kgr::dependency<di::Persistence::Box::BoxOptions,
+                                              di::Persistence::Box::ExporterBase>> {};
+
     struct JwtFilter
         : kgr::shared_service<
               bxt::Presentation::JwtFilter,
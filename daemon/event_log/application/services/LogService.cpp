@@ -58,14 +58,12 @@ void LogService::init() {
                                                 id.package_name, PoolLocation::Sync};
             }) | to<std::vector>());
 
-        coro::sync_wait([this, sync_log_entry = std::move(sync_log_entry)]() -> coro::task<void> {
-            auto uow = co_await m_uow_factory(true);
-            auto saved = co_await m_sync_repository.save_async(sync_log_entry, uow);
-
-            auto commited = co_await uow->commit_async();
-
-            co_return;
-        }());
+        m_writer.post(
+            [this, sync_log_entry = std::move(sync_log_entry)](auto uow) -> coro::task<bool> {
+                auto saved = co_await m_sync_repository.save_async(sync_log_entry, uow);
+                co_return saved.has_value();
+            },
+            "Sync log entry");
     });
 
     m_listener.listen<Commited>([this](auto const& commit_event) {
@@ -82,28 +80,24 @@ void LogService::init() {
             commit_event.to_copy | transform(transfer_action_to_update_log_entry)
                 | to<std::vector>()};
 
-        coro::sync_wait(
-            [this, commit_log_entry = std::move(commit_log_entry)]() -> coro::task<void> {
-                auto uow = co_await m_uow_factory(true);
+        m_writer.post(
+            [this, commit_log_entry = std::move(commit_log_entry)](auto uow) -> coro::task<bool> {
                 auto saved = co_await m_commit_repository.save_async(commit_log_entry, uow);
-
-                auto committed = co_await uow->commit_async();
-
-                co_return;
-            }());
+                co_return saved.has_value();
+            },
+            "Commit log entry");
     });
 
     m_listener.listen<DeploySuccess>([this](auto const& deploy_event) {
         Domain::DeployLogEntry deploy_log_entry {
             deploy_event.when, deploy_event.deployment_url,
             deploy_event.added_packages | transform(pkg_to_log_entry) | to<std::vector>()};
-        coro::sync_wait(
-            [this, deploy_log_entry = std::move(deploy_log_entry)]() -> coro::task<void> {
-                auto uow = co_await m_uow_factory(true);
+        m_writer.post(
+            [this, deploy_log_entry = std::move(deploy_log_entry)](auto uow) -> coro::task<bool> {
                 auto saved = co_await m_deploy_repository.save_async(deploy_log_entry, uow);
-                auto committed = co_await uow->commit_async();
-                co_return;
-            }());
+                co_return saved.has_value();
+            },
+            "Deploy log entry");
     });
 }
 
@@ -6,6 +6,7 @@
  */
 #pragma once
 
+#include "core/domain/repositories/GroupCommitWriterBase.h"
 #include "core/domain/repositories/RepositoryBase.h"
 #include "core/domain/repositories/UnitOfWorkBase.h"
 #include "event_log/application/dtos/CommitLogEntryDTO.h"
@@ -29,13 +30,15 @@ public:
         bxt::Core::Domain::ReadWriteRepositoryBase<Domain::SyncLogEntry>& sync_repository,
         bxt::Core::Domain::ReadWriteRepositoryBase<Domain::CommitLogEntry>& commit_repository,
         bxt::Core::Domain::ReadWriteRepositoryBase<Domain::DeployLogEntry>& deploy_repository,
-        UnitOfWorkBaseFactory& uow_factory)
+        UnitOfWorkBaseFactory& uow_factory,
+        bxt::Core::Domain::GroupCommitWriterBase& writer)
         : m_evbus(std::move(evbus))
         , m_listener(dexode::EventBus::Listener::createNotOwning(*m_evbus))
         , m_sync_repository(sync_repository)
         , m_commit_repository(commit_repository)
         , m_deploy_repository(deploy_repository)
-        , m_uow_factory(uow_factory) {
+        , m_uow_factory(uow_factory)
+        , m_writer(writer) {
     }
 
     void init();
@@ -62,6 +65,7 @@ private:
     bxt::Core::Domain::ReadWriteRepositoryBase<Domain::CommitLogEntry>& m_commit_repository;
     bxt::Core::Domain::ReadWriteRepositoryBase<Domain::DeployLogEntry>& m_deploy_repository;
     UnitOfWorkBaseFactory& m_uow_factory;
+    bxt::Core::Domain::GroupCommitWriterBase& m_writer;
 };
 
 } // namespace bxt::EventLog::Application
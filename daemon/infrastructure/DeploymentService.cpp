@@ -12,6 +12,7 @@
 #include "core/application/events/IntegrationEventBase.h"
 #include "infrastructure/PackageService.h"
 #include "utilities/Error.h"
+#include "utilities/log/Logging.h"
 #include "utilities/StaticDTOMapper.h"
 
 #include <filesystem>
@@ -19,6 +20,7 @@
 #include <iostream>
 #include <random>
 #include <stdexcept>
+#include <system_error>
 #include <vector>
 
 namespace bxt::Infrastructure {
@@ -84,17 +86,40 @@ coro::task<DeploymentService::Result<void>> DeploymentService::deploy_end(uint64
     PackageService::Transaction transaction;
     transaction.to_add = session.packages;
 
+    // Map before committing: the pool moves uploaded files away on commit and
+    // the parsed artifacts are still cached under their upload paths.
+    auto deployed_packages =
+        Utilities::map_entries(session.packages, [this](PackageDTO const& package) {
+            return PackageDTOMapper::to_entity(package, m_package_cache);
+        });
+
     auto commit_result = co_await m_package_service.commit_transaction(transaction);
 
     if (!commit_result.has_value()) {
+        // The failed commit moved the uploads back to staging, they go with the session
+        std::error_code ec;
+        for (auto const& package : session.packages) {
+            for (auto const& [location, entry] : package.pool_entries) {
+                std::filesystem::remove(entry.filepath, ec);
+                if (entry.signature_path) {
+                    std::filesystem::remove(*entry.signature_path, ec);
+                }
+            }
+        }
+        m_session_packages.erase(session_id);
+
         co_return bxt::make_error_with_source<Error>(std::move(commit_result.error()),
                                                      Error::ErrorType::DeploymentFailed);
     }
 
+    // The deploy is reported once clients can see it, the packages are committed either way
+    if (!co_await m_writeback.flush()) {
+        logw("Deployment: Session {} is committed, but not published yet", session_id);
+    }
+
     co_await m_dispatcher.dispatch_single_async<Core::Application::Events::IntegrationEventPtr>(
         std::make_shared<Core::Application::Events::DeploySuccess>(
-            session.run_id,
-            std::move(Utilities::map_entries(session.packages, PackageDTOMapper::to_entity))));
+            session.run_id, std::move(deployed_packages)));
 
     m_session_packages.erase(session_id);
 
@@ -10,8 +10,10 @@
 #include "core/application/services/DeploymentService.h"
 #include "core/application/services/PackageService.h"
 #include "core/domain/repositories/PackageRepositoryBase.h"
+#include "core/domain/repositories/WritebackSchedulerBase.h"
 #include "dexode/EventBus.hpp"
 #include "PackageService.h"
+#include "utilities/alpmdb/ParsedPackageCache.h"
 #include "utilities/eventbus/EventBusDispatcher.h"
 #include "utilities/StaticDTOMapper.h"
 
@@ -28,11 +30,15 @@ public:
         Utilities::EventBusDispatcher& dispatcher,
         bxt::Core::Application::PackageService& service,
         bxt::Core::Domain::ReadOnlyRepositoryBase<bxt::Core::Domain::Section>& section_repository,
-        UnitOfWorkBaseFactory& uow_factory)
+        UnitOfWorkBaseFactory& uow_factory,
+        bxt::Core::Domain::WritebackSchedulerBase& writeback,
+        Utilities::AlpmDb::ParsedPackageCache& package_cache)
         : m_dispatcher(dispatcher)
         , m_package_service(service)
         , m_section_repository(section_repository)
-        , m_uow_factory(uow_factory) {
+        , m_uow_factory(uow_factory)
+        , m_writeback(writeback)
+        , m_package_cache(package_cache) {
     }
 
     virtual coro::task<Result<uint64_t>> deploy_start(RequestContext const context) override;
@@ -52,6 +58,8 @@ private:
     bxt::Core::Application::PackageService& m_package_service;
     bxt::Core::Domain::ReadOnlyRepositoryBase<bxt::Core::Domain::Section>& m_section_repository;
     UnitOfWorkBaseFactory& m_uow_factory;
+    bxt::Core::Domain::WritebackSchedulerBase& m_writeback;
+    Utilities::AlpmDb::ParsedPackageCache& m_package_cache;
 };
 
 } // namespace bxt::Infrastructure
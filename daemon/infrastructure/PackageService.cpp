@@ -151,23 +151,16 @@ coro::task<PackageService::Result<void>>
 coro::task<PackageService::Result<void>>
     PackageService::add_package(PackageDTO const package,
                                 std::shared_ptr<UnitOfWorkBase> unitofwork) {
-    auto deployed_entity = PackageDTOMapper::to_entity(package);
+    auto deployed_entity = PackageDTOMapper::to_entity(package, m_package_cache);
 
-    auto current_entitites = co_await m_repository.find_by_section_async(
-        SectionDTOMapper::to_entity(package.section), unitofwork);
+    auto current_entity = co_await m_repository.find_by_section_async(
+        SectionDTOMapper::to_entity(package.section), deployed_entity.name(), unitofwork);
 
-    if (!current_entitites.has_value()) {
-        co_return bxt::make_error<CrudError>(CrudError::ErrorType::InvalidArgument);
-    }
-
-    auto current_entity = std::ranges::find(*current_entitites, package.name, &Package::name);
-
-    if (current_entity != current_entitites->end()
-        && deployed_entity.version() <= current_entity->version()) {
+    if (current_entity.has_value() && deployed_entity.version() <= current_entity->version()) {
         co_return bxt::make_error<CrudError>(CrudError::ErrorType::EntityAlreadyExists);
     }
 
-    auto saved = co_await m_repository.save_async(PackageDTOMapper::to_entity(package), unitofwork);
+    auto saved = co_await m_repository.save_async(deployed_entity, unitofwork);
 
     if (!saved.has_value()) {
         co_return bxt::make_error_with_source<CrudError>(std::move(saved.error()),
@@ -183,14 +176,14 @@ coro::task<PackageService::Result<std::vector<PackageDTO>>>
     std::vector<PackageDTO> result;
 
     auto result_entities =
-        co_await m_repository.find_by_section_async(section, co_await m_uow_factory());
+        co_await m_repository.find_shared_by_section_async(section, co_await m_uow_factory());
 
     if (!result_entities.has_value()) {
         co_return result;
     }
 
-    result.reserve(result_entities->size());
-    std::ranges::transform(*result_entities, std::back_inserter(result), PackageDTOMapper::to_dto);
+    result.reserve((*result_entities)->size());
+    std::ranges::transform(**result_entities, std::back_inserter(result), PackageDTOMapper::to_dto);
 
     co_return result;
 }
@@ -249,7 +242,10 @@ coro::task<PackageService::Result<void>> PackageService::snap(PackageSectionDTO
 
 coro::task<PackageService::Result<void>> PackageService::push(Transaction const transaction,
                                                               RequestContext const context) {
-    auto packages_to_add = Utilities::map_entries(transaction.to_add, PackageDTOMapper::to_entity);
+    auto packages_to_add =
+        Utilities::map_entries(transaction.to_add, [this](PackageDTO const& package) {
+            return PackageDTOMapper::to_entity(package, m_package_cache);
+        });
 
     auto ids_to_remove =
         transaction.to_delete | std::views::transform([](Transaction::PackageAction const& value) {
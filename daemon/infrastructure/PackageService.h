@@ -15,6 +15,7 @@
 #include "core/domain/repositories/UnitOfWorkBase.h"
 #include "coro/task.hpp"
 #include "PackageServiceOptions.h"
+#include "utilities/alpmdb/ParsedPackageCache.h"
 #include "utilities/eventbus/EventBusDispatcher.h"
 
 #include <memory>
@@ -26,11 +27,13 @@ public:
     PackageService(Utilities::EventBusDispatcher& dispatcher,
                    Core::Domain::PackageRepositoryBase& repository,
                    Core::Domain::ReadOnlyRepositoryBase<Core::Domain::Section>& section_repository,
-                   UnitOfWorkBaseFactory& uow_factory)
+                   UnitOfWorkBaseFactory& uow_factory,
+                   Utilities::AlpmDb::ParsedPackageCache& package_cache)
         : m_dispatcher(dispatcher)
         , m_repository(repository)
         , m_section_repository(section_repository)
-        , m_uow_factory(uow_factory) {
+        , m_uow_factory(uow_factory)
+        , m_package_cache(package_cache) {
     }
 
     virtual coro::task<Result<void>> commit_transaction(Transaction const transaction) override;
@@ -69,6 +72,7 @@ private:
     Core::Domain::PackageRepositoryBase& m_repository;
     Core::Domain::ReadOnlyRepositoryBase<Section>& m_section_repository;
     UnitOfWorkBaseFactory& m_uow_factory;
+    Utilities::AlpmDb::ParsedPackageCache& m_package_cache;
 };
 
 } // namespace bxt::Infrastructure
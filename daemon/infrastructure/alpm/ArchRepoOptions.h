@@ -19,7 +19,8 @@ namespace bxt::Infrastructure {
 
 struct ArchRepoOptions : public Utilities::RepoSchema::Extension {
     phmap::parallel_flat_hash_map<Core::Application::PackageSectionDTO, ArchRepoSource> sources;
-    std::filesystem::path download_path = "/var/cache/bxt/packages";
+    // Empty downloads into the box's staging directory, next to the pool
+    std::filesystem::path download_path;
 
     virtual void parse(const YAML::Node& root_node) override {
         constexpr char Tag[] = "(alpm.sync)";
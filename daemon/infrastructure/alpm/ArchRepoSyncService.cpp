@@ -233,17 +233,17 @@ std::optional<ArchRepoSyncService::PackageInfo> parse_descfile(auto& entry) {
         return {};
     }
 
-    auto signature = desc.get("PGPSIG");
+    std::optional<std::string> signature;
 
-    if (signature.has_value()) {
-        signature = bxt::Utilities::b64_decode(*signature);
+    if (auto const encoded = desc.get("PGPSIG"); encoded.has_value()) {
+        signature = bxt::Utilities::b64_decode(*encoded);
     }
 
-    return ArchRepoSyncService::PackageInfo {.name = *name,
-                                             .filename = *filename,
+    return ArchRepoSyncService::PackageInfo {.name = std::string(*name),
+                                             .filename = std::string(*filename),
                                              .version = *version,
-                                             .hash = *hash,
-                                             .signature = signature};
+                                             .hash = std::string(*hash),
+                                             .signature = std::move(signature)};
 }
 coro::task<ArchRepoSyncService::Result<std::vector<ArchRepoSyncService::PackageInfo>>>
     ArchRepoSyncService::get_available_packages(PackageSectionDTO const section) {
@@ -397,8 +397,9 @@ coro::task<ArchRepoSyncService::Result<Package>>
         }
     }
 
-    auto result = Package::from_file_path(SectionDTOMapper::to_entity(section),
-                                          Core::Domain::PoolLocation::Sync, full_filename);
+    auto result =
+        Package::from_file_path(m_package_cache, SectionDTOMapper::to_entity(section),
+                                Core::Domain::PoolLocation::Sync, full_filename);
 
     if (result.has_value()) {
         co_return result.value();
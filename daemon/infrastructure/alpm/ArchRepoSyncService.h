@@ -12,6 +12,7 @@
 #include "core/domain/entities/Package.h"
 #include "core/domain/repositories/PackageRepositoryBase.h"
 #include "core/domain/repositories/UnitOfWorkBase.h"
+#include "utilities/alpmdb/ParsedPackageCache.h"
 #include "utilities/Error.h"
 #include "utilities/eventbus/EventBusDispatcher.h"
 
@@ -49,11 +50,13 @@ public:
     ArchRepoSyncService(Utilities::EventBusDispatcher& dispatcher,
                         PackageRepositoryBase& package_repository,
                         ArchRepoOptions& options,
-                        UnitOfWorkBaseFactory& uow_factory)
+                        UnitOfWorkBaseFactory& uow_factory,
+                        Utilities::AlpmDb::ParsedPackageCache& package_cache)
         : m_dispatcher(dispatcher)
         , m_package_repository(package_repository)
         , m_options(options)
-        , m_uow_factory(uow_factory) {
+        , m_uow_factory(uow_factory)
+        , m_package_cache(package_cache) {
     }
 
     coro::task<SyncService::Result<void>> sync(PackageSectionDTO const section,
@@ -83,6 +86,7 @@ private:
     Utilities::EventBusDispatcher& m_dispatcher;
     PackageRepositoryBase& m_package_repository;
     UnitOfWorkBaseFactory& m_uow_factory;
+    Utilities::AlpmDb::ParsedPackageCache& m_package_cache;
 
     ArchRepoOptions m_options;
     std::shared_ptr<coro::io_scheduler> tp =
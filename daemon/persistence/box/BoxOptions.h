@@ -8,6 +8,7 @@
 
 #include "utilities/configuration/Configuration.h"
 
+#include <cstdint>
 #include <filesystem>
 
 namespace bxt::Persistence::Box {
@@ -15,11 +16,73 @@ namespace bxt::Persistence::Box {
 struct BoxOptions {
     std::filesystem::path box_path = "box";
 
+    // Uploads and downloads are written here, on the pool's file system, so
+    // they're renamed into the pool instead of copied
+    std::filesystem::path staging_path() const {
+        return std::filesystem::absolute(box_path / ".staging");
+    }
+
+    // Memory available for decoded section package lists, in MiB. 0 disables the cache
+    int64_t section_cache_budget = 64;
+    // How often cache and writeback statistics are logged, in seconds. 0 disables the log
+    int64_t stats_interval = 300;
+    // How many dirty sections are exported at the same time
+    int64_t export_concurrency = 4;
+
+    // zstd settings of exported databases. 0 threads uses one per CPU core and
+    // a negative count keeps libarchive's default, the long-distance matching
+    // window is a power of two, 0 disables it
+    int64_t export_zstd_level = 3;
+    int64_t export_zstd_threads = -1;
+    int64_t export_zstd_long = 0;
+    // Level the published databases are recompressed with in the background,
+    // 0 keeps the export level
+    int64_t export_recompress_level = 0;
+
+    // A section is exported once no commit touched it for the quiet period, but
+    // no later than the maximum delay after its first unpublished commit, in ms
+    int64_t writeback_quiet_period = 500;
+    int64_t writeback_max_delay = 5000;
+
+    // Serves the box directory read-only under /box/, databases are kept in a
+    // memory cache of the given size in MiB
+    bool serve_box = false;
+    int64_t serve_cache_budget = 32;
+
     void serialize(Utilities::Configuration& config) {
         config.set("box-path", box_path.string());
+        config.set("section-cache-budget", section_cache_budget);
+        config.set("stats-interval", stats_interval);
+        config.set("export-concurrency", export_concurrency);
+        config.set("export-zstd-level", export_zstd_level);
+        config.set("export-zstd-threads", export_zstd_threads);
+        config.set("export-zstd-long", export_zstd_long);
+        config.set("export-recompress-level", export_recompress_level);
+        config.set("writeback-quiet-period", writeback_quiet_period);
+        config.set("writeback-max-delay", writeback_max_delay);
+        config.set("serve-box", serve_box);
+        config.set("serve-cache-budget", serve_cache_budget);
     }
     void deserialize(Utilities::Configuration const& config) {
         box_path = config.get<std::string>("box-path").value_or(box_path);
+        section_cache_budget =
+            config.get<int64_t>("section-cache-budget").value_or(section_cache_budget);
+        stats_interval = config.get<int64_t>("stats-interval").value_or(stats_interval);
+        export_concurrency =
+            config.get<int64_t>("export-concurrency").value_or(export_concurrency);
+        export_zstd_level = config.get<int64_t>("export-zstd-level").value_or(export_zstd_level);
+        export_zstd_threads =
+            config.get<int64_t>("export-zstd-threads").value_or(export_zstd_threads);
+        export_zstd_long = config.get<int64_t>("export-zstd-long").value_or(export_zstd_long);
+        export_recompress_level =
+            config.get<int64_t>("export-recompress-level").value_or(export_recompress_level);
+        writeback_quiet_period =
+            config.get<int64_t>("writeback-quiet-period").value_or(writeback_quiet_period);
+        writeback_max_delay =
+            config.get<int64_t>("writeback-max-delay").value_or(writeback_max_delay);
+        serve_box = config.get<bool>("serve-box").value_or(serve_box);
+        serve_cache_budget =
+            config.get<int64_t>("serve-cache-budget").value_or(serve_cache_budget);
     }
 };
 
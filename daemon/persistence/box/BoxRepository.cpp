@@ -21,15 +21,18 @@
 #include "utilities/alpmdb/Desc.h"
 #include "utilities/Error.h"
 #include "utilities/StaticDTOMapper.h"
+#include "utilities/log/Logging.h"
 #include "utilities/to_string.h"
 
 #include <coro/sync_wait.hpp>
+#include <algorithm>
 #include <expected>
 #include <fmt/core.h>
 #include <fmt/format.h>
 #include <functional>
 #include <kangaru/operator.hpp>
 #include <optional>
+#include <parallel_hashmap/phmap.h>
 #include <ranges>
 #include <string>
 #include <vector>
@@ -42,46 +45,60 @@ BoxRepository::BoxRepository(BoxOptions options,
     : m_options(std::move(options))
     , m_package_store(package_store)
     , m_scheduler(writeback_sceduler)
-    , m_exporter(exporter) {};
+    , m_exporter(exporter)
+    , m_cache(std::max<int64_t>(m_options.section_cache_budget, 0) * 1024 * 1024) {};
+
+coro::task<void> BoxRepository::make_writeback_hooks(std::vector<Package> const& packages,
+                                                     std::shared_ptr<UnitOfWorkBase> uow) {
+    phmap::flat_hash_set<std::string> sections;
+    for (auto const& package : packages) {
+        if (sections.emplace(package.section().string()).second) {
+            co_await make_writeback_hook(package.section(), uow);
+        }
+    }
+}
 
-void BoxRepository::make_writeback_hook(Section const section,
-                                        std::shared_ptr<UnitOfWorkBase> uow) {
-    m_exporter.add_dirty_sections({SectionDTOMapper::to_dto(section)});
+coro::task<void> BoxRepository::make_writeback_hook(Section const section,
+                                                    std::shared_ptr<UnitOfWorkBase> uow) {
+    // Committed with the change, a crash before the export can't lose the section
+    if (auto marked = co_await m_package_store.mark_dirty(SectionDTOMapper::to_dto(section), uow);
+        !marked) {
+        logw("Box: Can't journal the export of \"{}\", the error is \"{}\"",
+             section.string(), marked.error().what());
+    }
+
+    // Runs before the commit, so readers of the new snapshot never get the old list
+    if (auto generation = m_package_store.generation(uow); generation.has_value()) {
+        uow->hook(
+            [this, section = SectionDTOMapper::to_dto(section), id = generation->id] {
+                m_cache.invalidate(section, id);
+            },
+            fmt::format("Box::Cache::Invalidate::{}", section.string()));
+    }
 
-    uow->hook(
+    // Marked once the change is committed, an export that takes the mark reads
+    // a snapshot with the change in it
+    uow->post_commit_hook(
         [this, section = SectionDTOMapper::to_dto(section)] {
-            coro::sync_wait(m_scheduler.schedule([](auto self, auto section) -> coro::task<void> {
-                co_await self->m_exporter.export_to_disk();
-                co_return;
-            }(this, section)));
+            m_exporter.add_dirty_sections({section});
+            m_scheduler.schedule(section);
         },
-        "Box::Exporter::WriteBack");
+        fmt::format("Box::Exporter::WriteBack::{}", section.string()));
 }
 
 coro::task<BoxRepository::TResult>
     BoxRepository::find_by_id_async(TId id, std::shared_ptr<UnitOfWorkBase> uow) {
-    std::optional<BoxRepository::TResult> result;
-    auto accept_ok = co_await m_package_store.accept(
-        [&](std::string_view key, PackageRecord const& value) {
-            if (value.id.section == SectionDTOMapper::to_dto(id.section)
-                && value.id.name == id.package_name) {
-                result = RecordMapper::to_entity(value);
-                return Utilities::NavigationAction::Stop;
-            }
-            return Utilities::NavigationAction::Next;
-        },
-        bxt::to_string(id), uow);
-
-    if (!result.has_value()) {
-        co_return bxt::make_error<ReadError>(ReadError::EntityNotFound);
-    }
+    auto record = co_await m_package_store.find_by_id(
+        PackageRecord::Id {.section = SectionDTOMapper::to_dto(id.section),
+                           .name = id.package_name},
+        uow);
 
-    if (!accept_ok.has_value()) {
-        co_return bxt::make_error_with_source<ReadError>(std::move(accept_ok.error()),
-                                                         ReadError::EntityFindError);
+    if (!record.has_value()) {
+        co_return bxt::make_error_with_source<ReadError>(std::move(record.error()),
+                                                         ReadError::EntityNotFound);
     }
 
-    co_return *result;
+    co_return RecordMapper::to_entity(*record);
 }
 
 coro::task<BoxRepository::TResult>
@@ -150,25 +167,21 @@ coro::task<BoxRepository::TResults> BoxRepository::all_async(std::shared_ptr<Uni
 coro::task<BoxRepository::WriteResult<void>>
     BoxRepository::add_async(std::vector<Package> const entity,
                              std::shared_ptr<UnitOfWorkBase> uow) {
-    auto tasks =
-        entity | std::views::transform(RecordMapper::to_record)
-        | std::views::transform([&](auto&& record) { return m_package_store.add(record, uow); })
-        | std::ranges::to<std::vector>();
-
-    auto added_list = co_await coro::when_all(std::move(tasks));
-    for (auto const& added : added_list) {
-        auto& added_result = added.return_value();
-        if (!added_result.has_value()) {
-            co_return bxt::make_error_with_source<WriteError>(std::move(added_result.error()),
-                                                              WriteError::OperationError);
-        }
+    if (entity.empty()) {
+        co_return {};
     }
 
-    for (auto const section :
-         entity | std::views::transform([](auto const& pkg) { return pkg.section(); })) {
-        make_writeback_hook(section, uow);
+    auto records = entity | std::views::transform(RecordMapper::to_record)
+                   | std::ranges::to<std::vector>();
+
+    auto added = co_await m_package_store.add(std::move(records), uow);
+    if (!added.has_value()) {
+        co_return bxt::make_error_with_source<WriteError>(std::move(added.error()),
+                                                          WriteError::OperationError);
     }
 
+    co_await make_writeback_hooks(entity, uow);
+
     co_return {};
 }
 coro::task<BoxRepository::WriteResult<void>>
@@ -180,7 +193,7 @@ coro::task<BoxRepository::WriteResult<void>>
                                                           WriteError::OperationError);
     }
 
-    make_writeback_hook(entity.section(), uow);
+    co_await make_writeback_hook(entity.section(), uow);
 
     co_return {};
 }
@@ -206,7 +219,7 @@ coro::task<BoxRepository::WriteResult<void>>
 
     for (auto const section :
          ids | std::views::transform([](auto const& id) { return id.section; })) {
-        make_writeback_hook(section, uow);
+        co_await make_writeback_hook(section, uow);
     }
 
     co_return {};
@@ -224,32 +237,56 @@ coro::task<BoxRepository::WriteResult<void>>
                                                           WriteError::OperationError);
     }
 
-    make_writeback_hook(id.section, uow);
+    co_await make_writeback_hook(id.section, uow);
     co_return {};
 }
 
 coro::task<BoxRepository::WriteResult<void>>
     BoxRepository::update_async(std::vector<Package> const entity,
                                 std::shared_ptr<UnitOfWorkBase> uow) {
-    auto tasks =
-        entity | std::views::transform(RecordMapper::to_record)
-        | std::views::transform([&](auto&& record) { return m_package_store.update(record, uow); })
-        | std::ranges::to<std::vector>();
+    if (entity.empty()) {
+        co_return {};
+    }
 
-    auto updated_list = co_await coro::when_all(std::move(tasks));
-    for (auto const& updated : updated_list) {
-        auto& updated_result = updated.return_value();
-        if (!updated_result.has_value()) {
-            co_return bxt::make_error_with_source<WriteError>(std::move(updated_result.error()),
-                                                              WriteError::OperationError);
+    auto records = entity | std::views::transform(RecordMapper::to_record)
+                   | std::ranges::to<std::vector>();
+
+    auto updated = co_await m_package_store.update(std::move(records), uow);
+    if (!updated.has_value()) {
+        co_return bxt::make_error_with_source<WriteError>(std::move(updated.error()),
+                                                          WriteError::OperationError);
+    }
+
+    co_await make_writeback_hooks(entity, uow);
+
+    co_return {};
+}
+
+coro::task<BoxRepository::WriteResult<void>>
+    BoxRepository::save_async(std::vector<Package> const entities,
+                              std::shared_ptr<UnitOfWorkBase> uow) {
+    std::vector<Package> to_add;
+    std::vector<Package> to_update;
+
+    for (auto const& entity : entities) {
+        auto const id = entity.id();
+        auto existing = co_await m_package_store.find_by_id(
+            PackageRecord::Id {.section = SectionDTOMapper::to_dto(id.section),
+                               .name = id.package_name},
+            uow);
+
+        if (existing.has_value()) {
+            to_update.emplace_back(entity);
+        } else {
+            to_add.emplace_back(entity);
         }
     }
 
-    for (auto const section :
-         entity | std::views::transform([](auto const& e) { return e.section(); })) {
-        make_writeback_hook(section, uow);
+    if (auto added = co_await add_async(std::move(to_add), uow); !added.has_value()) {
+        co_return std::unexpected(std::move(added.error()));
     }
-    co_return {};
+
+    co_return co_await update_async(std::move(to_update), uow);
 }
 
 coro::task<BoxRepository::WriteResult<void>>
@@ -260,16 +297,27 @@ coro::task<BoxRepository::WriteResult<void>>
                                                           WriteError::OperationError);
     }
 
-    make_writeback_hook(entity.section(), uow);
+    co_await make_writeback_hook(entity.section(), uow);
 
     co_return {};
 }
 
-coro::task<BoxRepository::TResults>
-    BoxRepository::find_by_section_async(Section const section,
-                                         std::shared_ptr<UnitOfWorkBase> uow) {
-    auto packages =
-        co_await m_package_store.find_by_section(SectionDTOMapper::to_dto(section), uow);
+coro::task<BoxRepository::TSharedResults>
+    BoxRepository::find_shared_by_section_async(Section const section,
+                                                std::shared_ptr<UnitOfWorkBase> uow) {
+    auto const section_dto = SectionDTOMapper::to_dto(section);
+
+    // Write transactions may see their own uncommitted changes, so they bypass the cache
+    auto const generation = m_package_store.generation(uow);
+    bool const cacheable = generation.has_value() && generation->read_only;
+
+    if (cacheable) {
+        if (auto cached = m_cache.find(section_dto, generation->id)) {
+            co_return cached;
+        }
+    }
+
+    auto packages = co_await m_package_store.find_by_section(section_dto, uow);
 
     if (!packages.has_value()) {
         co_return bxt::make_error_with_source<ReadError>(std::move(packages.error()),
@@ -279,35 +327,58 @@ coro::task<BoxRepository::TResults>
     std::vector<Core::Domain::Package> result;
     result.reserve(packages->size());
 
+    size_t size = 0;
     for (auto const& package : *packages) {
-        auto entity = RecordMapper::to_entity(package);
+        size += sizeof(Core::Domain::Package) + package.id.name.size();
+        for (auto const& [location, description] : package.descriptions) {
+            size += sizeof(Core::Domain::PackagePoolEntry) + description.descfile.desc().size()
+                    + description.descfile.files().size() + description.filepath.native().size();
+        }
 
-        result.emplace_back(entity);
+        result.emplace_back(RecordMapper::to_entity(package));
     }
 
-    co_return result;
+    auto snapshot = std::make_shared<std::vector<Core::Domain::Package> const>(std::move(result));
+
+    if (cacheable) {
+        m_cache.store(section_dto, generation->id, snapshot, size);
+
+        auto const stats = m_cache.stats();
+        logd("Box: Section cache miss for {} (hits: {}, misses: {}, evictions: {}, {} KiB used)",
+             std::string(section_dto), stats.hits, stats.misses, stats.evictions,
+             stats.memory / 1024);
+    }
+
+    co_return snapshot;
+}
+
+coro::task<BoxRepository::TResults>
+    BoxRepository::find_by_section_async(Section const section,
+                                         std::shared_ptr<UnitOfWorkBase> uow) {
+    auto packages = co_await find_shared_by_section_async(section, uow);
+
+    if (!packages.has_value()) {
+        co_return std::unexpected(std::move(packages.error()));
+    }
+
+    co_return **packages;
 }
 
 coro::task<BoxRepository::TResults>
     BoxRepository::find_by_section_async(Section const section,
                                          std::function<bool(Package const&)> const predicate,
                                          std::shared_ptr<UnitOfWorkBase> uow) {
-    auto packages =
-        co_await m_package_store.find_by_section(SectionDTOMapper::to_dto(section), uow);
+    auto packages = co_await find_shared_by_section_async(section, uow);
 
     if (!packages.has_value()) {
-        co_return bxt::make_error_with_source<ReadError>(std::move(packages.error()),
-                                                         ReadError::InvalidArgument);
-    };
+        co_return std::unexpected(std::move(packages.error()));
+    }
 
     std::vector<Core::Domain::Package> result;
-    result.reserve(packages->size());
 
-    for (auto const& package : *packages) {
-        auto entity = RecordMapper::to_entity(package);
-
-        if (predicate(entity)) {
-            result.emplace_back(entity);
+    for (auto const& package : **packages) {
+        if (predicate(package)) {
+            result.emplace_back(package);
         }
     }
 
@@ -316,21 +387,34 @@ coro::task<BoxRepository::TResults>
 
 coro::task<BoxRepository::TResult> BoxRepository::find_by_section_async(
     Section const section, Name const name, std::shared_ptr<UnitOfWorkBase> uow) {
-    std::optional<Core::Domain::Package> result;
+    co_return co_await find_by_id_async(Package::TId {section, name}, uow);
+}
 
-    co_await m_package_store.accept(
-        [&result](std::string_view key, auto const& record) {
-            result = RecordMapper::to_entity(record);
+coro::task<BoxRepository::TResults>
+    BoxRepository::find_by_name_async(Name const name, std::shared_ptr<UnitOfWorkBase> uow) {
+    auto records = co_await m_package_store.find_by_name(name, uow);
 
-            return Utilities::NavigationAction::Stop;
-        },
-        fmt::format("{}/{}", section.string(), name), uow);
+    if (!records.has_value()) {
+        co_return bxt::make_error_with_source<ReadError>(std::move(records.error()),
+                                                         ReadError::EntityFindError);
+    }
 
-    if (result.has_value()) {
-        co_return *result;
-    } else {
-        co_return bxt::make_error<ReadError>(ReadError::EntityNotFound);
+    co_return *records | std::views::transform(RecordMapper::to_entity)
+        | std::ranges::to<std::vector>();
+}
+
+coro::task<BoxRepository::TResults>
+    BoxRepository::find_by_file_path_async(std::filesystem::path const file_path,
+                                           std::shared_ptr<UnitOfWorkBase> uow) {
+    auto records = co_await m_package_store.find_by_pool_path(file_path, uow);
+
+    if (!records.has_value()) {
+        co_return bxt::make_error_with_source<ReadError>(std::move(records.error()),
+                                                         ReadError::EntityFindError);
     }
+
+    co_return *records | std::views::transform(RecordMapper::to_entity)
+        | std::ranges::to<std::vector>();
 }
 
 } // namespace bxt::Persistence::Box
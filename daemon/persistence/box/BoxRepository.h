@@ -13,6 +13,7 @@
 #include "core/domain/repositories/UnitOfWorkBase.h"
 #include "coro/task.hpp"
 #include "persistence/box/BoxOptions.h"
+#include "persistence/box/cache/SectionCache.h"
 #include "persistence/box/export/ExporterBase.h"
 #include "persistence/box/store/PackageStoreBase.h"
 #include "persistence/box/writeback/WritebackScheduler.h"
@@ -48,6 +49,10 @@ public:
                                                std::shared_ptr<UnitOfWorkBase> uow) override;
     coro::task<WriteResult<void>> update_async(std::vector<Package> const entity,
                                                std::shared_ptr<UnitOfWorkBase> uow) override;
+    using PackageRepositoryBase::save_async;
+    coro::task<WriteResult<void>> save_async(std::vector<Package> const entities,
+                                             std::shared_ptr<UnitOfWorkBase> uow) override;
+
     coro::task<WriteResult<void>> delete_async(TId const id,
                                                std::shared_ptr<UnitOfWorkBase> uow) override;
 
@@ -57,6 +62,11 @@ public:
     coro::task<TResults> find_by_section_async(Section const section,
                                                std::shared_ptr<UnitOfWorkBase> uow) override;
 
+    // Decoded package list of the section, shared with the cache when possible
+    coro::task<TSharedResults>
+        find_shared_by_section_async(Section const section,
+                                     std::shared_ptr<UnitOfWorkBase> uow) override;
+
     coro::task<TResults> find_by_section_async(Section const section,
                                                std::function<bool(Package const&)> const predicate,
                                                std::shared_ptr<UnitOfWorkBase> uow) override;
@@ -65,8 +75,21 @@ public:
                                               Name const name,
                                               std::shared_ptr<UnitOfWorkBase> uow) override;
 
+    coro::task<TResults> find_by_name_async(Name const name,
+                                            std::shared_ptr<UnitOfWorkBase> uow) override;
+
+    coro::task<TResults> find_by_file_path_async(std::filesystem::path const file_path,
+                                                 std::shared_ptr<UnitOfWorkBase> uow) override;
+
+    SectionCache::Stats cache_stats() const {
+        return m_cache.stats();
+    }
+
 private:
-    void make_writeback_hook(Section const section, std::shared_ptr<UnitOfWorkBase> uow);
+    coro::task<void> make_writeback_hook(Section const section,
+                                         std::shared_ptr<UnitOfWorkBase> uow);
+    coro::task<void> make_writeback_hooks(std::vector<Package> const& packages,
+                                          std::shared_ptr<UnitOfWorkBase> uow);
     BoxOptions m_options;
 
     PackageStoreBase& m_package_store;
@@ -74,6 +97,8 @@ private:
     ExporterBase& m_exporter;
     WritebackScheduler& m_scheduler;
 
+    SectionCache m_cache;
+
     std::filesystem::path m_root_path;
 };
 
@@ -0,0 +1,103 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "SectionCache.h"
+
+#include <algorithm>
+
+namespace bxt::Persistence::Box {
+
+SectionCache::Snapshot SectionCache::find(Section const& section, uint64_t generation) {
+    std::lock_guard lock(m_mutex);
+
+    auto const modified_it = m_modified.find(section);
+    auto const modified = modified_it != m_modified.end() ? modified_it->second : 0;
+
+    auto it = m_entries.find(section);
+    if (it == m_entries.end() || generation < modified) {
+        ++m_stats.misses;
+        return nullptr;
+    }
+
+    if (it->second.generation < modified) {
+        m_stats.memory -= it->second.size;
+        m_entries.erase(it);
+        ++m_stats.misses;
+        return nullptr;
+    }
+
+    it->second.last_used = ++m_clock;
+    ++m_stats.hits;
+
+    return it->second.packages;
+}
+
+void SectionCache::store(Section const& section,
+                         uint64_t generation,
+                         Snapshot packages,
+                         size_t size) {
+    if (size > m_budget) {
+        return;
+    }
+
+    std::lock_guard lock(m_mutex);
+
+    if (auto modified_it = m_modified.find(section);
+        modified_it != m_modified.end() && generation < modified_it->second) {
+        return;
+    }
+
+    auto [it, inserted] = m_entries.try_emplace(section);
+    if (!inserted) {
+        if (it->second.generation >= generation) {
+            return;
+        }
+        m_stats.memory -= it->second.size;
+    }
+
+    it->second = Entry {.generation = generation,
+                        .packages = std::move(packages),
+                        .size = size,
+                        .last_used = ++m_clock};
+    m_stats.memory += size;
+
+    evict();
+}
+
+void SectionCache::invalidate(Section const& section, uint64_t generation) {
+    std::lock_guard lock(m_mutex);
+
+    auto& modified = m_modified[section];
+    modified = std::max(modified, generation);
+
+    if (auto it = m_entries.find(section); it != m_entries.end()) {
+        m_stats.memory -= it->second.size;
+        m_entries.erase(it);
+    }
+}
+
+SectionCache::Stats SectionCache::stats() const {
+    std::lock_guard lock(m_mutex);
+
+    auto result = m_stats;
+    result.entries = m_entries.size();
+
+    return result;
+}
+
+// Drops least recently used sections until the cache fits into the budget
+void SectionCache::evict() {
+    while (m_stats.memory > m_budget && !m_entries.empty()) {
+        auto oldest = std::ranges::min_element(
+            m_entries, {}, [](auto const& entry) { return entry.second.last_used; });
+
+        m_stats.memory -= oldest->second.size;
+        m_entries.erase(oldest);
+        ++m_stats.evictions;
+    }
+}
+
+} // namespace bxt::Persistence::Box
@@ -0,0 +1,71 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "core/application/dtos/PackageSectionDTO.h"
+#include "core/domain/entities/Package.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <parallel_hashmap/phmap.h>
+#include <vector>
+
+namespace bxt::Persistence::Box {
+
+// Keeps decoded package lists of sections as immutable shared snapshots.
+//
+// Generations are database snapshot ids. Every section remembers the
+// generation of the last write touching it, a list decoded at generation G is
+// only stored and served while the section wasn't written after G, and only
+// to readers whose own snapshot is not older than that write.
+class SectionCache {
+public:
+    using Snapshot = std::shared_ptr<std::vector<Core::Domain::Package> const>;
+    using Section = Core::Application::PackageSectionDTO;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t memory = 0;
+    };
+
+    explicit SectionCache(size_t budget)
+        : m_budget(budget) {
+    }
+
+    Snapshot find(Section const& section, uint64_t generation);
+
+    void store(Section const& section, uint64_t generation, Snapshot packages, size_t size);
+
+    // Called before the writer's changes become visible
+    void invalidate(Section const& section, uint64_t generation);
+
+    Stats stats() const;
+
+private:
+    struct Entry {
+        uint64_t generation;
+        Snapshot packages;
+        size_t size;
+        uint64_t last_used;
+    };
+
+    void evict();
+
+    size_t m_budget;
+
+    mutable std::mutex m_mutex;
+    phmap::flat_hash_map<Section, Entry> m_entries;
+    phmap::flat_hash_map<Section, uint64_t> m_modified;
+    uint64_t m_clock = 0;
+    Stats m_stats;
+};
+
+} // namespace bxt::Persistence::Box
@@ -9,54 +9,289 @@
 #include "core/application/dtos/PackageSectionDTO.h"
 #include "core/domain/enums/PoolLocation.h"
 #include "core/domain/repositories/UnitOfWorkBase.h"
-#include "utilities/alpmdb/Database.h"
 #include "utilities/Error.h"
 #include "utilities/errors/FsError.h"
 #include "utilities/libarchive/Error.h"
+#include "utilities/libarchive/Reader.h"
 #include "utilities/NavigationAction.h"
+#include "utilities/StreamingHash.h"
 
+#include <algorithm>
 #include <archive.h>
+#include <array>
+#include <chrono>
 #include <coro/sync_wait.hpp>
+#include <coro/when_all.hpp>
 #include <expected>
+#include <fcntl.h>
 #include <filesystem>
+#include <fstream>
+#include <initializer_list>
 #include <iterator>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <parallel_hashmap/phmap.h>
+#include <ranges>
+#include <set>
 #include <string_view>
+#include <string>
 #include <system_error>
+#include <unistd.h>
+#include <variant>
 
 namespace bxt::Persistence::Box {
-// Creates the symlink relative to target
-std::expected<void, FsError> create_relative_symlink(std::filesystem::path const& target,
-                                                     std::filesystem::path const& link) {
+// Points the link at the target unless it already does. An existing entry is
+// replaced with a rename, so the link never goes missing for clients.
+std::expected<void, FsError> replace_symlink(std::filesystem::path const& target,
+                                             std::filesystem::path const& link) {
     std::error_code ec;
 
-    if (std::filesystem::exists(link)) {
-        ec.assign(static_cast<int>(std::errc::file_exists), std::generic_category());
-        return bxt::make_error<FsError>(ec);
+    if (auto const current = std::filesystem::read_symlink(link, ec); !ec && current == target) {
+        return {};
     }
 
-    auto const relative_target = std::filesystem::relative(target, link.parent_path(), ec);
+    auto const temporary_link =
+        link.parent_path() / fmt::format(".{}.tmp", link.filename().string());
+
+    std::filesystem::remove(temporary_link, ec);
+
+    std::filesystem::create_symlink(target, temporary_link, ec);
     if (ec) {
         return bxt::make_error<FsError>(ec);
     }
 
-    std::filesystem::create_symlink(relative_target, link, ec);
+    std::filesystem::rename(temporary_link, link, ec);
     if (ec) {
+        std::error_code remove_ec;
+        std::filesystem::remove(temporary_link, remove_ec);
+
         return bxt::make_error<FsError>(ec);
     }
 
     return {};
 }
 
+// Flushes a file or a directory to disk. Archives have to be on disk before
+// they are renamed over the published ones, directories once the renames are done.
+bool sync_to_disk(std::filesystem::path const& path, bool directory) {
+    int const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | (directory ? O_DIRECTORY : 0));
+    if (fd < 0) {
+        return false;
+    }
+
+    bool const synced = (directory ? ::fsync(fd) : ::fdatasync(fd)) == 0;
+    ::close(fd);
+
+    return synced;
+}
+
+// File names of one of the section databases
+struct DatabaseNames {
+    std::string archive;
+    std::string link;
+
+    std::string temporary() const {
+        return fmt::format(".{}.tmp", archive);
+    }
+
+    std::string recompressed() const {
+        return fmt::format(".{}.recompress.tmp", archive);
+    }
+};
+
+DatabaseNames database_names(PackageSectionDTO const& section,
+                             AlpmDBExporter::DatabaseKind kind) {
+    auto const extension = kind == AlpmDBExporter::DatabaseKind::Packages ? "db" : "files";
+
+    return {.archive = fmt::format("{}.{}.tar.zst", section.repository, extension),
+            .link = fmt::format("{}.{}", section.repository, extension)};
+}
+
+// The .files database goes first, a client that sees the new .db finds matching file lists
+constexpr std::array DatabaseKinds {AlpmDBExporter::DatabaseKind::Files,
+                                    AlpmDBExporter::DatabaseKind::Packages};
+
+std::string digest_name(std::string const& archive_name) {
+    return fmt::format(".{}.digest", archive_name);
+}
+
+// Digest of what the section exports. Packages have to be sorted already, links
+// are sorted here so the digest doesn't depend on hash map order.
+std::string content_digest(AlpmDBExporter::SectionContents const& contents) {
+    constexpr std::string_view separator("\0", 1);
+
+    StreamingHash hash;
+
+    for (auto const& package : contents.packages) {
+        hash.update(package.directory).update(separator);
+        hash.update(package.desc).update(separator);
+
+        // Tells a missing file list from an empty one
+        hash.update(package.files ? "+" : "-");
+        if (package.files) {
+            hash.update(*package.files);
+        }
+        hash.update(separator);
+    }
+
+    std::vector<std::pair<std::string_view, std::string>> links;
+    links.reserve(contents.links.size());
+    for (auto const& [name, target] : contents.links) {
+        links.emplace_back(name, target.string());
+    }
+    std::ranges::sort(links);
+
+    for (auto const& [name, target] : links) {
+        hash.update(name).update(separator);
+        hash.update(target).update(separator);
+    }
+
+    return hash.hex_digest();
+}
+
+std::string read_digest(std::filesystem::path const& path) {
+    std::ifstream stream(path);
+
+    std::string digest;
+    std::getline(stream, digest);
+
+    return digest;
+}
+
+void write_digest(std::filesystem::path const& path, std::string const& digest) {
+    auto const temporary_path =
+        path.parent_path() / fmt::format("{}.tmp", path.filename().string());
+
+    {
+        std::ofstream stream(temporary_path, std::ios::trunc);
+        stream << digest << '\n';
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temporary_path, path, ec);
+    if (ec) {
+        logw("Exporter: Can't save the digest \"{}\", the error is \"{}\"", path.string(),
+             ec.message());
+        std::filesystem::remove(temporary_path, ec);
+    }
+}
+
+// Writes the database entries with fixed metadata, in the order of the packages.
+// The .files database repeats the desc entries as pacman reads both from it.
+std::expected<void, std::string> write_entries(Archive::Writer& writer,
+                                               AlpmDBExporter::SectionContents const& contents,
+                                               AlpmDBExporter::DatabaseKind kind) {
+    // Shared by all entries, only the name and the size change between them
+    auto header = Archive::Header::reproducible_file();
+    std::string path;
+
+    auto const write_entry =
+        [&writer, &header, &path](std::string_view directory, std::string_view name,
+                                  std::initializer_list<std::string_view> pieces)
+        -> std::expected<void, std::string> {
+        path.assign(directory).append("/").append(name);
+        archive_entry_set_pathname(header, path.c_str());
+
+        if (auto written = writer.write_entry(header, pieces); !written) {
+            return std::unexpected(
+                fmt::format("Failed to write '{}': {}", path, written.error().what()));
+        }
+
+        return {};
+    };
+
+    for (auto const& package : contents.packages) {
+        if (auto desc_ok = write_entry(package.directory, "desc", {package.desc}); !desc_ok) {
+            return desc_ok;
+        }
+
+        if (kind != AlpmDBExporter::DatabaseKind::Files || !package.files) {
+            continue;
+        }
+
+        // pacman expects the list under its section header
+        auto files_ok = write_entry(package.directory, "files", {"%FILES%\n", *package.files});
+        if (!files_ok) {
+            return files_ok;
+        }
+    }
+
+    return {};
+}
+
+// Copies all entries of the archive, the output decides on the compression
+std::expected<void, std::string> copy_archive(std::filesystem::path const& path,
+                                              Archive::Writer& writer) {
+    Archive::Reader reader;
+
+    archive_read_support_format_all(reader);
+    archive_read_support_filter_all(reader);
+
+    if (auto opened = reader.open_filename(path); !opened) {
+        return std::unexpected(opened.error().what());
+    }
+
+    for (auto& [header, entry] : reader) {
+        auto data = entry.read_all();
+        if (!data.has_value()) {
+            return std::unexpected(
+                std::visit([](auto const& error) { return error.what(); }, data.error()));
+        }
+
+        auto written_entry = writer.start_write(*header);
+        if (!written_entry.has_value()) {
+            return std::unexpected(written_entry.error().what());
+        }
+
+        if (auto written = written_entry->write(*data); !written) {
+            return std::unexpected(written.error().what());
+        }
+
+        if (auto finished = written_entry->finish(); !finished) {
+            return std::unexpected(finished.error().what());
+        }
+    }
+
+    return {};
+}
+
+// Reads the archive to its end, the zstd frames are checked on the way. A
+// truncated or corrupted archive can't be kept even if its digest matches.
+bool is_readable_archive(std::filesystem::path const& path) {
+    Archive::Reader reader;
+
+    archive_read_support_format_all(reader);
+    archive_read_support_filter_all(reader);
+
+    if (!reader.open_filename(path)) {
+        return false;
+    }
+
+    archive_entry* entry = nullptr;
+    while (true) {
+        auto const status = archive_read_next_header(reader, &entry);
+        if (status == ARCHIVE_EOF) {
+            return true;
+        }
+        if (status != ARCHIVE_OK || archive_read_data_skip(reader) != ARCHIVE_OK) {
+            return false;
+        }
+    }
+}
+
 AlpmDBExporter::AlpmDBExporter(BoxOptions& box_options,
                                PackageStoreBase& package_store,
                                ReadOnlyRepositoryBase<Section>& section_repository,
                                UnitOfWorkBaseFactory& uow_factory)
-    : m_box_path(box_options.box_path)
+    : m_options(box_options)
+    , m_box_path(box_options.box_path)
     , m_package_store(package_store)
-    , m_uow_factory(uow_factory) {
+    , m_uow_factory(uow_factory)
+    , m_export_pool(std::make_unique<coro::thread_pool>(coro::thread_pool::options {
+          .thread_count =
+              static_cast<uint32_t>(std::max<int64_t>(box_options.export_concurrency, 1))})) {
     auto sections_result =
         coro::sync_wait(section_repository.all_async(coro::sync_wait(uow_factory())));
 
@@ -73,215 +308,610 @@ AlpmDBExporter::AlpmDBExporter(BoxOptions& box_options,
     for (auto const& section : m_sections) {
         std::filesystem::create_directories(m_box_path / std::string(section));
     }
+
+    // Exports the previous run didn't publish are rolled forward, same for sections
+    // that were never exported
+    auto journal = package_store.dirty_sections();
+    if (!journal.has_value()) {
+        logw("Exporter: Can't read the export journal, the error is \"{}\"",
+             journal.error().what());
+    }
+
+    for (auto const& section : m_sections) {
+        auto const names = database_names(section, DatabaseKind::Packages);
+        auto const archive = m_box_path / std::string(section) / names.archive;
+
+        if ((journal.has_value() && journal->contains(section))
+            || !std::filesystem::exists(archive)) {
+            m_dirty_sections.emplace(section);
+        }
+    }
+}
+
+std::set<PackageSectionDTO> AlpmDBExporter::dirty_sections() {
+    std::lock_guard lock(m_dirty_sections_mutex);
+    return m_dirty_sections;
+}
+
+coro::task<bool> AlpmDBExporter::export_to_disk(std::set<PackageSectionDTO> requested) {
+    // Sections dirtied while the export runs are left for the next one
+    std::set<PackageSectionDTO> sections;
+    {
+        std::lock_guard lock(m_dirty_sections_mutex);
+        for (auto const& section : requested) {
+            if (m_dirty_sections.erase(section) > 0) {
+                sections.emplace(section);
+            }
+        }
+    }
+
+    if (sections.empty()) {
+        co_return true;
+    }
+
+    auto const started = std::chrono::steady_clock::now();
+
+    std::set<PackageSectionDTO> failed;
+    std::map<PackageSectionDTO, SectionContents> scanned;
+
+    auto snapshot = co_await collect_sections(sections, scanned, failed);
+
+    std::vector<std::pair<PackageSectionDTO, uint64_t>> published;
+
+    if (!scanned.empty()) {
+        auto tasks = scanned | std::views::transform([this](auto const& entry) {
+                         return schedule_export(entry.first, entry.second);
+                     })
+                     | std::ranges::to<std::vector>();
+
+        auto const results = co_await coro::when_all(std::move(tasks));
+
+        for (auto const& [entry, result] : std::views::zip(scanned, results)) {
+            if (result.return_value()) {
+                published.emplace_back(entry.first, snapshot.generation);
+            } else {
+                failed.emplace(entry.first);
+            }
+        }
+    }
+
+    // The contents point into the snapshot, it's released once they're written
+    scanned.clear();
+    snapshot.uow.reset();
+
+    // The renames and links of a section reach the disk with one fsync of its
+    // directory, only then the section is taken out of the journal
+    std::erase_if(published, [this](auto const& entry) {
+        auto const section_path = m_box_path / std::string(entry.first);
+        if (!sync_to_disk(section_path, true)) {
+            logw("Exporter: Can't sync \"{}\", it's exported again after a restart",
+                 section_path.string());
+            return true;
+        }
+        return false;
+    });
+
+    if (auto marked = co_await m_package_store.mark_published(std::move(published)); !marked) {
+        logw("Exporter: Can't update the export journal, the error is \"{}\"",
+             marked.error().what());
+    }
+
+    auto const elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - started);
+
+    logi("Exporter: {} of {} sections exported in {} ms", sections.size() - failed.size(),
+         sections.size(), elapsed.count());
+
+    // Failed sections stay dirty and are exported again next time
+    if (!failed.empty()) {
+        std::lock_guard lock(m_dirty_sections_mutex);
+        m_dirty_sections.merge(failed);
+    }
+
+    co_return failed.empty();
+}
+
+void AlpmDBExporter::add_dirty_sections(std::set<Core::Application::PackageSectionDTO>&& sections) {
+    std::lock_guard lock(m_dirty_sections_mutex);
+    m_dirty_sections.merge(sections);
 }
 
-coro::task<void> AlpmDBExporter::export_to_disk() {
-    phmap::parallel_flat_hash_map<PackageSectionDTO, Archive::Writer> writers;
+uint64_t AlpmDBExporter::generation(PackageSectionDTO const& section) {
+    std::lock_guard lock(m_publish_mutex);
 
-    for (auto const& section : m_dirty_sections) {
-        logi("Exporter: \"{}\" export into the package manager format started",
+    auto const it = m_published.find(section);
+    return it != m_published.end() ? it->second : 0;
+}
+
+// Reads all sections from one snapshot, so a run publishes a consistent state and
+// opens a single unit of work. LMDB txns can't be shared between threads, the
+// sections are read one after another and only their compression is parallel.
+coro::task<AlpmDBExporter::Snapshot>
+    AlpmDBExporter::collect_sections(std::set<PackageSectionDTO> const& sections,
+                                     std::map<PackageSectionDTO, SectionContents>& scanned,
+                                     std::set<PackageSectionDTO>& failed) {
+    co_await m_export_pool->schedule();
+
+    auto const started = std::chrono::steady_clock::now();
+
+    auto uow = co_await m_uow_factory();
+
+    auto const generation_ok = m_package_store.generation(uow);
+    if (!generation_ok.has_value()) {
+        logf("Exporter: Can't open the snapshot, the error is \"{}\". Stopping...",
+             generation_ok.error().what());
+        failed.insert(sections.begin(), sections.end());
+        co_return Snapshot {};
+    }
+
+    size_t packages = 0;
+    for (auto const& section : sections) {
+        SectionContents contents;
+        if (!co_await collect_section(section, uow, contents)) {
+            failed.emplace(section);
+            continue;
+        }
+
+        packages += contents.packages.size();
+        scanned.emplace(section, std::move(contents));
+    }
+
+    auto const elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - started);
+
+    logi("Exporter: {} packages of {} sections read in {} ms, {} ns per package", packages,
+         sections.size(), elapsed.count() / 1'000'000,
+         packages > 0 ? elapsed.count() / static_cast<int64_t>(packages) : 0);
+
+    co_return Snapshot {.uow = std::move(uow), .generation = generation_ok->id};
+}
+
+coro::task<bool> AlpmDBExporter::collect_section(PackageSectionDTO const& section,
+                                                 std::shared_ptr<UnitOfWorkBase> uow,
+                                                 SectionContents& contents) {
+    // Resolved once, the links of every package are computed against it
+    auto const section_path = std::filesystem::weakly_canonical(m_box_path / std::string(section));
+
+    bool collected = true;
+
+    auto const accepted = co_await m_package_store.accept(
+        [this, &section_path, &uow, &contents, &collected](std::string_view key,
+                                                            PackageRecord const& package) {
+            if (auto export_ok = export_package(key, package, section_path, uow, contents);
+                !export_ok) {
+                logf(fmt::format("Exporter: {}. Stopping...", export_ok.error()));
+                collected = false;
+                return Utilities::NavigationAction::Stop;
+            }
+
+            return Utilities::NavigationAction::Next;
+        },
+        section, uow);
+
+    if (!accepted.has_value()) {
+        logf("Exporter: Can't read \"{}\", the error is \"{}\". Stopping...",
+             std::string(section), accepted.error().what());
+        co_return false;
+    }
+
+    std::ranges::sort(contents.packages, {}, &PackageEntry::directory);
+
+    co_return collected;
+}
+
+coro::task<bool> AlpmDBExporter::schedule_export(PackageSectionDTO section,
+                                                 SectionContents const& contents) {
+    co_await m_export_pool->schedule();
+
+    logi("Exporter: \"{}\" export into the package manager format started",
+         std::string(section));
+
+    auto const started = std::chrono::steady_clock::now();
+
+    auto const exported = co_await export_section(section, contents);
+
+    auto const elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - started);
+
+    if (exported) {
+        logi("Exporter: \"{}\" export finished in {} ms", std::string(section), elapsed.count());
+    } else {
+        loge("Exporter: \"{}\" export failed after {} ms", std::string(section),
+             elapsed.count());
+    }
+
+    co_return exported;
+}
+
+coro::task<std::expected<void, std::string>>
+    AlpmDBExporter::write_database(std::filesystem::path path,
+                                   SectionContents const& contents,
+                                   DatabaseKind kind) {
+    co_await m_export_pool->schedule();
+
+    auto writer = setup_alpmdb_writer(path, m_options.export_zstd_level);
+    if (!writer.has_value()) {
+        co_return std::unexpected(fmt::format("Writer cannot be created for '{}': {}",
+                                              path.string(), writer.error().what()));
+    }
+
+    if (auto written = write_entries(*writer, contents, kind); !written) {
+        co_return written;
+    }
+
+    if (auto closed = writer->close(); !closed) {
+        co_return std::unexpected(
+            fmt::format("Can't finish '{}': {}", path.string(), closed.error().what()));
+    }
+
+    if (!sync_to_disk(path, false)) {
+        co_return std::unexpected(fmt::format("Can't sync '{}' to disk", path.string()));
+    }
+
+    co_return {};
+}
+
+// Exports the section next to the published one and swaps it in. Package links
+// are added before the new databases are renamed into place and stale entries are
+// removed after, so clients always see a complete repository. Both databases are
+// written from the collected contents at the same time.
+coro::task<bool> AlpmDBExporter::export_section(PackageSectionDTO const& section,
+                                                SectionContents const& contents) {
+    auto const section_path = std::filesystem::absolute(m_box_path / std::string(section));
+
+    auto const databases = DatabaseKinds | std::views::transform([&section](auto kind) {
+                               return database_names(section, kind);
+                           })
+                           | std::ranges::to<std::vector>();
+
+    auto const& packages_names = databases.back();
+    auto const digest_path = section_path / digest_name(packages_names.archive);
+
+    auto const digest = content_digest(contents);
+
+    auto const published = std::ranges::all_of(databases, [&section_path](auto const& names) {
+        return std::filesystem::exists(section_path / names.archive);
+    });
+
+    if (published && read_digest(digest_path) == digest
+        && std::ranges::all_of(databases, [&section_path](auto const& names) {
+               return is_readable_archive(section_path / names.archive);
+           })) {
+        logi("Exporter: \"{}\" is unchanged, keeping the published databases",
              std::string(section));
+        co_return true;
+    }
+
+    auto const discard = [&section_path, &databases] {
+        std::error_code ec;
+        for (auto const& names : databases) {
+            std::filesystem::remove(section_path / names.temporary(), ec);
+        }
+    };
+
+    std::vector<coro::task<std::expected<void, std::string>>> writes;
+    for (auto const& [kind, names] : std::views::zip(DatabaseKinds, databases)) {
+        writes.emplace_back(write_database(section_path / names.temporary(), contents, kind));
+    }
+
+    auto const written = co_await coro::when_all(std::move(writes));
+
+    for (auto const& result : written) {
+        if (!result.return_value()) {
+            logf("Exporter: {}. Stopping...", result.return_value().error());
+            discard();
+            co_return false;
+        }
+    }
+
+    for (auto const& [name, target] : contents.links) {
+        if (auto link_ok = replace_symlink(target, section_path / name); !link_ok) {
+            logf("Exporter: Can't link \"{}\", the error is \"{}\". Stopping...", name,
+                 link_ok.error().what());
+            discard();
+            co_return false;
+        }
+    }
+
+    uint64_t generation = 0;
+    {
+        std::lock_guard lock(m_publish_mutex);
+
+        for (auto const& names : databases) {
+            std::error_code ec;
+            std::filesystem::rename(section_path / names.temporary(),
+                                    section_path / names.archive, ec);
+            if (ec) {
+                logf("Exporter: Can't publish \"{}\", the error is \"{}\". Stopping...",
+                     (section_path / names.archive).string(), ec.message());
+                discard();
+                co_return false;
+            }
+        }
+
+        generation = ++m_published[section];
+    }
+
+    std::set<std::string> keep {digest_name(packages_names.archive)};
+
+    for (auto const& names : databases) {
+        if (auto link_ok = replace_symlink(names.archive, section_path / names.link); !link_ok) {
+            logf("Exporter: Can't link \"{}\", the error is \"{}\". Stopping...", names.link,
+                 link_ok.error().what());
+            co_return false;
+        }
+
+        keep.insert({names.archive, names.link, names.recompressed()});
+    }
+
+    write_digest(digest_path, digest);
 
-        /// TODO: We need to make this way more robust. At least a full backup
-        /// would work but maybe we can do something more smart...
-        if (!cleanup_section(section)) {
+    remove_stale_entries(section_path, contents.links, keep);
+
+    if (m_options.export_recompress_level > 0
+        && m_options.export_recompress_level != m_options.export_zstd_level) {
+        m_recompress_scheduler->schedule(recompress(section, generation));
+    }
+
+    co_return true;
+}
+
+coro::task<void> AlpmDBExporter::recompress(PackageSectionDTO section, uint64_t generation) {
+    co_await m_recompress_scheduler->schedule();
+
+    auto const is_published = [this, &section, &generation] {
+        std::lock_guard lock(m_publish_mutex);
+        return m_published[section] == generation;
+    };
+
+    auto const started = std::chrono::steady_clock::now();
+
+    auto const section_path = std::filesystem::absolute(m_box_path / std::string(section));
+
+    for (auto const kind : DatabaseKinds) {
+        // A newer export already queued its own recompression
+        if (!is_published()) {
             co_return;
         }
 
-        auto writer = setup_alpmdb_writer(section);
+        auto const names = database_names(section, kind);
+        auto const archive_path = section_path / names.archive;
+        auto const temporary_path = section_path / names.recompressed();
 
+        auto const discard = [&temporary_path] {
+            std::error_code ec;
+            std::filesystem::remove(temporary_path, ec);
+        };
+
+        auto writer = setup_alpmdb_writer(temporary_path, m_options.export_recompress_level);
         if (!writer.has_value()) {
-            logf("Exporter: Writer cannot be created, the error is \"{}\". "
-                 "Stopping...",
-                 writer.error().what());
+            logw("Exporter: Can't recompress \"{}\", the error is \"{}\"",
+                 archive_path.string(), writer.error().what());
+            co_return;
+        }
+
+        auto copied = copy_archive(archive_path, *writer);
+        if (copied.has_value()) {
+            if (auto closed = writer->close(); !closed) {
+                copied = std::unexpected(closed.error().what());
+            }
+        }
+
+        if (!copied.has_value()) {
+            logw("Exporter: Can't recompress \"{}\", the error is \"{}\"",
+                 archive_path.string(), copied.error());
+            discard();
             co_return;
         }
 
-        writers.emplace(section, std::move(*writer));
+        if (!sync_to_disk(temporary_path, false)) {
+            logw("Exporter: Can't sync recompressed \"{}\" to disk", archive_path.string());
+            discard();
+            co_return;
+        }
 
-        co_await m_package_store.accept(
-            [this, writer = &writers.at(section)](std::string_view key,
-                                                  PackageRecord const& package) {
-                if (auto export_ok = export_package(*writer, key, package); !export_ok) {
-                    logf(fmt::format("Exporter: {}. Stopping...", export_ok.error()));
-                    return Utilities::NavigationAction::Stop;
-                }
+        {
+            std::lock_guard lock(m_publish_mutex);
+
+            if (m_published[section] != generation) {
+                discard();
+                co_return;
+            }
+
+            std::error_code ec;
+            std::filesystem::rename(temporary_path, archive_path, ec);
+            if (ec) {
+                logw("Exporter: Can't publish recompressed \"{}\", the error is \"{}\"",
+                     archive_path.string(), ec.message());
+                discard();
+                co_return;
+            }
+
+            // The bytes changed, clients have to see a new version
+            generation = ++m_published[section];
+        }
 
-                return Utilities::NavigationAction::Next;
-            },
-            std::string(section), co_await m_uow_factory());
-        logi("Exporter: \"{}\" export finished", std::string(section));
+        // The published archive stays valid either way, a lost rename only
+        // brings back the previous compression
+        if (!sync_to_disk(section_path, true)) {
+            logw("Exporter: Can't sync \"{}\" after recompressing", section_path.string());
+        }
     }
 
-    m_dirty_sections.clear();
+    auto const elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - started);
 
-    co_return;
+    logi("Exporter: \"{}\" recompressed at level {} in {} ms", std::string(section),
+         m_options.export_recompress_level, elapsed.count());
 }
 
-void AlpmDBExporter::add_dirty_sections(std::set<Core::Application::PackageSectionDTO>&& sections) {
-    m_dirty_sections.insert(std::make_move_iterator(sections.begin()),
-                            std::make_move_iterator(sections.end()));
-}
 // Factory function for ALPM .db archive writer
 std::expected<Archive::Writer, bxt::Error>
-    AlpmDBExporter::setup_alpmdb_writer(PackageSectionDTO const& section) {
+    AlpmDBExporter::setup_alpmdb_writer(std::filesystem::path const& path, int64_t level) {
     Archive::Writer writer;
 
     if (archive_write_add_filter_zstd(writer) < ARCHIVE_WARN) {
         return bxt::make_error<Archive::LibArchiveError>(std::move(writer));
     }
-    if (archive_write_set_format_pax_restricted(writer) < ARCHIVE_WARN) {
+
+    if (archive_write_set_filter_option(writer, "zstd", "compression-level",
+                                        std::to_string(level).c_str())
+        < ARCHIVE_WARN) {
         return bxt::make_error<Archive::LibArchiveError>(std::move(writer));
     }
 
-    auto const archive_path =
-        m_box_path / std::string(section) / fmt::format("{}.db.tar.zst", section.repository);
-
-    if (auto open_ok = writer.open_filename(archive_path); !open_ok) {
-        return std::unexpected(std::move(open_ok.error()));
+    // Both are optional in libarchive and libzstd, the export works without them
+    if (m_options.export_zstd_threads >= 0
+        && archive_write_set_filter_option(
+               writer, "zstd", "threads", std::to_string(m_options.export_zstd_threads).c_str())
+               != ARCHIVE_OK
+        && !m_zstd_threads_warned.exchange(true)) {
+        logw("Exporter: Multithreaded zstd compression is not available");
     }
 
-    auto const archive_link =
-        m_box_path / std::string(section) / fmt::format("{}.db", section.repository);
+    if (m_options.export_zstd_long > 0
+        && archive_write_set_filter_option(writer, "zstd", "long",
+                                           std::to_string(m_options.export_zstd_long).c_str())
+               != ARCHIVE_OK
+        && !m_zstd_long_warned.exchange(true)) {
+        logw("Exporter: zstd long-distance matching is not available");
+    }
+    if (archive_write_set_format_pax_restricted(writer) < ARCHIVE_WARN) {
+        return bxt::make_error<Archive::LibArchiveError>(std::move(writer));
+    }
 
-    if (auto link_created_ok = create_relative_symlink(archive_path, archive_link);
-        !link_created_ok) {
-        return std::unexpected(link_created_ok.error());
+    if (auto open_ok = writer.open_filename(path); !open_ok) {
+        return std::unexpected(std::move(open_ok.error()));
     }
 
     return writer;
 }
-// Cleans up section before the export by removing all it's content
-std::expected<void, FsError> AlpmDBExporter::cleanup_section(PackageSectionDTO const& section) {
-    std::error_code ec;
 
-    std::filesystem::directory_iterator directory_iterator;
+// Removes everything from the section directory that the export didn't produce
+void AlpmDBExporter::remove_stale_entries(std::filesystem::path const& section_path,
+                                          LinkSet const& links,
+                                          std::set<std::string> const& keep) {
+    std::error_code ec;
 
-    constexpr auto handle_error = [](auto const& ec) {
-        logf("Exporter: Can't wipe the directory before the export, the "
-             "error is "
-             "\"{}\". Stopping...",
+    auto directory_iterator = std::filesystem::directory_iterator(section_path, ec);
+    if (ec) {
+        logw("Exporter: Can't list \"{}\", the error is \"{}\"", section_path.string(),
              ec.message());
-        return bxt::make_error<FsError>(ec);
-    };
-
-    if (directory_iterator =
-            std::filesystem::directory_iterator(m_box_path / std::string(section), ec);
-        ec) {
-        return handle_error(ec);
+        return;
     }
 
+    std::vector<std::filesystem::path> stale;
     for (auto const& entry : directory_iterator) {
-        if (!std::filesystem::remove_all(entry.path(), ec)) {
-            return handle_error(ec);
+        auto const name = entry.path().filename().string();
+        if (!links.contains(name) && !keep.contains(name)) {
+            stale.emplace_back(entry.path());
         }
     }
 
-    return {};
+    for (auto const& path : stale) {
+        if (std::filesystem::remove_all(path, ec); ec) {
+            logw("Exporter: Can't remove stale \"{}\", the error is \"{}\"", path.string(),
+                 ec.message());
+        }
+    }
 }
 
-struct PackageDetails {
-    PackageSectionDTO section;
-    std::string name;
-    std::string version;
-    PoolLocation preferred_location;
+// What the export reads from a record, pointing into it
+struct PackageRow {
+    std::string_view name;
+    Core::Domain::PoolLocation location;
+    PackageRecord::Description const& description;
 };
-// Validates and extracts essential package details from both key and record
-std::expected<PackageDetails, std::string> validate_package_key(std::string_view key,
-                                                                PackageRecord const& package) {
-    auto deserialized = PackageRecord::Id::from_string(key);
-    if (!deserialized.has_value()) {
-        return std::unexpected(fmt::format("Invalid package key: '{}'.", key));
-    }
-
-    auto const& [section, name] = *deserialized;
-
-    auto location = select_preferred_pool_location(package.descriptions);
 
+// Picks the description from the preferred location
+std::expected<PackageRow, std::string> select_package_row(PackageRecord const& package) {
+    auto const location = Core::Domain::select_preferred_pool_location(package.descriptions);
     if (!location.has_value()) {
-        return std::unexpected(fmt::format("Can't select preferred location for '{}'", key));
+        return std::unexpected(
+            fmt::format("Can't select preferred location for '{}'", package.id.to_string()));
     }
 
-    std::optional<std::string> version_string;
-
-    auto description_it = package.descriptions.find(*location);
-    if (description_it == package.descriptions.end()) {
+    auto const& description = package.descriptions.at(*location);
+    if (description.version.empty()) {
         return std::unexpected(
-            fmt::format("Package details not found for preferred location: '{}'.", key));
+            fmt::format("No valid version for package '{}'.", package.id.to_string()));
     }
-    if (!(version_string = description_it->second.descfile.get("VERSION")).has_value()
-        || version_string->empty()) {
-        return std::unexpected(fmt::format("No valid version for package '{}'.", key));
-    }
-    return PackageDetails {section, name, *version_string, *location};
-}
 
-// Writes the contents of package description file to section's ALPM Database
-// archive
-std::expected<void, std::string> write_package_description_to_alpmdb(Archive::Writer& alpmdb_writer,
-                                                                     PackageDetails const& details,
-                                                                     PackageRecord const& package) {
-    auto const& [section, name, version, preferred_location] = details;
-    auto desc = package.descriptions.at(preferred_location).descfile.desc;
-    auto desc_path = fmt::format("{}-{}/desc", name, version);
-
-    if (auto write_ok = Utilities::AlpmDb::DatabaseUtils::write_buffer_to_archive(alpmdb_writer,
-                                                                                  desc_path, desc);
-        !write_ok) {
-        return std::unexpected(fmt::format("Failed to write description for '{}/{}-{}'.",
-                                           std::string(section), name, version));
-    }
-    return {};
+    return PackageRow {.name = package.id.name, .location = *location, .description = description};
 }
 
-// Symlinks (usually pool) package and optionally it's signature to the
-// specified section
-std::expected<void, std::string> symlink_package_files(PackageDetails const& details,
+// Adds the links to the package file and optionally it's signature (usually in
+// the pool) that the section has to contain. The section path has to be
+// canonical like the pool paths, the links are then computed without touching
+// the file system.
+std::expected<void, std::string> collect_package_links(PackageRow const& row,
                                                        PackageRecord const& package,
-                                                       std::filesystem::path const& box_path) {
-    auto [section, name, version, preferred_location] = details;
+                                                       std::filesystem::path const& section_path,
+                                                       AlpmDBExporter::LinkSet& links) {
+    auto const add_link = [&section_path, &links](std::filesystem::path const& target) {
+        auto relative_target = target.lexically_relative(section_path);
+        if (relative_target.empty()) {
+            return false;
+        }
 
-    auto description = package.descriptions.at(preferred_location);
+        auto [it, inserted] = links.try_emplace(target.filename().string(), relative_target);
 
-    auto link_file_path = std::filesystem::absolute(box_path / std::string(section)
-                                                    / description.filepath.filename());
+        return inserted || it->second == relative_target;
+    };
 
-    if (auto link_ok = create_relative_symlink(description.filepath, link_file_path); !link_ok) {
-        return std::unexpected(fmt::format("Failed to link package file for '{}/{}-{}'.",
-                                           std::string(section), name, version));
+    if (!add_link(row.description.filepath)) {
+        return std::unexpected(
+            fmt::format("Failed to link package file for '{}'.", package.id.to_string()));
     }
 
-    if (description.signature_path.has_value()) {
-        auto link_file_path = std::filesystem::absolute(box_path / std::string(section)
-                                                        / description.signature_path->filename());
-
-        if (auto link_ok = create_relative_symlink(*description.signature_path, link_file_path);
-            !link_ok) {
-            return std::unexpected(fmt::format("Failed to link signature file for '{}/{}-{}'.",
-                                               std::string(section), name, version));
-        }
+    if (row.description.signature_path.has_value()
+        && !add_link(*row.description.signature_path)) {
+        return std::unexpected(
+            fmt::format("Failed to link signature file for '{}'.", package.id.to_string()));
     }
+
     return {};
 }
-// Exports package into the ALPM repository format by writing it's description
-// into the .db file and symlinking package and signature files for specified
-// section
-std::expected<void, std::string> AlpmDBExporter::export_package(Archive::Writer& writer,
-                                                                std::string_view key,
-                                                                PackageRecord const& package) {
-    auto validated_details = validate_package_key(key, package);
-    if (!validated_details.has_value()) {
-        return std::unexpected(validated_details.error());
+// Exports package into the ALPM repository format by collecting it's
+// description, the stored file list for the .files database and the links to
+// package and signature files for specified section. The desc and the file list
+// are viewed in the snapshot, only legacy records are copied.
+std::expected<void, std::string>
+    AlpmDBExporter::export_package(std::string_view key,
+                                   PackageRecord const& package,
+                                   std::filesystem::path const& section_path,
+                                   std::shared_ptr<UnitOfWorkBase> uow,
+                                   SectionContents& contents) {
+    auto row = select_package_row(package);
+    if (!row.has_value()) {
+        return std::unexpected(row.error());
     }
 
-    auto write_result = write_package_description_to_alpmdb(writer, *validated_details, package);
-    if (!write_result.has_value()) {
-        return std::unexpected(write_result.error());
+    auto const& description = row->description;
+
+    auto desc = m_package_store.desc_view(key, row->location, uow);
+    if (!desc.has_value()) {
+        desc = contents.copies.emplace_back(description.descfile.desc());
     }
 
-    auto file_management_result = symlink_package_files(*validated_details, package, m_box_path);
-    if (!file_management_result.has_value()) {
-        return std::unexpected(file_management_result.error());
+    std::optional<std::string_view> files;
+    if (!description.descfile.files().empty()) {
+        files = contents.copies.emplace_back(description.descfile.files());
+    } else if (auto stored = m_package_store.files_view(description, uow); stored) {
+        files = *stored;
+    } else {
+        logw("Exporter: No file list is stored for '{}', it's left out of the .files database",
+             package.id.to_string());
+    }
+
+    contents.packages.emplace_back(
+        PackageEntry {.directory = fmt::format("{}-{}", row->name, description.version),
+                      .desc = *desc,
+                      .files = files});
+
+    if (auto links_ok = collect_package_links(*row, package, section_path, contents.links);
+        !links_ok) {
+        return std::unexpected(links_ok.error());
     }
 
     return {};
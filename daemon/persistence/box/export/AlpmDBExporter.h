@@ -19,10 +19,19 @@
 #include "utilities/errors/FsError.h"
 #include "utilities/libarchive/Writer.h"
 
+#include <atomic>
 #include <coro/io_scheduler.hpp>
+#include <coro/thread_pool.hpp>
+#include <cstdint>
+#include <deque>
 #include <filesystem>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace bxt::Persistence::Box {
@@ -34,24 +43,108 @@ public:
                    ReadOnlyRepositoryBase<Section>& section_repository,
                    UnitOfWorkBaseFactory& uow_factory);
 
-    coro::task<void> export_to_disk() override;
+    // Links a section directory has to contain: file name to relative target
+    using LinkSet = phmap::flat_hash_map<std::string, std::filesystem::path>;
+
+    // A package as it appears in the section databases, the row an export works
+    // on. Only the directory is built, the desc and the file list are views into
+    // the snapshot the section was read from.
+    struct PackageEntry {
+        // "name-version", the package directory inside the archives
+        std::string directory;
+        std::string_view desc;
+        // Missing when no file list is stored for the package
+        std::optional<std::string_view> files;
+    };
+
+    // Everything an export of a section produces, before it's written out
+    struct SectionContents {
+        // Sorted by directory before writing
+        std::vector<PackageEntry> packages;
+        LinkSet links;
+        // Copies of what can't be viewed in the snapshot, from records in the
+        // legacy format. A deque keeps the views valid while it grows.
+        std::deque<std::string> copies;
+    };
+
+    // The section's <repo>.db and <repo>.files archives
+    enum class DatabaseKind { Packages, Files };
+
+    coro::task<bool> export_to_disk(std::set<PackageSectionDTO> sections) override;
     void add_dirty_sections(std::set<Core::Application::PackageSectionDTO>&& override) override;
 
+    uint64_t generation(PackageSectionDTO const& section) override;
+
+    std::set<PackageSectionDTO> dirty_sections() override;
+
 private:
+    // The package store snapshot a run reads from. Section contents point into
+    // it, so it stays open until their databases are written.
+    struct Snapshot {
+        std::shared_ptr<UnitOfWorkBase> uow;
+        uint64_t generation = 0;
+    };
+
+    // Reads the sections from one package store snapshot and returns it.
+    // Sections that can't be read are added to the failed ones.
+    coro::task<Snapshot> collect_sections(std::set<PackageSectionDTO> const& sections,
+                                          std::map<PackageSectionDTO, SectionContents>& scanned,
+                                          std::set<PackageSectionDTO>& failed);
+
+    coro::task<bool> collect_section(PackageSectionDTO const& section,
+                                     std::shared_ptr<UnitOfWorkBase> uow,
+                                     SectionContents& contents);
+
+    // Runs the section export on the export pool
+    coro::task<bool> schedule_export(PackageSectionDTO section, SectionContents const& contents);
+
+    coro::task<bool> export_section(PackageSectionDTO const& section,
+                                    SectionContents const& contents);
+
+    // Writes one of the section databases to the path on the export pool
+    coro::task<std::expected<void, std::string>> write_database(std::filesystem::path path,
+                                                                SectionContents const& contents,
+                                                                DatabaseKind kind);
+
+    // Replaces the published databases with copies compressed at the
+    // recompress level, unless the section was exported again meanwhile
+    coro::task<void> recompress(PackageSectionDTO section, uint64_t generation);
+
     std::expected<Archive::Writer, bxt::Error>
-        setup_alpmdb_writer(PackageSectionDTO const& section);
+        setup_alpmdb_writer(std::filesystem::path const& path, int64_t level);
 
-    std::expected<void, FsError> cleanup_section(PackageSectionDTO const& section);
+    void remove_stale_entries(std::filesystem::path const& section_path,
+                              LinkSet const& links,
+                              std::set<std::string> const& keep);
 
-    std::expected<void, std::string>
-        export_package(Archive::Writer& writer, std::string_view key, PackageRecord const& package);
+    std::expected<void, std::string> export_package(std::string_view key,
+                                                    PackageRecord const& package,
+                                                    std::filesystem::path const& section_path,
+                                                    std::shared_ptr<UnitOfWorkBase> uow,
+                                                    SectionContents& contents);
 
+    BoxOptions& m_options;
     std::filesystem::path m_box_path;
     std::set<Core::Application::PackageSectionDTO> m_sections;
     PackageStoreBase& m_package_store;
     UnitOfWorkBaseFactory& m_uow_factory;
 
-    phmap::parallel_node_hash_set<PackageSectionDTO> m_dirty_sections;
+    std::unique_ptr<coro::thread_pool> m_export_pool;
+
+    // Missing optional zstd features are reported on the first export only
+    std::atomic<bool> m_zstd_threads_warned = false;
+    std::atomic<bool> m_zstd_long_warned = false;
+
+    std::mutex m_dirty_sections_mutex;
+    std::set<PackageSectionDTO> m_dirty_sections;
+
+    // Counts publications of every section, recompressions included. Recompressed
+    // copies of an older database are thrown away
+    std::mutex m_publish_mutex;
+    phmap::flat_hash_map<PackageSectionDTO, uint64_t> m_published;
+
+    std::shared_ptr<coro::io_scheduler> m_recompress_scheduler =
+        coro::io_scheduler::make_shared({.pool = {.thread_count = 1}});
 };
 
 } // namespace bxt::Persistence::Box
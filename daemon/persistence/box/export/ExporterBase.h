@@ -9,6 +9,7 @@
 #include "core/application/dtos/PackageSectionDTO.h"
 
 #include <coro/task.hpp>
+#include <cstdint>
 #include <set>
 #include <string>
 
@@ -16,7 +17,16 @@ namespace bxt::Persistence::Box {
 struct ExporterBase {
     virtual ~ExporterBase() = default;
 
-    virtual coro::task<void> export_to_disk() = 0;
+    // Exports the given sections that are dirty. Returns false if some of them failed,
+    // those stay dirty.
+    virtual coro::task<bool>
+        export_to_disk(std::set<Core::Application::PackageSectionDTO> sections) = 0;
     virtual void add_dirty_sections(std::set<Core::Application::PackageSectionDTO>&&) = 0;
+
+    // Sections waiting for an export, including those the previous run didn't finish
+    virtual std::set<Core::Application::PackageSectionDTO> dirty_sections() = 0;
+
+    // Changes every time the section's databases are replaced on disk
+    virtual uint64_t generation(Core::Application::PackageSectionDTO const& section) = 0;
 };
 } // namespace bxt::Persistence::Box
@@ -16,36 +16,188 @@
 #include "utilities/to_string.h"
 
 #include <algorithm>
+#include <cerrno>
 #include <expected>
+#include <fcntl.h>
 #include <filesystem>
 #include <fmt/core.h>
 #include <iterator>
+#include <linux/fs.h>
+#include <ranges>
 #include <string>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
 #include <system_error>
+#include <unistd.h>
 #include <vector>
 
-std::expected<void, std::error_code> move_file(std::filesystem::path const& from,
-                                               std::filesystem::path const& to) {
-    std::error_code ec;
+namespace bxt::Persistence::Box {
 
-    std::filesystem::rename(from, to, ec);
+namespace {
 
-    // try copy + remove original
-    if (ec) {
-        std::filesystem::copy_file(from.lexically_normal(), to.lexically_normal(),
-                                   std::filesystem::copy_options::overwrite_existing, ec);
-        if (!ec) {
-            std::filesystem::remove(from, ec);
+    std::error_code last_error() {
+        return {errno, std::system_category()};
+    }
+
+    // Copies the file with a reflink when both paths are on the same file system
+    // (e.g. bind mounts of it, where rename fails), with copy_file_range otherwise
+    // and with a plain copy where the kernel can't do either. The copy is synced,
+    // it's renamed into the pool right after.
+    std::expected<void, std::error_code> copy_file_data(std::filesystem::path const& from,
+                                                        std::filesystem::path const& to) {
+        auto const source = ::open(from.c_str(), O_RDONLY | O_CLOEXEC);
+        if (source < 0) {
+            return std::unexpected(last_error());
+        }
+
+        auto const target = ::open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (target < 0) {
+            auto const ec = last_error();
+            ::close(source);
+            return std::unexpected(ec);
         }
+
+        auto const finish = [&](std::error_code ec) -> std::expected<void, std::error_code> {
+            if (!ec && ::fdatasync(target) != 0) {
+                ec = last_error();
+            }
+            if (::close(target) != 0 && !ec) {
+                ec = last_error();
+            }
+            ::close(source);
+
+            if (ec) {
+                return std::unexpected(ec);
+            }
+            return {};
+        };
+
+        if (::ioctl(target, FICLONE, source) == 0) {
+            return finish({});
+        }
+
+        struct stat source_stat {};
+        if (::fstat(source, &source_stat) != 0) {
+            return finish(last_error());
+        }
+
+        off_t remaining = source_stat.st_size;
+        while (remaining > 0) {
+            auto const copied = ::copy_file_range(source, nullptr, target, nullptr,
+                                                  static_cast<size_t>(remaining), 0);
+            if (copied > 0) {
+                remaining -= copied;
+                continue;
+            }
+
+            if (copied < 0 && errno == EINTR) {
+                continue;
+            }
+
+            // Not supported between these file systems, copy whatever is left by hand
+            if (copied < 0 && (errno == EXDEV || errno == ENOSYS || errno == EOPNOTSUPP
+                               || errno == EINVAL)) {
+                std::vector<char> buffer(128 * 1024);
+                while (true) {
+                    auto const read = ::read(source, buffer.data(), buffer.size());
+                    if (read < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (read < 0) {
+                        return finish(last_error());
+                    }
+                    if (read == 0) {
+                        break;
+                    }
+
+                    for (ssize_t written = 0; written < read;) {
+                        auto const result = ::write(target, buffer.data() + written,
+                                                    static_cast<size_t>(read - written));
+                        if (result < 0 && errno != EINTR) {
+                            return finish(last_error());
+                        }
+                        written += std::max<ssize_t>(result, 0);
+                    }
+                }
+                return finish({});
+            }
+
+            return finish(copied < 0 ? last_error() : std::make_error_code(std::errc::io_error));
+        }
+
+        return finish({});
     }
-    if (ec.value() != 0) {
-        return std::unexpected(ec);
-    } else {
+
+    // Renames the file into the pool. A file on another file system is copied next
+    // to its target first and then renamed, so the pool never has a partial file.
+    std::expected<void, std::error_code> move_file(std::filesystem::path const& from,
+                                                   std::filesystem::path const& to) {
+        std::error_code ec;
+
+        std::filesystem::rename(from, to, ec);
+        if (!ec) {
+            return {};
+        }
+
+        if (ec != std::errc::cross_device_link) {
+            return std::unexpected(ec);
+        }
+
+        auto const part = to.parent_path() / fmt::format(".{}.part", to.filename().string());
+
+        if (auto copied = copy_file_data(from, part); !copied) {
+            std::filesystem::remove(part, ec);
+            return copied;
+        }
+
+        std::filesystem::rename(part, to, ec);
+        if (ec) {
+            auto const rename_error = ec;
+            std::filesystem::remove(part, ec);
+            return std::unexpected(rename_error);
+        }
+
+        std::filesystem::remove(from, ec);
+        if (ec) {
+            logw("Pool: {} was copied into the pool but can't be removed, the error is \"{}\"",
+                 from.string(), ec.message());
+        }
+
         return {};
     }
-}
 
-namespace bxt::Persistence::Box {
+    // A file shared by several records of a commit is moved by the first of them,
+    // the others find it at its target already. Returns whether the file was moved.
+    std::expected<bool, std::error_code> move_once(std::filesystem::path const& from,
+                                                   std::filesystem::path const& to) {
+        if (from == to) {
+            return false;
+        }
+
+        if (auto renamed = move_file(from, to); !renamed) {
+            std::error_code ec;
+            if (renamed.error() == std::errc::no_such_file_or_directory
+                && !std::filesystem::exists(from, ec) && std::filesystem::exists(to, ec)) {
+                return false;
+            }
+            return std::unexpected(renamed.error());
+        }
+
+        return true;
+    }
+
+    // Copies interrupted by a crash are left behind as hidden part files
+    void remove_partial_copies(std::filesystem::path const& directory) {
+        std::error_code ec;
+        for (auto const& entry : std::filesystem::directory_iterator(directory, ec)) {
+            auto const name = entry.path().filename().string();
+            if (name.starts_with('.') && name.ends_with(".part")) {
+                std::filesystem::remove(entry.path(), ec);
+            }
+        }
+    }
+
+} // namespace
 
 std::string Pool::format_target_path(Core::Domain::PoolLocation location,
                                      std::string const& arch,
@@ -104,23 +256,78 @@ Pool::Pool(BoxOptions& box_options,
                      ec.message());
                 exit(1);
             }
+
+            remove_partial_copies(target);
+
+            m_target_directories.emplace(std::make_pair(location, architecture),
+                                         std::filesystem::weakly_canonical(target));
         }
     }
 }
+
+std::filesystem::path Pool::target_directory(Core::Domain::PoolLocation location,
+                                             std::string const& arch) const {
+    if (auto it = m_target_directories.find({location, arch}); it != m_target_directories.end()) {
+        return it->second;
+    }
+
+    return std::filesystem::weakly_canonical(format_target_path(location, arch));
+}
 Pool::Result<PackageRecord> Pool::move_to(PackageRecord const& package) {
     PackageRecord result = package;
+
+    // Files moved and link counts added so far, undone if a later file fails
+    std::vector<std::pair<std::filesystem::path, std::filesystem::path>> moved;
+    std::vector<std::filesystem::path> linked;
+
+    auto const fail = [&](std::filesystem::path const& from,
+                          std::error_code const& ec) -> Result<PackageRecord> {
+        loge("Pool: Can't move {} into the pool, the error is \"{}\"", from.string(),
+             ec.message());
+
+        for (auto const& [source, target] : moved | std::views::reverse) {
+            if (auto restored = move_file(target, source); !restored) {
+                logw("Pool: Can't move {} back to {}, the error is \"{}\"", target.string(),
+                     source.string(), restored.error().message());
+            }
+        }
+
+        for (auto const& target : linked) {
+            m_pool_package_link_counts.modify_if(target, [](auto& count) {
+                count.second -= std::min<size_t>(count.second, 1);
+            });
+        }
+
+        return bxt::make_error<FsError>(ec);
+    };
+
+    auto const move_into_pool = [&moved](std::filesystem::path const& from,
+                                         std::filesystem::path const& to) -> std::error_code {
+        auto const result = move_once(from, to);
+        if (!result) {
+            return result.error();
+        }
+
+        if (*result) {
+            moved.emplace_back(from, to);
+        }
+        return {};
+    };
+
     for (auto& [location, description] : result.descriptions) {
         std::error_code ec;
         auto canonical_path = std::filesystem::weakly_canonical(description.filepath, ec);
         if (ec) {
-            return bxt::make_error<FsError>(ec);
+            return fail(description.filepath, ec);
         }
 
         std::filesystem::path target = std::filesystem::weakly_canonical(format_target_path(
             location, package.id.section.architecture, canonical_path.filename().string()));
 
-        move_file(canonical_path, target);
         logd("Pool: Moving file from {} to {}", canonical_path.string(), target.string());
+        if (auto const moved_ec = move_into_pool(canonical_path, target)) {
+            return fail(canonical_path, moved_ec);
+        }
 
         description.filepath = target;
 
@@ -134,6 +341,7 @@ Pool::Result<PackageRecord> Pool::move_to(PackageRecord const& package) {
                 ctor(target, 1);
                 logd("Pool: Adding new link count for {}", target.string());
             });
+        linked.emplace_back(target);
 
         if (!description.signature_path.has_value()) {
             continue;
@@ -143,15 +351,68 @@ Pool::Result<PackageRecord> Pool::move_to(PackageRecord const& package) {
             format_target_path(location, package.id.section.architecture,
                                fmt::format("{}.sig", target.filename().string()));
 
-        move_file(*description.signature_path, signature_target);
         logd("Pool: Moving signature file from {} to {}", description.signature_path->string(),
              signature_target.string());
+        if (auto const moved_ec = move_into_pool(*description.signature_path, signature_target)) {
+            return fail(*description.signature_path, moved_ec);
+        }
 
         description.signature_path = signature_target;
     }
     return result;
 }
 
+PoolBase::Result<void> Pool::restore(PackageRecord const& pooled, PackageRecord const& staged) {
+    // Every file is tried, the first error is reported
+    std::error_code first_error;
+
+    auto const move_back = [&first_error](std::filesystem::path const& from,
+                                          std::filesystem::path const& to) {
+        if (auto restored = move_once(from, to); !restored) {
+            logw("Pool: Can't move {} back to {}, the error is \"{}\"", from.string(),
+                 to.string(), restored.error().message());
+            if (!first_error) {
+                first_error = restored.error();
+            }
+        }
+    };
+
+    for (auto const& [location, description] : pooled.descriptions) {
+        auto const staged_description = staged.descriptions.find(location);
+        if (staged_description == staged.descriptions.end()) {
+            continue;
+        }
+
+        std::error_code ec;
+        auto const staged_path =
+            std::filesystem::weakly_canonical(staged_description->second.filepath, ec);
+        if (ec) {
+            if (!first_error) {
+                first_error = ec;
+            }
+            continue;
+        }
+
+        logd("Pool: Moving file from {} back to {}", description.filepath.string(),
+             staged_path.string());
+        move_back(description.filepath, staged_path);
+
+        m_pool_package_link_counts.modify_if(description.filepath, [](auto& count) {
+            count.second -= std::min<size_t>(count.second, 1);
+        });
+
+        if (description.signature_path.has_value()
+            && staged_description->second.signature_path.has_value()) {
+            move_back(*description.signature_path, *staged_description->second.signature_path);
+        }
+    }
+
+    if (first_error) {
+        return bxt::make_error<FsError>(first_error);
+    }
+    return {};
+}
+
 PoolBase::Result<void> Pool::remove(PackageRecord const& package) {
     std::error_code ec;
     for (auto const& [location, description] : package.descriptions) {
@@ -210,13 +471,13 @@ PoolBase::Result<void> Pool::remove(PackageRecord const& package) {
 PoolBase::Result<PackageRecord> Pool::path_for_package(PackageRecord const& package) const {
     PackageRecord result = package;
     for (auto& [location, description] : result.descriptions) {
-        description.filepath = std::filesystem::weakly_canonical(format_target_path(
-            location, package.id.section.architecture, description.filepath.filename().string()));
+        auto const directory = target_directory(location, package.id.section.architecture);
+
+        description.filepath = directory / description.filepath.filename();
 
         if (description.signature_path.has_value()) {
-            description.signature_path = std::filesystem::weakly_canonical(format_target_path(
-                location, package.id.section.architecture,
-                fmt::format("{}.sig", description.filepath.filename().string())));
+            description.signature_path =
+                directory / fmt::format("{}.sig", description.filepath.filename().string());
         }
     }
     return result;
@@ -16,8 +16,10 @@
 #include "PoolOptions.h"
 
 #include <filesystem>
+#include <map>
 #include <parallel_hashmap/phmap.h>
 #include <string>
+#include <utility>
 
 namespace bxt::Persistence::Box {
 class PackageRecord;
@@ -33,6 +35,9 @@ public:
 
     PoolBase::Result<void> remove(PackageRecord const& package) override;
 
+    PoolBase::Result<void> restore(PackageRecord const& pooled,
+                                   PackageRecord const& staged) override;
+
     PoolBase::Result<PackageRecord> path_for_package(PackageRecord const& package) const override;
 
     void count_links(PackageRepositoryBase& package_repository);
@@ -42,8 +47,14 @@ private:
                                    std::string const& arch,
                                    std::optional<std::string> const& filename = {}) const;
 
+    std::filesystem::path target_directory(Core::Domain::PoolLocation location,
+                                           std::string const& arch) const;
+
     std::filesystem::path m_pool_path;
     std::set<std::string> m_architectures;
+    // Canonical target directories resolved once so path_for_package needs no syscalls
+    std::map<std::pair<Core::Domain::PoolLocation, std::string>, std::filesystem::path>
+        m_target_directories;
     PoolOptions& m_options;
     UnitOfWorkBaseFactory& m_uow_factory;
 
@@ -24,6 +24,10 @@ struct PoolBase {
     virtual Result<PackageRecord> move_to(PackageRecord const& package) = 0;
     virtual Result<void> remove(PackageRecord const& package) = 0;
 
+    // Undoes move_to for a commit that didn't go through: the files of the
+    // pooled record go back to the paths of the staged one
+    virtual Result<void> restore(PackageRecord const& pooled, PackageRecord const& staged) = 0;
+
     virtual Result<PackageRecord> path_for_package(PackageRecord const& package) const = 0;
 };
 } // namespace bxt::Persistence::Box
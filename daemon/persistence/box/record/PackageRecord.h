@@ -11,6 +11,8 @@
 #include "core/domain/enums/PoolLocation.h"
 #include "utilities/alpmdb/Desc.h"
 
+#include <charconv>
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -59,6 +61,24 @@ struct PackageRecord {
         std::optional<std::filesystem::path> signature_path = {};
         Utilities::AlpmDb::Desc descfile;
 
+        // Fields pre-extracted from the descfile so readers don't have to scan it
+        std::string version;
+        std::string architecture;
+        uint64_t compressed_size = 0;
+        std::string md5sum;
+        std::string sha256sum;
+
+        void extract_fields() {
+            version = descfile.get("VERSION").value_or("");
+            architecture = descfile.get("ARCH").value_or("");
+            md5sum = descfile.get("MD5SUM").value_or("");
+            sha256sum = descfile.get("SHA256SUM").value_or("");
+
+            auto const csize = descfile.get("CSIZE").value_or("0");
+            std::from_chars(csize.data(), csize.data() + csize.size(), compressed_size);
+        }
+
+        // Legacy (v1) on-disk layout, see PackageRecordSerializer for the current one
         template<typename Archive> void serialize(Archive& ar) {
             ar(filepath, signature_path, descfile);
         }
@@ -69,6 +89,7 @@ struct PackageRecord {
     bool is_any_architecture = false;
     phmap::flat_hash_map<Core::Domain::PoolLocation, Description> descriptions;
 
+    // Legacy (v1) on-disk layout, see PackageRecordSerializer for the current one
     template<typename Archive> void serialize(Archive& ar) {
         ar(id, is_any_architecture, descriptions);
     }
@@ -0,0 +1,233 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "persistence/box/record/PackageRecord.h"
+#include "utilities/errors/Macro.h"
+#include "utilities/lmdb/CerealSerializer.h"
+#include "utilities/lmdb/Error.h"
+#include "utilities/lmdb/ViewStreambuf.h"
+
+#include <cereal/archives/binary.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace bxt::Persistence::Box {
+
+// On-disk format of package records.
+//
+// v2 values start with a 4-byte header ("BXR" + schema version) followed by
+// the record fields in a fixed order: pre-extracted descfile fields come
+// before the descfile itself and pool paths are stored relative to the box
+// root. Values without the header are legacy v1 records (plain cereal of
+// PackageRecord) and are upgraded on read.
+class PackageRecordSerializer {
+public:
+    BXT_DECLARE_RESULT(Utilities::LMDB::SerializationError);
+
+    static constexpr std::string_view Magic = "BXR";
+    static constexpr uint8_t SchemaVersion = 2;
+
+    // Pool paths under the root are stored relative to it, an empty root keeps
+    // every path as is
+    explicit PackageRecordSerializer(std::filesystem::path root_path = {})
+        : m_root_path(std::move(root_path)) {
+    }
+
+    std::filesystem::path const& root_path() const {
+        return m_root_path;
+    }
+
+    static bool is_legacy(std::string_view value) {
+        return value.size() <= Magic.size() || !value.starts_with(Magic);
+    }
+
+    Result<std::string> serialize(PackageRecord const& record) const {
+        try {
+            std::stringstream stream;
+            stream.write(Magic.data(), Magic.size());
+            stream.put(static_cast<char>(SchemaVersion));
+            {
+                cereal::BinaryOutputArchive archive(stream);
+
+                archive(record.id.section.branch, record.id.section.repository,
+                        record.id.section.architecture, record.id.name,
+                        record.is_any_architecture,
+                        static_cast<uint8_t>(record.descriptions.size()));
+
+                for (auto const& [location, description] : record.descriptions) {
+                    archive(static_cast<uint8_t>(location));
+                    save_path(archive, description.filepath);
+
+                    archive(description.signature_path.has_value());
+                    if (description.signature_path) {
+                        save_path(archive, *description.signature_path);
+                    }
+
+                    archive(description.version, description.architecture,
+                            description.compressed_size, description.md5sum,
+                            description.sha256sum, description.descfile.desc(),
+                            description.descfile.files());
+                }
+            }
+            return stream.str();
+        } catch (cereal::Exception& e) {
+            return bxt::make_error_with_source<Utilities::LMDB::SerializationError>(
+                Utilities::LMDB::CerealSerializationError(std::move(e)));
+        }
+    }
+
+    Result<PackageRecord> deserialize(std::string_view value) const {
+        if (is_legacy(value)) {
+            return deserialize_v1(value);
+        }
+
+        if (static_cast<uint8_t>(value[Magic.size()]) != SchemaVersion) {
+            return bxt::make_error<Utilities::LMDB::SerializationError>();
+        }
+
+        try {
+            Utilities::LMDB::ViewStreambuf buffer(value.substr(Magic.size() + 1));
+            std::istream stream(&buffer);
+            cereal::BinaryInputArchive archive(stream);
+
+            PackageRecord record;
+            auto const count = load_id(archive, record);
+
+            record.descriptions.reserve(count);
+            for (uint8_t i = 0; i < count; ++i) {
+                PackageRecord::Description description;
+                auto const location = load_description(archive, description);
+
+                archive(description.descfile);
+
+                record.descriptions[location] = std::move(description);
+            }
+
+            return record;
+        } catch (cereal::Exception& e) {
+            return bxt::make_error_with_source<Utilities::LMDB::SerializationError>(
+                Utilities::LMDB::CerealSerializationError(std::move(e)));
+        }
+    }
+
+    // The desc stored for the location, viewed inside the value instead of
+    // copied. Legacy values can't be viewed.
+    Result<std::string_view> desc_view(std::string_view value,
+                                       Core::Domain::PoolLocation location) const {
+        if (is_legacy(value) || static_cast<uint8_t>(value[Magic.size()]) != SchemaVersion) {
+            return bxt::make_error<Utilities::LMDB::SerializationError>();
+        }
+
+        try {
+            Utilities::LMDB::ViewStreambuf buffer(value.substr(Magic.size() + 1));
+            std::istream stream(&buffer);
+            cereal::BinaryInputArchive archive(stream);
+
+            PackageRecord record;
+            auto const count = load_id(archive, record);
+
+            for (uint8_t i = 0; i < count; ++i) {
+                PackageRecord::Description description;
+                auto const current = load_description(archive, description);
+
+                auto const desc = Utilities::LMDB::load_string_view(archive, buffer);
+                if (!desc) {
+                    break;
+                }
+                if (current == location) {
+                    return *desc;
+                }
+
+                if (!Utilities::LMDB::load_string_view(archive, buffer)) {
+                    break;
+                }
+            }
+        } catch (cereal::Exception& e) {
+            return bxt::make_error_with_source<Utilities::LMDB::SerializationError>(
+                Utilities::LMDB::CerealSerializationError(std::move(e)));
+        }
+
+        return bxt::make_error<Utilities::LMDB::SerializationError>();
+    }
+
+private:
+    static Result<PackageRecord> deserialize_v1(std::string_view value) {
+        auto record = Utilities::LMDB::CerealSerializer<PackageRecord>::deserialize(value);
+        if (!record.has_value()) {
+            return std::unexpected(std::move(record.error()));
+        }
+
+        for (auto& [location, description] : record->descriptions) {
+            description.extract_fields();
+        }
+
+        return record;
+    }
+
+    // Reads the record id and returns the number of descriptions that follow
+    static uint8_t load_id(cereal::BinaryInputArchive& archive, PackageRecord& record) {
+        uint8_t count = 0;
+        archive(record.id.section.branch, record.id.section.repository,
+                record.id.section.architecture, record.id.name, record.is_any_architecture,
+                count);
+        return count;
+    }
+
+    // Reads a description up to its desc file and returns its location
+    Core::Domain::PoolLocation load_description(cereal::BinaryInputArchive& archive,
+                                                PackageRecord::Description& description) const {
+        uint8_t location = 0;
+        archive(location);
+
+        description.filepath = load_path(archive);
+
+        bool has_signature = false;
+        archive(has_signature);
+        if (has_signature) {
+            description.signature_path = load_path(archive);
+        }
+
+        archive(description.version, description.architecture, description.compressed_size,
+                description.md5sum, description.sha256sum);
+
+        return static_cast<Core::Domain::PoolLocation>(location);
+    }
+
+    template<typename Archive>
+    void save_path(Archive& archive, std::filesystem::path const& path) const {
+        if (!m_root_path.empty() && path.is_absolute()) {
+            auto relative = path.lexically_relative(m_root_path);
+            if (!relative.empty() && *relative.begin() != "..") {
+                archive(true, relative.string());
+                return;
+            }
+        }
+
+        archive(false, path.string());
+    }
+
+    template<typename Archive> std::filesystem::path load_path(Archive& archive) const {
+        bool rooted = false;
+        std::string path;
+        archive(rooted, path);
+
+        if (rooted) {
+            return m_root_path / path;
+        }
+        return path;
+    }
+
+    std::filesystem::path m_root_path;
+};
+
+} // namespace bxt::Persistence::Box
@@ -22,6 +22,7 @@ static PackageRecord to_record(Core::Domain::Package const& from) {
         result.descriptions[location].filepath = entry.file_path();
         result.descriptions[location].signature_path = entry.signature_path();
         result.descriptions[location].descfile = entry.desc();
+        result.descriptions[location].extract_fields();
     }
 
     return result;
@@ -31,18 +32,18 @@ static Core::Domain::Package to_entity(PackageRecord const& from) {
                                  from.is_any_architecture);
 
     for (auto const& [location, entry] : from.descriptions) {
-        auto version_str = entry.descfile.get("VERSION");
-        if (!version_str) {
+        if (entry.version.empty()) {
             continue;
         }
-        auto version_result = PackageVersion::from_string(*version_str);
+        auto version_result = PackageVersion::from_string(entry.version);
 
         if (!version_result) {
             continue;
         }
 
-        Core::Domain::PackagePoolEntry pool_entry(entry.filepath, entry.signature_path,
-                                                  entry.descfile, *version_result);
+        Core::Domain::PackagePoolEntry pool_entry(
+            entry.filepath, entry.signature_path,
+            std::make_shared<Utilities::AlpmDb::Desc const>(entry.descfile), *version_result);
 
         result.pool_entries().emplace(location, pool_entry);
     }
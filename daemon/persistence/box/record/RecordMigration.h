@@ -0,0 +1,78 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "persistence/box/record/PackageRecordSerializer.h"
+#include "persistence/box/record/SectionRegistry.h"
+
+#include <lmdbxx/lmdb++.h>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace bxt::Persistence::Box {
+
+struct RecordMigrationResult {
+    size_t migrated = 0;
+    std::vector<std::string> failed;
+};
+
+// Rewrites v1 records (text keys and/or legacy values) into the v2 layout in
+// place. Runs inside the given write txn so it's all-or-nothing with the
+// caller's commit; records that can't be decoded are left untouched. Writes go
+// through the writer, the Environment or a DirectWriter.
+template<typename TWriter>
+RecordMigrationResult migrate_records_v2(TWriter& writer,
+                                         lmdb::txn& txn,
+                                         lmdb::dbi& dbi,
+                                         SectionRegistry& registry,
+                                         PackageRecordSerializer const& serializer) {
+    std::vector<std::pair<std::string, std::string>> legacy_entries;
+
+    {
+        auto cursor = lmdb::cursor::open(txn, dbi);
+        std::string_view key;
+        std::string_view value;
+
+        while (cursor.get(key, value, MDB_NEXT)) {
+            if (SectionRegistry::is_legacy_key(key) || PackageRecordSerializer::is_legacy(value)) {
+                legacy_entries.emplace_back(key, value);
+            }
+        }
+    }
+
+    RecordMigrationResult result;
+
+    for (auto const& [key, value] : legacy_entries) {
+        auto record = serializer.deserialize(value);
+        if (!record.has_value()) {
+            result.failed.emplace_back(key);
+            continue;
+        }
+
+        registry.ensure(writer, txn, record->id.section);
+
+        auto new_key = registry.key_for(record->id);
+        auto serialized = serializer.serialize(*record);
+        if (!new_key || !serialized.has_value()) {
+            result.failed.emplace_back(key);
+            continue;
+        }
+
+        writer.put(txn, dbi.handle(), *new_key, *serialized);
+        if (*new_key != key) {
+            writer.del(txn, dbi.handle(), key);
+        }
+
+        ++result.migrated;
+    }
+
+    return result;
+}
+
+} // namespace bxt::Persistence::Box
@@ -0,0 +1,160 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "core/application/dtos/PackageSectionDTO.h"
+#include "persistence/box/record/PackageRecord.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <lmdbxx/lmdb++.h>
+#include <optional>
+#include <parallel_hashmap/phmap.h>
+#include <string>
+#include <string_view>
+
+namespace bxt::Persistence::Box {
+
+// Assigns compact, persistent ids to sections and builds the binary record keys
+// out of them: a zero marker byte (never present in legacy text keys), the
+// big-endian section id and the package name. Keys of one section share a
+// 3-byte prefix so section scans remain prefix scans.
+class SectionRegistry {
+public:
+    static constexpr char KeyMarker = '\0';
+    static constexpr size_t PrefixSize = 3;
+
+    explicit SectionRegistry(lmdb::dbi dbi)
+        : m_dbi(std::move(dbi)) {
+    }
+
+    // Reads all assigned ids from the database
+    void load(lmdb::txn& txn) {
+        m_ids.clear();
+        m_sections.clear();
+
+        auto cursor = lmdb::cursor::open(txn, m_dbi);
+
+        std::string_view key;
+        std::string_view value;
+
+        while (cursor.get(key, value, MDB_NEXT)) {
+            if (value.size() != sizeof(uint16_t)) {
+                continue;
+            }
+
+            auto const id = decode_id(value.data());
+            auto section = parse_section(key);
+            if (!section) {
+                continue;
+            }
+
+            m_ids.emplace(*section, id);
+            m_sections.emplace(id, std::move(*section));
+        }
+    }
+
+    // Assigns an id to the section if it doesn't have one yet. Only meant to be
+    // called on startup in a write txn that gets committed, ids are not reclaimed.
+    // The id is stored through the writer, the Environment or a DirectWriter.
+    template<typename TWriter>
+    uint16_t ensure(TWriter& writer,
+                    lmdb::txn& txn,
+                    Core::Application::PackageSectionDTO const& section) {
+        if (auto it = m_ids.find(section); it != m_ids.end()) {
+            return it->second;
+        }
+
+        uint16_t next_id = 1;
+        for (auto const& [id, _] : m_sections) {
+            next_id = std::max<uint16_t>(next_id, id + 1);
+        }
+
+        std::string encoded(sizeof(uint16_t), '\0');
+        encode_id(encoded.data(), next_id);
+        writer.put(txn, m_dbi.handle(), std::string(section), encoded);
+
+        m_ids.emplace(section, next_id);
+        m_sections.emplace(next_id, section);
+
+        return next_id;
+    }
+
+    std::optional<std::string> key_for(PackageRecord::Id const& id) const {
+        auto prefix = prefix_for(id.section);
+        if (!prefix) {
+            return {};
+        }
+
+        prefix->append(id.name);
+        return prefix;
+    }
+
+    std::optional<std::string>
+        prefix_for(Core::Application::PackageSectionDTO const& section) const {
+        auto it = m_ids.find(section);
+        if (it == m_ids.end()) {
+            return {};
+        }
+
+        std::string result(PrefixSize, KeyMarker);
+        encode_id(result.data() + 1, it->second);
+        return result;
+    }
+
+    std::optional<PackageRecord::Id> id_for(std::string_view key) const {
+        if (is_legacy_key(key) || key.size() < PrefixSize) {
+            return PackageRecord::Id::from_string(key);
+        }
+
+        auto it = m_sections.find(decode_id(key.data() + 1));
+        if (it == m_sections.end()) {
+            return {};
+        }
+
+        return PackageRecord::Id {it->second, std::string(key.substr(PrefixSize))};
+    }
+
+    static bool is_legacy_key(std::string_view key) {
+        return key.empty() || key.front() != KeyMarker;
+    }
+
+    lmdb::dbi& dbi() {
+        return m_dbi;
+    }
+
+private:
+    static void encode_id(char* target, uint16_t id) {
+        target[0] = static_cast<char>(id >> 8);
+        target[1] = static_cast<char>(id & 0xFF);
+    }
+
+    static uint16_t decode_id(char const* source) {
+        return static_cast<uint16_t>((static_cast<uint8_t>(source[0]) << 8)
+                                     | static_cast<uint8_t>(source[1]));
+    }
+
+    static std::optional<Core::Application::PackageSectionDTO>
+        parse_section(std::string_view value) {
+        auto const first = value.find('/');
+        auto const second = value.find('/', first == std::string_view::npos ? first : first + 1);
+        if (first == std::string_view::npos || second == std::string_view::npos) {
+            return {};
+        }
+
+        return Core::Application::PackageSectionDTO {
+            .branch = std::string(value.substr(0, first)),
+            .repository = std::string(value.substr(first + 1, second - first - 1)),
+            .architecture = std::string(value.substr(second + 1))};
+    }
+
+    lmdb::dbi m_dbi;
+    phmap::flat_hash_map<Core::Application::PackageSectionDTO, uint16_t> m_ids;
+    phmap::flat_hash_map<uint16_t, Core::Application::PackageSectionDTO> m_sections;
+};
+
+} // namespace bxt::Persistence::Box
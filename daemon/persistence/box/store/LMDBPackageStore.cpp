@@ -10,15 +10,37 @@
 #include "core/domain/repositories/UnitOfWorkBase.h"
 #include "persistence/box/pool/PoolBase.h"
 #include "persistence/box/record/PackageRecord.h"
+#include "persistence/box/record/RecordMigration.h"
 #include "persistence/lmdb/LmdbUnitOfWork.h"
+#include "utilities/log/Logging.h"
 #include "utilities/to_string.h"
 
+#include <algorithm>
+#include <chrono>
+#include <coro/sync_wait.hpp>
 #include <filesystem>
+#include <fmt/format.h>
 #include <memory>
+#include <parallel_hashmap/phmap.h>
+#include <ranges>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace bxt::Persistence::Box {
 
+namespace {
+    constexpr std::string_view SchemaVersionKey = "schema-version";
+
+    lmdb::dbi open_dbi(Utilities::LMDB::Environment& env, std::string const& name) {
+        auto txn = coro::sync_wait(env.begin_rw_txn());
+        auto dbi = lmdb::dbi::open(txn->value, name.c_str(), MDB_CREATE);
+        txn->value.commit();
+
+        return dbi;
+    }
+} // namespace
+
 LMDBPackageStore::LMDBPackageStore(BoxOptions& box_options,
                                    std::shared_ptr<Utilities::LMDB::Environment> env,
                                    PoolBase& pool,
@@ -26,47 +48,343 @@ LMDBPackageStore::LMDBPackageStore(BoxOptions& box_options,
                                    std::string_view const name)
     : m_root_path(box_options.box_path)
     , m_pool(pool)
-    , m_db(env, name)
+    , m_db(env,
+           name,
+           PackageRecordSerializer(std::filesystem::weakly_canonical(box_options.box_path)))
+    , m_files_db(env, fmt::format("{}::Files", name))
+    , m_file_refs(env, fmt::format("{}::FileRefs", name))
+    , m_meta_db(env, fmt::format("{}::Meta", name))
+    , m_export_journal(env, fmt::format("{}::ExportJournal", name))
+    , m_sections(open_dbi(*env, fmt::format("{}::Sections", name)))
+    , m_name_index(env, fmt::format("{}::ByName", name))
+    , m_pool_path_index(env, fmt::format("{}::ByPoolPath", name))
     , m_section_repository(section_repository) {
 }
 
+std::expected<void, DatabaseError> LMDBPackageStore::prepare() {
+    if (auto prepared = prepare_schema(); !prepared) {
+        return prepared;
+    }
+
+    build_indexes();
+    count_file_references();
+
+    return {};
+}
+
+std::expected<void, DatabaseError> LMDBPackageStore::prepare_schema() {
+    // Sections come from the configuration, the unit of work is not used
+    auto const sections = coro::sync_wait(m_section_repository.all_async(nullptr));
+    if (!sections.has_value()) {
+        loge("Box: Can't get available sections, the reason is \"{}\"",
+             sections.error().what());
+        return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    auto& env = *m_db.env();
+    auto txn = coro::sync_wait(env.begin_rw_txn());
+
+    auto const current_version = std::to_string(PackageRecordSerializer::SchemaVersion);
+
+    try {
+        m_sections.load(txn->value);
+        for (auto const& section : *sections) {
+            m_sections.ensure(env, txn->value, SectionDTOMapper::to_dto(section));
+        }
+
+        auto const version = coro::sync_wait(m_meta_db.get(txn->value, SchemaVersionKey));
+        if (version.has_value() && *version == current_version) {
+            env.commit(txn->value);
+            return {};
+        }
+
+        logi("Box: Migrating package records to schema v{}", current_version);
+
+        auto const migration =
+            migrate_records_v2(env, txn->value, m_db.dbi(), m_sections, m_db.serializer());
+        for (auto const& key : migration.failed) {
+            logw("Box: Record \"{}\" can't be migrated and is left as is", key);
+        }
+
+        // Index values are record keys, they are rebuilt with the new ones
+        for (auto* index : {&m_name_index, &m_pool_path_index}) {
+            if (auto cleared = coro::sync_wait(index->clear(txn->value)); !cleared) {
+                return std::unexpected(std::move(cleared.error()));
+            }
+        }
+
+        auto stored = coro::sync_wait(m_meta_db.put(txn->value, SchemaVersionKey, current_version));
+        if (!stored.has_value()) {
+            loge("Box: Can't store the schema version");
+            return std::unexpected(std::move(stored.error()));
+        }
+
+        env.commit(txn->value);
+
+        logi("Box: Migrated {} package records", migration.migrated);
+    } catch (lmdb::error const& error) {
+        loge("Box: Can't prepare the package database, the error is \"{}\"", error.what());
+        return bxt::make_error_with_source<DatabaseError>(
+            Utilities::LMDB::Error(std::move(error)),
+            DatabaseError::ErrorType::DatabaseMalformedError);
+    }
+
+    return {};
+}
+
+std::expected<std::string, DatabaseError>
+    LMDBPackageStore::key_for(PackageRecord::Id const& id) const {
+    auto key = m_sections.key_for(id);
+    if (!key) {
+        return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    return std::move(*key);
+}
+
+std::expected<PackageStoreBase::Generation, DatabaseError>
+    LMDBPackageStore::generation(std::shared_ptr<UnitOfWorkBase> uow) {
+    auto lmdb_uow = std::dynamic_pointer_cast<LmdbUnitOfWork>(uow);
+    if (!lmdb_uow) {
+        return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    return Generation {.id = mdb_txn_id(lmdb_uow->txn().value.handle()),
+                       .read_only = lmdb_uow->read_only()};
+}
+
+void LMDBPackageStore::build_indexes() {
+    auto txn = coro::sync_wait(m_db.env()->begin_rw_txn());
+
+    if (!m_name_index.empty(txn->value) || m_db.dbi().size(txn->value) == 0) {
+        return;
+    }
+
+    logi("Box: Building package indexes");
+
+    std::vector<std::pair<std::string, PackageRecord>> records;
+    coro::sync_wait(m_db.accept(txn->value, [&records](std::string_view key, auto const& value) {
+        records.emplace_back(key, value);
+        return Utilities::NavigationAction::Next;
+    }));
+
+    for (auto const& [key, record] : records) {
+        if (auto indexed = coro::sync_wait(index(txn->value, key, record)); !indexed) {
+            loge("Box: Cannot index {}: {}", record.id.to_string(), indexed.error().what());
+            return;
+        }
+    }
+
+    m_db.env()->commit(txn->value);
+
+    logi("Box: Indexed {} packages", records.size());
+}
+
+void LMDBPackageStore::count_file_references() {
+    auto txn = coro::sync_wait(m_db.env()->begin_rw_txn());
+
+    if (m_file_refs.dbi().size(txn->value) != 0 || m_files_db.dbi().size(txn->value) == 0) {
+        return;
+    }
+
+    logi("Box: Counting file list references");
+
+    phmap::flat_hash_map<std::string, uint64_t> counts;
+    coro::sync_wait(m_db.accept(txn->value, [&counts](std::string_view, auto const& value) {
+        for (auto const& [location, description] : value.descriptions) {
+            if (!description.sha256sum.empty()) {
+                counts[description.sha256sum] += 1;
+            }
+        }
+        return Utilities::NavigationAction::Next;
+    }));
+
+    // Lists of packages deleted before references were counted are dropped
+    std::vector<std::string> orphans;
+    {
+        auto cursor = lmdb::cursor::open(txn->value, m_files_db.dbi());
+
+        std::string_view hash;
+        std::string_view files;
+        for (auto found = cursor.get(hash, files, MDB_FIRST); found;
+             found = cursor.get(hash, files, MDB_NEXT)) {
+            auto const count = counts.find(std::string(hash));
+            if (count == counts.end()) {
+                orphans.emplace_back(hash);
+                continue;
+            }
+
+            if (auto counted = coro::sync_wait(m_file_refs.put(txn->value, hash, count->second));
+                !counted) {
+                loge("Box: Cannot count references of {}: {}", hash, counted.error().what());
+                return;
+            }
+        }
+    }
+
+    for (auto const& hash : orphans) {
+        if (auto deleted = coro::sync_wait(m_files_db.del(txn->value, hash)); !deleted) {
+            loge("Box: Cannot remove file list {}: {}", hash, deleted.error().what());
+            return;
+        }
+    }
+
+    m_db.env()->commit(txn->value);
+
+    logi("Box: Counted file list references, removed {} unreferenced lists", orphans.size());
+}
+
 coro::task<std::expected<void, DatabaseError>>
-    LMDBPackageStore::add(PackageRecord const package, std::shared_ptr<UnitOfWorkBase> uow) {
-    auto section =
-        co_await m_section_repository.find_by_id_async(bxt::to_string(package.id.section), uow);
+    LMDBPackageStore::index(lmdb::txn& txn, std::string_view key, PackageRecord const& package) {
+    if (auto added = co_await m_name_index.add(txn, package.id.name, key); !added) {
+        co_return std::unexpected(std::move(added.error()));
+    }
 
-    if (!section.has_value()) {
-        co_return bxt::make_error_with_source<DatabaseError>(
-            std::move(section.error()), DatabaseError::ErrorType::InvalidArgument);
+    for (auto const& [location, description] : package.descriptions) {
+        if (auto added = co_await m_pool_path_index.add(txn, description.filepath.string(), key);
+            !added) {
+            co_return std::unexpected(std::move(added.error()));
+        }
+    }
+
+    co_return {};
+}
+
+coro::task<std::expected<void, DatabaseError>>
+    LMDBPackageStore::unindex(lmdb::txn& txn, std::string_view key, PackageRecord const& package) {
+    if (auto removed = co_await m_name_index.remove(txn, package.id.name, key); !removed) {
+        co_return std::unexpected(std::move(removed.error()));
     }
 
+    for (auto const& [location, description] : package.descriptions) {
+        if (auto removed =
+                co_await m_pool_path_index.remove(txn, description.filepath.string(), key);
+            !removed) {
+            co_return std::unexpected(std::move(removed.error()));
+        }
+    }
+
+    co_return {};
+}
+
+coro::task<std::expected<std::vector<PackageRecord>, DatabaseError>>
+    LMDBPackageStore::resolve(lmdb::txn& txn, std::vector<std::string> const& keys) {
+    std::vector<PackageRecord> result;
+    result.reserve(keys.size());
+
+    for (auto const& key : keys) {
+        auto record = co_await m_db.get(txn, key);
+        if (!record.has_value()) {
+            co_return std::unexpected(std::move(record.error()));
+        }
+        result.emplace_back(std::move(*record));
+    }
+
+    co_return result;
+}
+
+coro::task<std::expected<void, DatabaseError>>
+    LMDBPackageStore::validate_sections(std::vector<PackageRecord> const& packages,
+                                        std::shared_ptr<UnitOfWorkBase> uow) {
+    phmap::flat_hash_set<std::string> validated;
+
+    for (auto const& package : packages) {
+        auto section_name = bxt::to_string(package.id.section);
+        if (validated.contains(section_name)) {
+            continue;
+        }
+
+        auto section = co_await m_section_repository.find_by_id_async(section_name, uow);
+        if (!section.has_value()) {
+            co_return bxt::make_error_with_source<DatabaseError>(
+                std::move(section.error()), DatabaseError::ErrorType::InvalidArgument);
+        }
+
+        validated.emplace(std::move(section_name));
+    }
+
+    co_return {};
+}
+
+coro::task<std::expected<void, DatabaseError>>
+    LMDBPackageStore::add(PackageRecord const package, std::shared_ptr<UnitOfWorkBase> uow) {
+    co_return co_await add(std::vector {package}, uow);
+}
+
+coro::task<std::expected<void, DatabaseError>>
+    LMDBPackageStore::add(std::vector<PackageRecord> const packages,
+                          std::shared_ptr<UnitOfWorkBase> uow) {
+    auto const started_at = std::chrono::steady_clock::now();
+
     auto lmdb_uow = std::dynamic_pointer_cast<LmdbUnitOfWork>(uow);
     if (!lmdb_uow) {
         co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
     }
 
-    auto package_after_move = m_pool.path_for_package(package);
+    if (auto validated = co_await validate_sections(packages, uow); !validated.has_value()) {
+        co_return std::unexpected(std::move(validated.error()));
+    }
 
-    if (!package_after_move.has_value()) {
-        co_return bxt::make_error_with_source<DatabaseError>(
-            std::move(package_after_move.error()), DatabaseError::ErrorType::InvalidArgument);
+    auto& txn = lmdb_uow->txn().value;
+
+    std::vector<std::pair<std::string, PackageRecord>> entries;
+    entries.reserve(packages.size());
+
+    for (auto const& package : packages) {
+        auto package_after_move = m_pool.path_for_package(package);
+
+        if (!package_after_move.has_value()) {
+            co_return bxt::make_error_with_source<DatabaseError>(
+                std::move(package_after_move.error()), DatabaseError::ErrorType::InvalidArgument);
+        }
+
+        auto key = key_for(package.id);
+        if (!key.has_value()) {
+            co_return std::unexpected(std::move(key.error()));
+        }
+
+        entries.emplace_back(std::move(*key), std::move(*package_after_move));
     }
 
-    auto const key = package.id.to_string();
+    std::ranges::sort(entries, {}, &std::pair<std::string, PackageRecord>::first);
 
-    auto existing_package = co_await m_db.get(lmdb_uow->txn().value, key);
-    if (existing_package.has_value()) {
+    if (std::ranges::adjacent_find(entries, {}, &std::pair<std::string, PackageRecord>::first)
+        != entries.end()) {
         co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::AlreadyExists);
     }
 
-    auto result = co_await m_db.put(lmdb_uow->txn().value, key, *package_after_move);
+    for (auto& [key, record] : entries) {
+        auto exists = co_await m_db.contains(txn, key);
+        if (!exists.has_value()) {
+            co_return std::unexpected(std::move(exists.error()));
+        }
+        if (*exists) {
+            co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::AlreadyExists);
+        }
 
-    if (!result.has_value()) {
+        if (auto stored = co_await store_files(record, txn); !stored.has_value()) {
+            co_return bxt::make_error_with_source<DatabaseError>(
+                std::move(stored.error()), DatabaseError::ErrorType::InvalidArgument);
+        }
+    }
+
+    if (auto result = co_await m_db.put_sorted(txn, entries); !result.has_value()) {
         co_return bxt::make_error_with_source<DatabaseError>(
             std::move(result.error()), DatabaseError::ErrorType::InvalidArgument);
     }
 
-    lmdb_uow->hook([this, package = std::move(package)] { m_pool.move_to(std::move(package)); });
+    for (auto const& [key, record] : entries) {
+        if (auto indexed = co_await index(txn, key, record); !indexed.has_value()) {
+            co_return std::unexpected(std::move(indexed.error()));
+        }
+    }
+
+    move_to_pool_on_commit(*lmdb_uow, std::move(packages));
+
+    logd("Box: Added {} packages in {} ms", entries.size(),
+         std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()
+                                                               - started_at)
+             .count());
 
     co_return {};
 }
@@ -87,18 +405,36 @@ coro::task<std::expected<void, DatabaseError>>
         co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
     }
 
-    auto package_to_delete = co_await m_db.get(lmdb_uow->txn().value, package_id.to_string());
+    auto key = key_for(package_id);
+    if (!key.has_value()) {
+        co_return std::unexpected(std::move(key.error()));
+    }
+
+    auto package_to_delete = co_await m_db.get(lmdb_uow->txn().value, *key);
 
     if (!package_to_delete.has_value()) {
         co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::EntityNotFound);
     }
 
-    auto result = co_await m_db.del(lmdb_uow->txn().value, package_id.to_string());
+    auto result = co_await m_db.del(lmdb_uow->txn().value, *key);
 
     if (!result.has_value()) {
         co_return bxt::make_error_with_source<DatabaseError>(
             std::move(result.error()), DatabaseError::ErrorType::InvalidArgument);
     }
+
+    if (auto unindexed = co_await unindex(lmdb_uow->txn().value, *key, *package_to_delete);
+        !unindexed.has_value()) {
+        co_return std::unexpected(std::move(unindexed.error()));
+    }
+
+    for (auto const& [location, description] : package_to_delete->descriptions) {
+        if (auto released = co_await release_files(description, lmdb_uow->txn().value);
+            !released.has_value()) {
+            co_return std::unexpected(std::move(released.error()));
+        }
+    }
+
     lmdb_uow->hook([this, package_to_delete = std::move(*package_to_delete)] {
         return m_pool.remove(std::move(package_to_delete)).has_value();
     });
@@ -108,57 +444,128 @@ coro::task<std::expected<void, DatabaseError>>
 
 coro::task<std::expected<void, DatabaseError>>
     LMDBPackageStore::update(PackageRecord const package, std::shared_ptr<UnitOfWorkBase> uow) {
-    auto section =
-        co_await m_section_repository.find_by_id_async(bxt::to_string(package.id.section), uow);
+    co_return co_await update(std::vector {package}, uow);
+}
 
-    if (!section.has_value()) {
-        co_return bxt::make_error_with_source<DatabaseError>(
-            std::move(section.error()), DatabaseError::ErrorType::InvalidArgument);
-    }
+coro::task<std::expected<void, DatabaseError>>
+    LMDBPackageStore::update(std::vector<PackageRecord> const packages,
+                             std::shared_ptr<UnitOfWorkBase> uow) {
+    struct PendingUpdate {
+        std::string key;
+        PackageRecord package;
+        PackageRecord existing;
+        PackageRecord merged;
+    };
+
+    auto const started_at = std::chrono::steady_clock::now();
 
     auto lmdb_uow = std::dynamic_pointer_cast<LmdbUnitOfWork>(uow);
     if (!lmdb_uow) {
         co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
     }
-    auto moved_package_path = m_pool.path_for_package(package);
 
-    if (!moved_package_path.has_value()) {
-        co_return bxt::make_error_with_source<DatabaseError>(
-            std::move(moved_package_path.error()), DatabaseError::ErrorType::InvalidArgument);
+    if (auto validated = co_await validate_sections(packages, uow); !validated.has_value()) {
+        co_return std::unexpected(std::move(validated.error()));
     }
 
-    auto const key = package.id.to_string();
+    auto& txn = lmdb_uow->txn().value;
+
+    std::vector<PendingUpdate> pending;
+    pending.reserve(packages.size());
+
+    for (auto const& package : packages) {
+        auto moved_package_path = m_pool.path_for_package(package);
+
+        if (!moved_package_path.has_value()) {
+            co_return bxt::make_error_with_source<DatabaseError>(
+                std::move(moved_package_path.error()), DatabaseError::ErrorType::InvalidArgument);
+        }
+
+        if (auto stored = co_await store_files(*moved_package_path, txn); !stored.has_value()) {
+            co_return bxt::make_error_with_source<DatabaseError>(
+                std::move(stored.error()), DatabaseError::ErrorType::InvalidArgument);
+        }
+
+        auto key = key_for(package.id);
+        if (!key.has_value()) {
+            co_return std::unexpected(std::move(key.error()));
+        }
+
+        auto existing_package = co_await m_db.get(txn, *key);
+        if (!existing_package.has_value()) {
+            co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::EntityNotFound);
+        }
 
-    auto existing_package = co_await m_db.get(lmdb_uow->txn().value, key);
-    if (existing_package.has_value()) {
         auto merged_package = *existing_package;
         for (auto const& [location, desc] : moved_package_path->descriptions) {
             merged_package.descriptions[location] = desc;
         }
-        moved_package_path = merged_package;
-    } else {
-        co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::EntityNotFound);
+
+        pending.emplace_back(std::move(*key), package, std::move(*existing_package),
+                             std::move(merged_package));
     }
 
-    auto result = co_await m_db.put(lmdb_uow->txn().value, key, *moved_package_path);
+    std::ranges::sort(pending, {}, &PendingUpdate::key);
 
-    if (!result.has_value()) {
+    if (std::ranges::adjacent_find(pending, {}, &PendingUpdate::key) != pending.end()) {
+        co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    auto entries = pending | std::views::transform([](PendingUpdate const& update) {
+                       return std::make_pair(update.key, update.merged);
+                   })
+                   | std::ranges::to<std::vector>();
+
+    if (auto result = co_await m_db.put_sorted(txn, entries); !result.has_value()) {
         co_return bxt::make_error_with_source<DatabaseError>(
             std::move(result.error()), DatabaseError::ErrorType::InvalidArgument);
     }
 
-    lmdb_uow->hook([this, package, moved_package_path, existing_package] {
+    for (auto const& update : pending) {
+        if (auto unindexed = co_await unindex(txn, update.key, update.existing);
+            !unindexed.has_value()) {
+            co_return std::unexpected(std::move(unindexed.error()));
+        }
+
+        if (auto indexed = co_await index(txn, update.key, update.merged); !indexed.has_value()) {
+            co_return std::unexpected(std::move(indexed.error()));
+        }
+
+        // New lists were counted by store_files, so a list kept by the update survives
+        for (auto const& [location, description] : update.existing.descriptions) {
+            if (!update.package.descriptions.contains(location)) {
+                continue;
+            }
+
+            if (auto released = co_await release_files(description, txn); !released.has_value()) {
+                co_return std::unexpected(std::move(released.error()));
+            }
+        }
+    }
+
+    std::vector<PackageRecord> packages;
+    packages.reserve(pending.size());
+
+    for (auto const& [key, package, existing, merged] : pending) {
+        // Files already at their pool location don't need to be moved again
         auto tmp_package = package;
-        for (auto const& desc : moved_package_path->descriptions) {
+        for (auto const& desc : merged.descriptions) {
             if (package.descriptions.contains(desc.first)
-                && existing_package->descriptions.contains(desc.first)
-                && desc.second.filepath == existing_package->descriptions.at(desc.first).filepath) {
+                && existing.descriptions.contains(desc.first)
+                && desc.second.filepath == existing.descriptions.at(desc.first).filepath) {
                 tmp_package.descriptions.erase(desc.first);
             }
         }
 
-        m_pool.move_to(std::move(tmp_package));
-    });
+        packages.emplace_back(std::move(tmp_package));
+    }
+
+    move_to_pool_on_commit(*lmdb_uow, std::move(packages));
+
+    logd("Box: Updated {} packages in {} ms", pending.size(),
+         std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()
+                                                               - started_at)
+             .count());
 
     co_return {};
 }
@@ -172,36 +579,358 @@ coro::task<std::expected<std::vector<PackageRecord>, DatabaseError>>
     }
 
     std::vector<PackageRecord> result;
+
+    // Sections without an id have never had packages stored
+    auto const prefix = m_sections.prefix_for(section);
+    if (!prefix) {
+        co_return result;
+    }
+
     co_await m_db.accept(
         lmdb_uow->txn().value,
         [&result]([[maybe_unused]] std::string_view key, auto const& value) {
             result.emplace_back(value);
             return Utilities::NavigationAction::Next;
         },
-        std::string(section));
+        *prefix);
 
     co_return result;
 }
 
+coro::task<std::expected<PackageRecord, DatabaseError>>
+    LMDBPackageStore::find_by_id(PackageRecord::Id const package_id,
+                                 std::shared_ptr<UnitOfWorkBase> uow) {
+    auto lmdb_uow = std::dynamic_pointer_cast<LmdbUnitOfWork>(uow);
+    if (!lmdb_uow) {
+        co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    auto key = key_for(package_id);
+    if (!key.has_value()) {
+        co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::EntityNotFound);
+    }
+
+    co_return co_await m_db.get(lmdb_uow->txn().value, *key);
+}
+
+coro::task<std::expected<std::vector<PackageRecord>, DatabaseError>>
+    LMDBPackageStore::find_by_name(std::string const name, std::shared_ptr<UnitOfWorkBase> uow) {
+    auto lmdb_uow = std::dynamic_pointer_cast<LmdbUnitOfWork>(uow);
+    if (!lmdb_uow) {
+        co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    auto keys = co_await m_name_index.find(lmdb_uow->txn().value, name);
+    if (!keys.has_value()) {
+        co_return std::unexpected(std::move(keys.error()));
+    }
+
+    co_return co_await resolve(lmdb_uow->txn().value, *keys);
+}
+
+coro::task<std::expected<std::vector<PackageRecord>, DatabaseError>>
+    LMDBPackageStore::find_by_pool_path(std::filesystem::path const path,
+                                        std::shared_ptr<UnitOfWorkBase> uow) {
+    auto lmdb_uow = std::dynamic_pointer_cast<LmdbUnitOfWork>(uow);
+    if (!lmdb_uow) {
+        co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    auto keys = co_await m_pool_path_index.find(lmdb_uow->txn().value, path.string());
+    if (!keys.has_value()) {
+        co_return std::unexpected(std::move(keys.error()));
+    }
+
+    co_return co_await resolve(lmdb_uow->txn().value, *keys);
+}
+
+std::expected<std::string_view, DatabaseError>
+    LMDBPackageStore::desc_view(std::string_view key,
+                                Core::Domain::PoolLocation location,
+                                std::shared_ptr<UnitOfWorkBase> uow) {
+    auto lmdb_uow = std::dynamic_pointer_cast<LmdbUnitOfWork>(uow);
+    if (!lmdb_uow) {
+        return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    std::string_view value;
+    try {
+        if (!m_db.dbi().get(lmdb_uow->txn().value, key, value)) {
+            return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::EntityNotFound);
+        }
+    } catch (lmdb::error const& error) {
+        return bxt::make_error_with_source<DatabaseError>(
+            Utilities::LMDB::Error(std::move(error)),
+            DatabaseError::ErrorType::DatabaseMalformedError);
+    }
+
+    auto desc = m_db.serializer().desc_view(value, location);
+    if (!desc.has_value()) {
+        return bxt::make_error_with_source<DatabaseError>(
+            std::move(desc.error()), DatabaseError::ErrorType::InvalidEntityError);
+    }
+
+    return *desc;
+}
+
+std::expected<std::string_view, DatabaseError>
+    LMDBPackageStore::files_view(PackageRecord::Description const& description,
+                                 std::shared_ptr<UnitOfWorkBase> uow) {
+    // Records written before file lists were split out still embed them
+    if (!description.descfile.files().empty()) {
+        return description.descfile.files();
+    }
+
+    auto lmdb_uow = std::dynamic_pointer_cast<LmdbUnitOfWork>(uow);
+    if (!lmdb_uow) {
+        return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    if (description.sha256sum.empty()) {
+        return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::EntityNotFound);
+    }
+
+    std::string_view value;
+    try {
+        if (!m_files_db.dbi().get(lmdb_uow->txn().value, description.sha256sum, value)) {
+            return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::EntityNotFound);
+        }
+    } catch (lmdb::error const& error) {
+        return bxt::make_error_with_source<DatabaseError>(
+            Utilities::LMDB::Error(std::move(error)),
+            DatabaseError::ErrorType::DatabaseMalformedError);
+    }
+
+    auto files = Utilities::LMDB::string_view_of(value);
+    if (!files) {
+        return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidEntityError);
+    }
+
+    return *files;
+}
+
+void LMDBPackageStore::move_to_pool_on_commit(LmdbUnitOfWork& uow,
+                                              std::vector<PackageRecord> packages) {
+    auto moved = std::make_shared<std::vector<PoolMove>>();
+
+    uow.checked_hook(
+        [this, packages = std::move(packages), moved]() -> UnitOfWorkBase::Result<void> {
+            for (auto const& package : packages) {
+                auto result = m_pool.move_to(package);
+                if (!result.has_value()) {
+                    restore_staged(*moved);
+
+                    return bxt::make_error_with_source<UnitOfWorkBase::Error>(
+                        std::move(result.error()),
+                        UnitOfWorkBase::Error::ErrorType::OperationError);
+                }
+
+                moved->emplace_back(std::move(*result), package);
+            }
+
+            return {};
+        },
+        "", [this, moved] { restore_staged(*moved); });
+}
+
+void LMDBPackageStore::restore_staged(std::vector<PoolMove>& moved) {
+    // Backwards, a file shared by several records goes back with the last of them
+    for (auto const& [pooled, staged] : moved | std::views::reverse) {
+        if (auto restored = m_pool.restore(pooled, staged); !restored.has_value()) {
+            logw("Box: Can't move {} out of the pool, the error is \"{}\"",
+                 pooled.id.to_string(), restored.error().what());
+        }
+    }
+
+    moved.clear();
+}
+
+coro::task<std::expected<void, DatabaseError>>
+    LMDBPackageStore::store_files(PackageRecord& package, lmdb::txn& txn) {
+    for (auto& [location, description] : package.descriptions) {
+        auto const& hash = description.sha256sum;
+        if (hash.empty()) {
+            continue;
+        }
+
+        auto exists = co_await m_files_db.contains(txn, hash);
+        if (!exists.has_value()) {
+            co_return std::unexpected(std::move(exists.error()));
+        }
+
+        if (!*exists) {
+            if (description.descfile.files().empty()) {
+                continue;
+            }
+
+            auto stored = co_await m_files_db.put(txn, hash, description.descfile.files());
+            if (!stored.has_value()) {
+                co_return std::unexpected(std::move(stored.error()));
+            }
+        }
+
+        description.descfile.set_files({});
+
+        uint64_t references = 0;
+        if (auto counted = co_await m_file_refs.contains(txn, hash); !counted.has_value()) {
+            co_return std::unexpected(std::move(counted.error()));
+        } else if (*counted) {
+            auto current = co_await m_file_refs.get(txn, hash);
+            if (!current.has_value()) {
+                co_return std::unexpected(std::move(current.error()));
+            }
+            references = *current;
+        }
+
+        if (auto counted = co_await m_file_refs.put(txn, hash, references + 1); !counted) {
+            co_return std::unexpected(std::move(counted.error()));
+        }
+    }
+
+    co_return {};
+}
+
+coro::task<std::expected<void, DatabaseError>>
+    LMDBPackageStore::release_files(PackageRecord::Description const& description,
+                                    lmdb::txn& txn) {
+    auto const& hash = description.sha256sum;
+    if (hash.empty()) {
+        co_return {};
+    }
+
+    // Lists embedded in records written before they were split out aren't counted
+    auto counted = co_await m_file_refs.contains(txn, hash);
+    if (!counted.has_value()) {
+        co_return std::unexpected(std::move(counted.error()));
+    }
+    if (!*counted) {
+        co_return {};
+    }
+
+    auto references = co_await m_file_refs.get(txn, hash);
+    if (!references.has_value()) {
+        co_return std::unexpected(std::move(references.error()));
+    }
+
+    if (*references > 1) {
+        if (auto stored = co_await m_file_refs.put(txn, hash, *references - 1); !stored) {
+            co_return std::unexpected(std::move(stored.error()));
+        }
+        co_return {};
+    }
+
+    if (auto deleted = co_await m_file_refs.del(txn, hash); !deleted) {
+        co_return std::unexpected(std::move(deleted.error()));
+    }
+    if (auto deleted = co_await m_files_db.del(txn, hash); !deleted) {
+        co_return std::unexpected(std::move(deleted.error()));
+    }
+
+    co_return {};
+}
+
 coro::task<std::expected<void, DatabaseError>> LMDBPackageStore::accept(
     std::function<Utilities::NavigationAction(std::string_view key, PackageRecord const& value)>
         visitor,
     std::shared_ptr<UnitOfWorkBase> uow) {
-    co_return co_await accept(visitor, "", uow);
+    auto lmdb_uow = std::dynamic_pointer_cast<LmdbUnitOfWork>(uow);
+    if (!lmdb_uow) {
+        co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
+    co_await m_db.accept(lmdb_uow->txn().value, visitor);
+
+    co_return {};
 }
 
 coro::task<std::expected<void, DatabaseError>> LMDBPackageStore::accept(
     std::function<Utilities::NavigationAction(std::string_view key, PackageRecord const& value)>
         visitor,
-    std::string_view prefix,
+    PackageSectionDTO const section,
     std::shared_ptr<UnitOfWorkBase> uow) {
     auto lmdb_uow = std::dynamic_pointer_cast<LmdbUnitOfWork>(uow);
     if (!lmdb_uow) {
         co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
     }
-    co_await m_db.accept(lmdb_uow->txn().value, visitor, prefix);
+
+    auto const prefix = m_sections.prefix_for(section);
+    if (!prefix) {
+        co_return {};
+    }
+
+    co_await m_db.accept(lmdb_uow->txn().value, visitor, *prefix);
 
     co_return {};
 }
 
+coro::task<std::expected<void, DatabaseError>>
+    LMDBPackageStore::mark_dirty(PackageSectionDTO const section,
+                                 std::shared_ptr<UnitOfWorkBase> uow) {
+    auto lmdb_uow = std::dynamic_pointer_cast<LmdbUnitOfWork>(uow);
+    if (!lmdb_uow || lmdb_uow->read_only()) {
+        co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    auto& txn = lmdb_uow->txn().value;
+
+    auto const marked = co_await m_export_journal.put(
+        txn, std::string(section),
+        JournalEntry {.section = section, .marked = mdb_txn_id(txn.handle())});
+    if (!marked.has_value()) {
+        co_return std::unexpected(std::move(marked.error()));
+    }
+
+    co_return {};
+}
+
+coro::task<std::expected<void, DatabaseError>> LMDBPackageStore::mark_published(
+    std::vector<std::pair<PackageSectionDTO, uint64_t>> const sections) {
+    if (sections.empty()) {
+        co_return {};
+    }
+
+    auto txn = co_await m_export_journal.env()->begin_rw_txn();
+
+    for (auto const& [section, snapshot] : sections) {
+        auto const key = std::string(section);
+
+        auto const entry = co_await m_export_journal.get(txn->value, key);
+        if (!entry.has_value() || entry->marked > snapshot) {
+            continue;
+        }
+
+        if (auto deleted = co_await m_export_journal.del(txn->value, key); !deleted) {
+            co_return std::unexpected(std::move(deleted.error()));
+        }
+    }
+
+    try {
+        m_export_journal.env()->commit(txn->value);
+    } catch (lmdb::error const& error) {
+        co_return bxt::make_error_with_source<DatabaseError>(
+            Utilities::LMDB::Error(std::move(error)),
+            DatabaseError::ErrorType::DatabaseMalformedError);
+    }
+
+    co_return {};
+}
+
+std::expected<std::set<PackageSectionDTO>, DatabaseError> LMDBPackageStore::dirty_sections() {
+    auto txn = coro::sync_wait(m_export_journal.env()->begin_ro_txn());
+
+    std::set<PackageSectionDTO> sections;
+    auto const accepted = coro::sync_wait(m_export_journal.accept(
+        txn->value, [&sections](std::string_view, JournalEntry const& entry) {
+            sections.emplace(entry.section);
+            return Utilities::NavigationAction::Next;
+        }));
+
+    m_export_journal.env()->release_ro_txn(std::move(txn->value));
+
+    if (!accepted.has_value()) {
+        return std::unexpected(std::move(accepted.error()));
+    }
+
+    return sections;
+}
+
 } // namespace bxt::Persistence::Box
@@ -14,15 +14,20 @@
 #include "persistence/box/export/AlpmDBExporter.h"
 #include "persistence/box/pool/PoolBase.h"
 #include "persistence/box/record/PackageRecord.h"
+#include "persistence/box/record/PackageRecordSerializer.h"
+#include "persistence/box/record/SectionRegistry.h"
 #include "persistence/box/store/PackageStoreBase.h"
-#include "persistence/box/writeback/WritebackScheduler.h"
+#include "persistence/lmdb/LmdbUnitOfWork.h"
 #include "utilities/lmdb/Database.h"
 #include "utilities/lmdb/Environment.h"
+#include "utilities/lmdb/Index.h"
 #include "utilities/locked.h"
 #include "utilities/NavigationAction.h"
 
 #include <kangaru/service.hpp>
 #include <memory>
+#include <set>
+#include <utility>
 #include <vector>
 
 namespace bxt::Persistence::Box {
@@ -37,9 +42,21 @@ public:
 
     ~LMDBPackageStore() override = default;
 
+    // Assigns ids to the configured sections, upgrades records stored in an
+    // older format and builds what's missing from older databases. Runs once
+    // before the store is used.
+    std::expected<void, DatabaseError> prepare();
+
+    std::expected<Generation, DatabaseError>
+        generation(std::shared_ptr<UnitOfWorkBase> uow) override;
+
     coro::task<std::expected<void, DatabaseError>>
         add(PackageRecord const package, std::shared_ptr<UnitOfWorkBase> uow) override;
 
+    coro::task<std::expected<void, DatabaseError>>
+        add(std::vector<PackageRecord> const packages,
+            std::shared_ptr<UnitOfWorkBase> uow) override;
+
     coro::task<std::expected<void, DatabaseError>>
         delete_by_id(PackageRecord::Id const package_id,
                      std::shared_ptr<UnitOfWorkBase> uow) override;
@@ -47,13 +64,37 @@ public:
     coro::task<std::expected<void, DatabaseError>>
         update(PackageRecord const package, std::shared_ptr<UnitOfWorkBase> uow) override;
 
+    coro::task<std::expected<void, DatabaseError>>
+        update(std::vector<PackageRecord> const packages,
+               std::shared_ptr<UnitOfWorkBase> uow) override;
+
     coro::task<std::expected<std::vector<PackageRecord>, DatabaseError>>
         find_by_section(PackageSectionDTO section, std::shared_ptr<UnitOfWorkBase> uow) override;
 
+    coro::task<std::expected<PackageRecord, DatabaseError>>
+        find_by_id(PackageRecord::Id const package_id,
+                   std::shared_ptr<UnitOfWorkBase> uow) override;
+
+    coro::task<std::expected<std::vector<PackageRecord>, DatabaseError>>
+        find_by_name(std::string const name, std::shared_ptr<UnitOfWorkBase> uow) override;
+
+    coro::task<std::expected<std::vector<PackageRecord>, DatabaseError>>
+        find_by_pool_path(std::filesystem::path const path,
+                          std::shared_ptr<UnitOfWorkBase> uow) override;
+
+    std::expected<std::string_view, DatabaseError>
+        desc_view(std::string_view key,
+                  Core::Domain::PoolLocation location,
+                  std::shared_ptr<UnitOfWorkBase> uow) override;
+
+    std::expected<std::string_view, DatabaseError>
+        files_view(PackageRecord::Description const& description,
+                   std::shared_ptr<UnitOfWorkBase> uow) override;
+
     coro::task<std::expected<void, DatabaseError>> accept(
         std::function<Utilities::NavigationAction(std::string_view key, PackageRecord const& value)>
             visitor,
-        std::string_view prefix,
+        PackageSectionDTO const section,
         std::shared_ptr<UnitOfWorkBase> uow) override;
 
     coro::task<std::expected<void, DatabaseError>> accept(
@@ -61,10 +102,76 @@ public:
             visitor,
         std::shared_ptr<UnitOfWorkBase> uow) override;
 
+    coro::task<std::expected<void, DatabaseError>>
+        mark_dirty(PackageSectionDTO const section, std::shared_ptr<UnitOfWorkBase> uow) override;
+
+    coro::task<std::expected<void, DatabaseError>> mark_published(
+        std::vector<std::pair<PackageSectionDTO, uint64_t>> const sections) override;
+
+    std::expected<std::set<PackageSectionDTO>, DatabaseError> dirty_sections() override;
+
 private:
+    struct JournalEntry {
+        PackageSectionDTO section;
+        // Id of the last write txn that changed the section
+        uint64_t marked = 0;
+
+        template<class Archive> void serialize(Archive& ar) {
+            ar(section, marked);
+        }
+    };
+
+    std::expected<void, DatabaseError> prepare_schema();
+
+    std::expected<std::string, DatabaseError> key_for(PackageRecord::Id const& id) const;
+
+    // Resolves every distinct section of the batch once
+    coro::task<std::expected<void, DatabaseError>>
+        validate_sections(std::vector<PackageRecord> const& packages,
+                          std::shared_ptr<UnitOfWorkBase> uow);
+
+    // Moves file lists out of the record into the files database. A list is
+    // shared by the records of the same package file and counted per record.
+    coro::task<std::expected<void, DatabaseError>> store_files(PackageRecord& package,
+                                                               lmdb::txn& txn);
+
+    // Drops the record's reference to its file list, the last one removes the list
+    coro::task<std::expected<void, DatabaseError>>
+        release_files(PackageRecord::Description const& description, lmdb::txn& txn);
+
+    // A record moved into the pool and the staged record it was moved from
+    using PoolMove = std::pair<PackageRecord, PackageRecord>;
+
+    // Moves the package files into the pool when the write commits. If one of
+    // them, a later hook or the commit itself fails, the files moved so far go
+    // back to where they were staged and the commit is aborted.
+    void move_to_pool_on_commit(LmdbUnitOfWork& uow, std::vector<PackageRecord> packages);
+    void restore_staged(std::vector<PoolMove>& moved);
+
+    coro::task<std::expected<void, DatabaseError>>
+        index(lmdb::txn& txn, std::string_view key, PackageRecord const& package);
+    coro::task<std::expected<void, DatabaseError>>
+        unindex(lmdb::txn& txn, std::string_view key, PackageRecord const& package);
+
+    coro::task<std::expected<std::vector<PackageRecord>, DatabaseError>>
+        resolve(lmdb::txn& txn, std::vector<std::string> const& keys);
+
+    // Populates the indexes for databases created before they were introduced
+    void build_indexes();
+
+    // Counts file list references for databases created before they were counted
+    void count_file_references();
+
     std::filesystem::path m_root_path;
     PoolBase& m_pool;
-    Utilities::LMDB::Database<PackageRecord> m_db;
+    Utilities::LMDB::Database<PackageRecord, PackageRecordSerializer> m_db;
+    Utilities::LMDB::Database<std::string> m_files_db;
+    Utilities::LMDB::Database<uint64_t> m_file_refs;
+    Utilities::LMDB::Database<std::string> m_meta_db;
+    Utilities::LMDB::Database<JournalEntry> m_export_journal;
+    SectionRegistry m_sections;
+    Utilities::LMDB::Index m_name_index;
+    Utilities::LMDB::Index m_pool_path_index;
     ReadOnlyRepositoryBase<Section>& m_section_repository;
 };
 
@@ -15,32 +15,92 @@
 #include "utilities/NavigationAction.h"
 
 #include <coro/task.hpp>
+#include <cstdint>
+#include <set>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace bxt::Persistence::Box {
 struct PackageStoreBase {
+    struct Generation {
+        uint64_t id;
+        bool read_only;
+    };
+
     virtual ~PackageStoreBase() = default;
 
+    // Database state the unit of work operates on: the snapshot read-only units
+    // of work see or the one the changes of a write will be committed as
+    virtual std::expected<Generation, DatabaseError>
+        generation(std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
     virtual coro::task<std::expected<void, DatabaseError>>
         add(PackageRecord const package, std::shared_ptr<UnitOfWorkBase> uow) = 0;
 
+    // Batched writes: sections are validated once and all pool moves share one hook
+    virtual coro::task<std::expected<void, DatabaseError>>
+        add(std::vector<PackageRecord> const packages, std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
     virtual coro::task<std::expected<void, DatabaseError>>
         update(PackageRecord const package, std::shared_ptr<UnitOfWorkBase> uow) = 0;
 
+    virtual coro::task<std::expected<void, DatabaseError>>
+        update(std::vector<PackageRecord> const packages, std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
     virtual coro::task<std::expected<void, DatabaseError>>
         delete_by_id(PackageRecord::Id const package_id, std::shared_ptr<UnitOfWorkBase> uow) = 0;
 
     virtual coro::task<std::expected<std::vector<PackageRecord>, DatabaseError>>
         find_by_section(PackageSectionDTO section, std::shared_ptr<UnitOfWorkBase> uow) = 0;
 
+    virtual coro::task<std::expected<PackageRecord, DatabaseError>>
+        find_by_id(PackageRecord::Id const package_id, std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
+    // Indexed lookups across all sections
+    virtual coro::task<std::expected<std::vector<PackageRecord>, DatabaseError>>
+        find_by_name(std::string const name, std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
+    virtual coro::task<std::expected<std::vector<PackageRecord>, DatabaseError>>
+        find_by_pool_path(std::filesystem::path const path,
+                          std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
+    // Views into the unit of work's snapshot, valid until the unit of work is
+    // finished. The desc of the record's description at the location, read in place.
+    virtual std::expected<std::string_view, DatabaseError>
+        desc_view(std::string_view key,
+                  Core::Domain::PoolLocation location,
+                  std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
+    // File lists are stored apart from the records and are only read on demand.
+    // Records written before they were split out embed them, the view then
+    // points into the description.
+    virtual std::expected<std::string_view, DatabaseError>
+        files_view(PackageRecord::Description const& description,
+                   std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
     virtual coro::task<std::expected<void, DatabaseError>> accept(
         std::function<Utilities::NavigationAction(std::string_view key, PackageRecord const& value)>
             visitor,
-        std::string_view prefix,
+        PackageSectionDTO const section,
         std::shared_ptr<UnitOfWorkBase> uow) = 0;
 
     virtual coro::task<std::expected<void, DatabaseError>> accept(
         std::function<Utilities::NavigationAction(std::string_view key, PackageRecord const& value)>
             visitor,
         std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
+    // Export journal: sections changed since their databases were last published.
+    // The mark is written in the unit of work, so it's committed with the change.
+    virtual coro::task<std::expected<void, DatabaseError>>
+        mark_dirty(PackageSectionDTO const section, std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
+    // Clears the marks of sections published from the given snapshot generations.
+    // Sections changed after their snapshot stay marked.
+    virtual coro::task<std::expected<void, DatabaseError>>
+        mark_published(std::vector<std::pair<PackageSectionDTO, uint64_t>> const sections) = 0;
+
+    // Sections whose changes may be missing on disk, e.g. after a crash
+    virtual std::expected<std::set<PackageSectionDTO>, DatabaseError> dirty_sections() = 0;
 };
 } // namespace bxt::Persistence::Box
@@ -0,0 +1,198 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "WritebackScheduler.h"
+
+#include "utilities/log/Logging.h"
+
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <utility>
+
+namespace bxt::Persistence::Box {
+
+using Core::Application::PackageSectionDTO;
+
+WritebackScheduler::WritebackScheduler(std::shared_ptr<coro::io_scheduler> scheduler,
+                                       BoxOptions& options,
+                                       ExporterBase& exporter)
+    : m_scheduler(std::move(scheduler))
+    , m_exporter(exporter)
+    , m_quiet_period(std::max<int64_t>(options.writeback_quiet_period, 0))
+    , m_max_delay(std::max<int64_t>(options.writeback_max_delay, 0)) {
+    // Exports the previous run didn't get to
+    auto const sections = exporter.dirty_sections();
+    if (!sections.empty()) {
+        logi("Writeback: Resuming the export of {} sections", sections.size());
+    }
+
+    for (auto const& section : sections) {
+        schedule(section);
+    }
+}
+
+void WritebackScheduler::schedule(PackageSectionDTO const& section) {
+    uint64_t id = 0;
+    {
+        std::lock_guard lock(m_pending_mutex);
+
+        auto [it, inserted] = m_pending.try_emplace(section);
+        it->second.commits.emplace_back(Clock::now());
+
+        // The running timer picks up the new deadline
+        if (!inserted) {
+            return;
+        }
+
+        id = it->second.id = ++m_next_id;
+    }
+
+    m_scheduler->schedule(run_timer(section, id));
+}
+
+coro::task<bool> WritebackScheduler::flush() {
+    // Waits for a running export, its sections may have to be retried
+    auto const lock = co_await m_export_mutex.lock();
+
+    co_return co_await export_batch(take(false));
+}
+
+WritebackScheduler::Stats WritebackScheduler::stats() {
+    std::lock_guard lock(m_pending_mutex);
+
+    auto stats = m_stats;
+    stats.pending_sections = m_pending.size();
+    for (auto const& [section, pending] : m_pending) {
+        stats.pending_commits += pending.commits.size();
+    }
+
+    return stats;
+}
+
+WritebackScheduler::Clock::time_point WritebackScheduler::deadline(Pending const& pending) const {
+    auto const debounced =
+        std::min(pending.commits.back() + m_quiet_period, pending.commits.front() + m_max_delay);
+
+    return std::max(debounced, pending.not_before);
+}
+
+coro::task<void> WritebackScheduler::run_timer(PackageSectionDTO section, uint64_t id) {
+    while (true) {
+        std::chrono::milliseconds wait {0};
+        {
+            std::lock_guard lock(m_pending_mutex);
+
+            // Exported by another timer or a flush, a later commit has its own timer
+            auto const it = m_pending.find(section);
+            if (it == m_pending.end() || it->second.id != id) {
+                co_return;
+            }
+
+            auto const now = Clock::now();
+            auto const due = deadline(it->second);
+            if (due <= now) {
+                break;
+            }
+
+            wait = std::chrono::ceil<std::chrono::milliseconds>(due - now);
+        }
+
+        co_await m_scheduler->schedule_after(wait);
+    }
+
+    auto const lock = co_await m_export_mutex.lock();
+
+    if (auto batch = take(true); !batch.empty()) {
+        co_await export_batch(std::move(batch));
+    }
+}
+
+WritebackScheduler::Batch WritebackScheduler::take(bool only_due) {
+    std::lock_guard lock(m_pending_mutex);
+
+    if (!only_due) {
+        return std::exchange(m_pending, {});
+    }
+
+    Batch batch;
+    auto const now = Clock::now();
+    for (auto it = m_pending.begin(); it != m_pending.end();) {
+        if (deadline(it->second) <= now) {
+            batch.insert(m_pending.extract(it++));
+        } else {
+            ++it;
+        }
+    }
+
+    return batch;
+}
+
+coro::task<bool> WritebackScheduler::export_batch(Batch batch) {
+    if (batch.empty()) {
+        co_return true;
+    }
+
+    std::set<PackageSectionDTO> sections;
+    std::ranges::transform(batch, std::inserter(sections, sections.end()),
+                           [](auto const& entry) { return entry.first; });
+
+    auto const exported = co_await m_exporter.export_to_disk(std::move(sections));
+
+    auto const now = Clock::now();
+
+    std::vector<std::pair<PackageSectionDTO, uint64_t>> retried;
+    {
+        std::lock_guard lock(m_pending_mutex);
+
+        if (exported) {
+            auto longest = std::chrono::milliseconds {0};
+            size_t count = 0;
+
+            for (auto const& [section, pending] : batch) {
+                for (auto const& commit : pending.commits) {
+                    auto const delay =
+                        std::chrono::duration_cast<std::chrono::milliseconds>(now - commit);
+
+                    longest = std::max(longest, delay);
+                    m_stats.total_delay += delay;
+                    ++count;
+                }
+            }
+
+            m_stats.published_commits += count;
+            m_stats.last_delay = longest;
+            m_stats.max_delay = std::max(m_stats.max_delay, longest);
+
+            logi("Writeback: {} commits of {} sections published, the oldest waited {} ms",
+                 count, batch.size(), longest.count());
+        } else {
+            // Put the commits back in front of the ones made meanwhile and retry later
+            for (auto& [section, pending] : batch) {
+                auto [it, inserted] = m_pending.try_emplace(section);
+                it->second.commits.insert(it->second.commits.begin(), pending.commits.begin(),
+                                          pending.commits.end());
+                it->second.not_before = now + m_max_delay;
+
+                if (inserted) {
+                    it->second.id = ++m_next_id;
+                    retried.emplace_back(section, it->second.id);
+                }
+            }
+
+            logw("Writeback: Export of {} sections failed, retrying in {} ms", batch.size(),
+                 m_max_delay.count());
+        }
+    }
+
+    for (auto const& [section, id] : retried) {
+        m_scheduler->schedule(run_timer(section, id));
+    }
+
+    co_return exported;
+}
+
+} // namespace bxt::Persistence::Box
@@ -7,54 +7,85 @@
 #pragma once
 
 #include "core/application/dtos/PackageSectionDTO.h"
-#include "utilities/log/Logging.h"
+#include "core/domain/repositories/WritebackSchedulerBase.h"
+#include "persistence/box/BoxOptions.h"
+#include "persistence/box/export/ExporterBase.h"
 
 #include <chrono>
 #include <coro/io_scheduler.hpp>
 #include <coro/mutex.hpp>
+#include <coro/task.hpp>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace bxt::Persistence::Box {
-class WritebackScheduler {
+
+// Debounces exports per section: a section is exported once no commit touched
+// it for the quiet period, but never later than the maximum delay after its
+// oldest unpublished commit. Sections that are due together share an export.
+class WritebackScheduler : public Core::Domain::WritebackSchedulerBase {
 public:
-    explicit WritebackScheduler(std::shared_ptr<coro::io_scheduler> scheduler)
-        : m_scheduler(std::move(scheduler)) {
-    }
+    using Clock = std::chrono::steady_clock;
 
-    coro::task<void> schedule(coro::task<void> task) {
-        auto const lock = co_await m_mutex.lock();
+    struct Stats {
+        // Sections waiting for their export and the commits they carry
+        size_t pending_sections = 0;
+        size_t pending_commits = 0;
 
-        if (m_scheduled) {
-            co_return;
-        }
+        // Time from a commit to the publication of its section
+        uint64_t published_commits = 0;
+        std::chrono::milliseconds last_delay {0};
+        std::chrono::milliseconds max_delay {0};
+        std::chrono::milliseconds total_delay {0};
+    };
 
-        this->m_scheduled = true;
+    WritebackScheduler(std::shared_ptr<coro::io_scheduler> scheduler,
+                       BoxOptions& options,
+                       ExporterBase& exporter);
 
-        auto scheduled_task = [](auto* self, coro::task<void> task) -> coro::task<void> {
-            using namespace std::chrono_literals;
+    // Records a commit that touched the section
+    void schedule(Core::Application::PackageSectionDTO const& section);
 
-            co_await self->m_scheduler->schedule_after(5s);
+    coro::task<bool> flush() override;
 
-            auto const lock = co_await self->m_mutex.lock();
+    Stats stats();
 
-            co_await task;
+private:
+    struct Pending {
+        // Tells the timer of this entry from timers of entries exported earlier
+        uint64_t id = 0;
+        std::vector<Clock::time_point> commits;
+        // Set after a failed export to not retry right away
+        Clock::time_point not_before;
+    };
 
-            self->m_scheduled = false;
+    using Batch = std::map<Core::Application::PackageSectionDTO, Pending>;
 
-            co_return;
-        }(this, std::move(task));
+    Clock::time_point deadline(Pending const& pending) const;
 
-        m_scheduler->schedule(std::move(scheduled_task));
+    // Waits for the section's deadline and exports everything that is due by then
+    coro::task<void> run_timer(Core::Application::PackageSectionDTO section, uint64_t id);
 
-        co_return;
-    }
+    // Takes the pending sections out, all of them or only those that are due
+    Batch take(bool only_due);
 
-    bool scheduled() {
-        return m_scheduled;
-    }
+    // Exports the batch, has to be called with the export mutex held
+    coro::task<bool> export_batch(Batch batch);
 
-private:
     std::shared_ptr<coro::io_scheduler> m_scheduler;
-    coro::mutex m_mutex;
-    std::atomic<bool> m_scheduled = false;
+    ExporterBase& m_exporter;
+    std::chrono::milliseconds m_quiet_period;
+    std::chrono::milliseconds m_max_delay;
+
+    std::mutex m_pending_mutex;
+    Batch m_pending;
+    uint64_t m_next_id = 0;
+    Stats m_stats;
+
+    // Exports run one at a time, a section is never exported twice at once
+    coro::mutex m_export_mutex;
 };
 } // namespace bxt::Persistence::Box
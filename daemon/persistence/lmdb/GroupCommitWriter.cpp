@@ -0,0 +1,182 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "GroupCommitWriter.h"
+
+#include "utilities/Error.h"
+#include "utilities/log/Logging.h"
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+
+namespace bxt::Persistence {
+
+using Core::Domain::UnitOfWorkBase;
+
+GroupCommitWriter::GroupCommitWriter(Utilities::LMDB::LMDBOptions& options,
+                                     Core::Domain::UnitOfWorkBaseFactory& uow_factory)
+    : m_uow_factory(uow_factory)
+    , m_delay(std::max<int64_t>(options.group_commit_delay, 0))
+    , m_batch_size(std::max<int64_t>(options.group_commit_size, 1)) {
+    m_scheduler->schedule(run());
+}
+
+GroupCommitWriter::~GroupCommitWriter() {
+    m_stopping = true;
+    m_wakeup.set();
+    m_scheduler->shutdown();
+}
+
+coro::task<UnitOfWorkBase::Result<void>> GroupCommitWriter::submit(Mutation mutation) {
+    auto request = std::make_shared<Request>();
+    request->mutation = std::move(mutation);
+
+    enqueue(request);
+
+    co_await request->done;
+
+    // The event resumes us on the writer thread, which has the next batch to run
+    co_await m_completion_pool->schedule();
+
+    co_return std::move(request->result);
+}
+
+void GroupCommitWriter::post(Mutation mutation, std::string const& name) {
+    auto request = std::make_shared<Request>();
+    request->mutation = std::move(mutation);
+    request->name = name;
+    request->detached = true;
+
+    enqueue(std::move(request));
+}
+
+void GroupCommitWriter::enqueue(std::shared_ptr<Request> request) {
+    {
+        std::lock_guard lock(m_queue_mutex);
+        m_queue.emplace_back(std::move(request));
+    }
+    m_wakeup.set();
+}
+
+coro::task<void> GroupCommitWriter::run() {
+    while (true) {
+        co_await m_wakeup;
+
+        // The event resumes us on the thread that queued the request
+        co_await m_scheduler->schedule();
+        m_wakeup.reset();
+
+        if (m_delay.count() > 0 && !m_stopping) {
+            bool full = false;
+            {
+                std::lock_guard lock(m_queue_mutex);
+                full = m_queue.size() >= m_batch_size;
+            }
+
+            // Give concurrent writers a moment to join the batch
+            if (!full) {
+                co_await m_scheduler->schedule_after(m_delay);
+            }
+        }
+
+        std::vector<std::shared_ptr<Request>> batch;
+        {
+            std::lock_guard lock(m_queue_mutex);
+            auto const count = std::min(m_queue.size(), m_batch_size);
+
+            batch.assign(std::make_move_iterator(m_queue.begin()),
+                         std::make_move_iterator(m_queue.begin() + count));
+            m_queue.erase(m_queue.begin(), m_queue.begin() + count);
+
+            // Leftovers make the next batch, which is already full or late
+            if (!m_queue.empty()) {
+                m_wakeup.set();
+            }
+        }
+
+        if (!batch.empty()) {
+            co_await commit(std::move(batch));
+        }
+
+        if (m_stopping) {
+            std::lock_guard lock(m_queue_mutex);
+            if (m_queue.empty()) {
+                co_return;
+            }
+        }
+    }
+}
+
+coro::task<void> GroupCommitWriter::commit(std::vector<std::shared_ptr<Request>> batch) {
+    std::vector<std::shared_ptr<Request>> finished;
+    finished.reserve(batch.size());
+
+    while (!batch.empty()) {
+        auto const failed = co_await try_commit(batch);
+        if (!failed) {
+            std::ranges::move(batch, std::back_inserter(finished));
+            break;
+        }
+
+        // Rerun the rest without the failed mutation
+        finished.emplace_back(std::move(batch[*failed]));
+        batch.erase(batch.begin() + *failed);
+    }
+
+    // Callers are resumed only once the write txn is released, they move on to
+    // the completion pool right away
+    for (auto const& request : finished) {
+        if (request->detached && !request->result.has_value()) {
+            logw("GroupCommit: \"{}\" was not written", request->name);
+        }
+        request->done.set();
+    }
+}
+
+coro::task<std::optional<size_t>>
+    GroupCommitWriter::try_commit(std::vector<std::shared_ptr<Request>>& batch) {
+    using Error = UnitOfWorkBase::Error;
+
+    auto uow = co_await m_uow_factory(true);
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        bool applied = false;
+        try {
+            applied = co_await batch[i]->mutation(uow);
+        } catch (std::exception const& error) {
+            loge("GroupCommit: Mutation failed, the error is \"{}\"", error.what());
+        }
+
+        if (!applied) {
+            co_await uow->rollback_async();
+
+            batch[i]->result = bxt::make_error<Error>(Error::ErrorType::OperationError);
+            co_return i;
+        }
+    }
+
+    UnitOfWorkBase::Result<void> committed;
+    try {
+        committed = co_await uow->commit_async();
+    } catch (std::exception const& error) {
+        loge("GroupCommit: Commit of {} writes failed, the error is \"{}\"", batch.size(),
+             error.what());
+        committed = bxt::make_error<Error>(Error::ErrorType::OperationError);
+    }
+
+    for (auto const& request : batch) {
+        request->result = committed;
+    }
+
+    if (committed.has_value()) {
+        logd("GroupCommit: {} writes committed in one txn", batch.size());
+    }
+
+    co_return std::nullopt;
+}
+
+} // namespace bxt::Persistence
@@ -0,0 +1,77 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "core/domain/repositories/GroupCommitWriterBase.h"
+#include "core/domain/repositories/UnitOfWorkBase.h"
+#include "utilities/lmdb/LMDBOptions.h"
+
+#include <atomic>
+#include <chrono>
+#include <coro/event.hpp>
+#include <coro/io_scheduler.hpp>
+#include <coro/task.hpp>
+#include <coro/thread_pool.hpp>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace bxt::Persistence {
+
+// A single writer coroutine on its own thread takes queued mutations and
+// applies them in one write txn per batch. A batch is closed after the
+// configured delay or once it's full, whatever comes first.
+class GroupCommitWriter : public Core::Domain::GroupCommitWriterBase {
+public:
+    GroupCommitWriter(Utilities::LMDB::LMDBOptions& options,
+                      Core::Domain::UnitOfWorkBaseFactory& uow_factory);
+
+    ~GroupCommitWriter() override;
+
+    coro::task<Core::Domain::UnitOfWorkBase::Result<void>> submit(Mutation mutation) override;
+
+    void post(Mutation mutation, std::string const& name) override;
+
+private:
+    struct Request {
+        Mutation mutation;
+        std::string name;
+        bool detached = false;
+        Core::Domain::UnitOfWorkBase::Result<void> result;
+        coro::event done;
+    };
+
+    void enqueue(std::shared_ptr<Request> request);
+
+    coro::task<void> run();
+
+    coro::task<void> commit(std::vector<std::shared_ptr<Request>> batch);
+
+    // Applies the batch in one txn. Returns the position of the mutation that
+    // failed, in which case the txn is rolled back and nothing is committed.
+    coro::task<std::optional<size_t>> try_commit(std::vector<std::shared_ptr<Request>>& batch);
+
+    Core::Domain::UnitOfWorkBaseFactory& m_uow_factory;
+    std::chrono::milliseconds m_delay;
+    size_t m_batch_size;
+
+    std::mutex m_queue_mutex;
+    std::deque<std::shared_ptr<Request>> m_queue;
+    coro::event m_wakeup;
+    std::atomic<bool> m_stopping = false;
+
+    // Callers continue here once their batch is done, the writer thread only
+    // hands them over. It outlives the writer's scheduler.
+    std::unique_ptr<coro::thread_pool> m_completion_pool = std::make_unique<coro::thread_pool>();
+
+    std::shared_ptr<coro::io_scheduler> m_scheduler =
+        coro::io_scheduler::make_shared({.pool = {.thread_count = 1}});
+};
+
+} // namespace bxt::Persistence
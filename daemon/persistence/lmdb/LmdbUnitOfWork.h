@@ -9,10 +9,16 @@
 #include "core/domain/repositories/UnitOfWorkBase.h"
 #include "utilities/lmdb/Environment.h"
 #include "utilities/locked.h"
+#include "utilities/log/Logging.h"
 
 #include <coro/task.hpp>
 #include <cstddef>
+#include <map>
 #include <memory>
+#include <ranges>
+#include <utility>
+#include <variant>
+#include <vector>
 namespace bxt::Persistence {
 
 class LmdbUnitOfWork : public Core::Domain::UnitOfWorkBase {
@@ -21,40 +27,111 @@ public:
         : m_env(std::move(env)) {
     }
 
-    virtual ~LmdbUnitOfWork() = default;
+    virtual ~LmdbUnitOfWork() {
+        if (m_txn && m_read_only) {
+            m_env->release_ro_txn(std::move(m_txn->value));
+        }
+    }
 
     coro::task<Result<void>> commit_async() override {
-        for (auto const& [name, hook] : m_hooks) {
-            hook();
+        std::vector<std::function<void()>> undos;
+        auto const undo_all = [&undos] {
+            for (auto const& undo : undos | std::views::reverse) {
+                undo();
+            }
+        };
+
+        for (auto& [name, hook] : m_hooks) {
+            auto hooked = hook.run();
+            if (hooked.has_value()) {
+                if (hook.undo) {
+                    undos.emplace_back(std::move(hook.undo));
+                }
+                continue;
+            }
+
+            undo_all();
+
+            // Drops the remaining hooks with the txn
+            co_await rollback_async();
+            co_return std::unexpected(std::move(hooked.error()));
         }
         m_hooks.clear();
 
-        m_txn->value.commit();
+        if (m_read_only) {
+            m_env->release_ro_txn(std::move(m_txn->value));
+        } else {
+            try {
+                m_env->commit(m_txn->value);
+            } catch (lmdb::error const& error) {
+                loge("LMDB: Commit failed, the error is \"{}\"", error.what());
+
+                undo_all();
+                m_post_commit_hooks = {};
+                co_return bxt::make_error<Error>(Error::ErrorType::OperationError);
+            }
+        }
+
+        for (auto const& [name, hook] : std::exchange(m_post_commit_hooks, {})) {
+            hook();
+        }
         co_return {};
     }
 
     coro::task<Result<void>> rollback_async() override {
         m_hooks = {};
+        m_post_commit_hooks = {};
 
-        m_txn->value.abort();
+        if (m_read_only) {
+            m_env->release_ro_txn(std::move(m_txn->value));
+        } else {
+            m_txn->value.abort();
+        }
         co_return {};
     }
 
     coro::task<Result<void>> begin_async() override {
         m_txn = co_await m_env->begin_rw_txn();
+        m_read_only = false;
         co_return {};
     }
 
     coro::task<Result<void>> begin_ro_async() override {
         m_txn = co_await m_env->begin_ro_txn();
+        m_read_only = true;
         co_return {};
     }
 
+    bool read_only() const {
+        return m_read_only;
+    }
+
     void hook(std::function<void()>&& hook, std::string const& name = "") override {
+        checked_hook(
+            [hook = std::move(hook)]() -> Result<void> {
+                hook();
+                return {};
+            },
+            name);
+    }
+
+    void checked_hook(std::function<Result<void>()>&& hook,
+                      std::string const& name = "",
+                      std::function<void()>&& undo = {}) override {
+        CheckedHook checked {.run = std::move(hook), .undo = std::move(undo)};
+
+        if (name.empty()) {
+            m_hooks[m_hooks.size()] = std::move(checked);
+        } else {
+            m_hooks[name] = std::move(checked);
+        }
+    }
+
+    void post_commit_hook(std::function<void()>&& hook, std::string const& name = "") override {
         if (name.empty()) {
-            m_hooks[m_hooks.size()] = std::move(hook);
+            m_post_commit_hooks[m_post_commit_hooks.size()] = std::move(hook);
         } else {
-            m_hooks[name] = std::move(hook);
+            m_post_commit_hooks[name] = std::move(hook);
         }
     }
 
@@ -65,9 +142,16 @@ public:
 private:
     using HookKeyType = std::variant<size_t, std::string>;
 
-    std::map<HookKeyType, std::function<void()>> m_hooks;
+    struct CheckedHook {
+        std::function<Result<void>()> run;
+        std::function<void()> undo;
+    };
+
+    std::map<HookKeyType, CheckedHook> m_hooks;
+    std::map<HookKeyType, std::function<void()>> m_post_commit_hooks;
     std::shared_ptr<Utilities::LMDB::Environment> m_env;
     std::unique_ptr<Utilities::locked<lmdb::txn>> m_txn;
+    bool m_read_only = false;
 };
 
 struct LmdbUnitOfWorkFactory : public Core::Domain::UnitOfWorkBaseFactory {
@@ -10,6 +10,7 @@
 #include "core/application/RequestContext.h"
 #include "core/application/services/DeploymentService.h"
 #include "drogon/HttpTypes.h"
+#include "utilities/drogon/Upload.h"
 
 namespace bxt::Presentation {
 using namespace drogon;
@@ -117,10 +118,24 @@ drogon::Task<drogon::HttpResponsePtr>
     auto const section = PackageSectionDTO {
         .branch = branch->second, .repository = repo->second, .architecture = arch->second};
 
-    file->second.save();
-    signature->second.save();
+    auto const signature_path = drogon_helpers::save_upload(signature->second);
+    if (!signature_path.has_value()) {
+        result->setBody(signature_path.error());
+        result->setStatusCode(drogon::k400BadRequest);
+        co_return result;
+    }
+
+    drogon_helpers::StagedUploads staged_uploads;
+    staged_uploads.add(*signature_path);
 
-    auto const name = file->second.getFileName();
+    auto const staged = co_await drogon_helpers::stage_package(
+        m_package_cache, file->second, std::string(signature->second.fileContent()));
+    if (!staged.has_value()) {
+        result->setBody(staged.error());
+        result->setStatusCode(drogon::k400BadRequest);
+        co_return result;
+    }
+    staged_uploads.add(*staged);
 
     auto dto = PackageDTO {section,
                            "",
@@ -128,8 +143,8 @@ drogon::Task<drogon::HttpResponsePtr>
                            {{Core::Domain::PoolLocation::Automated,
                              {
                                  "",
-                                 app().getUploadPath() + "/" + name,
-                                 app().getUploadPath() + "/" + signature->second.getFileName(),
+                                 *staged,
+                                 *signature_path,
                              }}}
 
     };
@@ -146,6 +161,9 @@ drogon::Task<drogon::HttpResponsePtr>
         co_return result;
     }
 
+    // Committed by deploy_end
+    staged_uploads.release();
+
     result->setStatusCode(drogon::k200OK);
     result->setBody("ok");
 
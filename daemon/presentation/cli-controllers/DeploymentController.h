@@ -11,6 +11,7 @@
 #include "drogon/utils/coroutine.h"
 #include "drogon/utils/FunctionTraits.h"
 #include "presentation/cli-controllers/DeploymentOptions.h"
+#include "utilities/alpmdb/ParsedPackageCache.h"
 #include "utilities/drogon/Macro.h"
 
 #include <drogon/drogon.h>
@@ -21,9 +22,12 @@ namespace bxt::Presentation {
 
 class DeploymentController : public drogon::HttpController<DeploymentController, false> {
 public:
-    DeploymentController(DeploymentOptions& options, Core::Application::DeploymentService& service)
+    DeploymentController(DeploymentOptions& options,
+                         Core::Application::DeploymentService& service,
+                         Utilities::AlpmDb::ParsedPackageCache& package_cache)
         : m_options(options)
-        , m_service(service) {};
+        , m_service(service)
+        , m_package_cache(package_cache) {};
 
     METHOD_LIST_BEGIN
 
@@ -40,6 +44,7 @@ public:
 private:
     DeploymentOptions& m_options;
     Core::Application::DeploymentService& m_service;
+    Utilities::AlpmDb::ParsedPackageCache& m_package_cache;
 };
 
 } // namespace bxt::Presentation
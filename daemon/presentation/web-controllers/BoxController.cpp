@@ -0,0 +1,339 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "BoxController.h"
+
+#include "core/application/dtos/PackageSectionDTO.h"
+#include "utilities/drogon/Helpers.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <drogon/HttpResponse.h>
+#include <drogon/utils/Utilities.h>
+#include <fmt/format.h>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <sys/stat.h>
+#include <system_error>
+#include <trantor/net/EventLoop.h>
+#include <trantor/utils/Date.h>
+
+namespace bxt::Presentation {
+
+namespace {
+
+    // Rejects empty, hidden and traversing path segments. Hidden files are the
+    // exporter's temporary archives and digests.
+    bool is_safe_segment(std::string_view segment) {
+        return !segment.empty() && !segment.starts_with('.')
+               && segment.find('/') == std::string_view::npos;
+    }
+
+    bool is_database(std::string_view repository, std::string_view file_name) {
+        return std::ranges::any_of(
+            std::initializer_list<std::string_view> {".db", ".db.tar.zst", ".files",
+                                                     ".files.tar.zst"},
+            [&](auto extension) {
+                return file_name.size() == repository.size() + extension.size()
+                       && file_name.starts_with(repository) && file_name.ends_with(extension);
+            });
+    }
+
+    std::string_view trim(std::string_view value) {
+        auto const first = value.find_first_not_of(' ');
+        if (first == std::string_view::npos) {
+            return {};
+        }
+        return value.substr(first, value.find_last_not_of(' ') - first + 1);
+    }
+
+    // If-None-Match uses the weak comparison, "W/" prefixes are ignored
+    bool matches_etag(std::string_view header, std::string_view etag) {
+        while (!header.empty()) {
+            auto const separator = header.find(',');
+            auto candidate = trim(header.substr(0, separator));
+
+            if (candidate.starts_with("W/")) {
+                candidate.remove_prefix(2);
+            }
+
+            if (candidate == "*" || candidate == etag) {
+                return true;
+            }
+
+            if (separator == std::string_view::npos) {
+                break;
+            }
+            header.remove_prefix(separator + 1);
+        }
+
+        return false;
+    }
+
+    std::optional<size_t> parse_position(std::string_view value) {
+        size_t position = 0;
+
+        auto const [end, ec] = std::from_chars(value.data(), value.data() + value.size(), position);
+        if (ec != std::errc() || end != value.data() + value.size()) {
+            return std::nullopt;
+        }
+
+        return position;
+    }
+
+    struct ByteRange {
+        enum class Kind { Whole, Partial, Unsatisfiable };
+
+        Kind kind = Kind::Whole;
+        size_t offset = 0;
+        size_t length = 0;
+    };
+
+    // Supports a single range. Multiple ranges and malformed headers are answered
+    // with the whole file, which RFC 9110 allows.
+    ByteRange parse_range(std::string_view header, size_t size) {
+        constexpr std::string_view unit = "bytes=";
+
+        if (!header.starts_with(unit) || header.find(',') != std::string_view::npos) {
+            return {};
+        }
+        header.remove_prefix(unit.size());
+
+        auto const dash = header.find('-');
+        if (dash == std::string_view::npos) {
+            return {};
+        }
+
+        auto const first = trim(header.substr(0, dash));
+        auto const last = trim(header.substr(dash + 1));
+
+        // "bytes=-n" asks for the last n bytes
+        if (first.empty()) {
+            auto const suffix = parse_position(last);
+            if (!suffix) {
+                return {};
+            }
+            if (*suffix == 0 || size == 0) {
+                return {.kind = ByteRange::Kind::Unsatisfiable};
+            }
+
+            auto const length = std::min(*suffix, size);
+            return {.kind = ByteRange::Kind::Partial, .offset = size - length, .length = length};
+        }
+
+        auto const start = parse_position(first);
+        auto const end = last.empty() ? std::optional(size - 1) : parse_position(last);
+        if (!start || !end || *end < *start) {
+            return {};
+        }
+
+        if (*start >= size) {
+            return {.kind = ByteRange::Kind::Unsatisfiable};
+        }
+
+        return {.kind = ByteRange::Kind::Partial,
+                .offset = *start,
+                .length = std::min(*end, size - 1) - *start + 1};
+    }
+
+    drogon::HttpResponsePtr make_range_not_satisfiable(size_t size) {
+        auto response = drogon::HttpResponse::newHttpResponse();
+        response->setStatusCode(drogon::k416RequestedRangeNotSatisfiable);
+        response->addHeader("Content-Range", fmt::format("bytes */{}", size));
+
+        return response;
+    }
+
+} // namespace
+
+BoxController::BoxController(Persistence::Box::BoxOptions& options,
+                             Persistence::Box::ExporterBase& exporter)
+    : m_box_path(options.box_path)
+    , m_exporter(exporter)
+    , m_run_tag(std::chrono::system_clock::now().time_since_epoch().count())
+    , m_cache_budget(std::max<int64_t>(options.serve_cache_budget, 0) * 1024 * 1024) {
+}
+
+drogon::Task<drogon::HttpResponsePtr> BoxController::get_file(drogon::HttpRequestPtr req,
+                                                              std::string branch,
+                                                              std::string repository,
+                                                              std::string architecture,
+                                                              std::string file_name) {
+    if (!std::ranges::all_of(std::initializer_list<std::string_view> {branch, repository,
+                                                                       architecture, file_name},
+                             is_safe_segment)) {
+        co_return drogon_helpers::make_error_response("File not found", drogon::k404NotFound);
+    }
+
+    auto const database = is_database(repository, file_name);
+
+    // Taken before the file is read, a database published meanwhile gets a newer one
+    auto const generation =
+        database ? m_exporter.generation(Core::Application::PackageSectionDTO {
+                       .branch = branch, .repository = repository, .architecture = architecture})
+                 : 0;
+
+    auto const path = m_box_path / branch / repository / architecture / file_name;
+
+    struct stat status {};
+    if (::stat(path.c_str(), &status) != 0 || !S_ISREG(status.st_mode)) {
+        co_return drogon_helpers::make_error_response("File not found", drogon::k404NotFound);
+    }
+
+    auto const modified = status.st_mtim.tv_sec;
+
+    // Package files never change under their name, databases are versioned by the exporter
+    auto const etag =
+        database ? fmt::format("\"{:x}-{:x}\"", m_run_tag, generation)
+                 : fmt::format("\"{:x}-{:x}-{:x}\"", status.st_ino, modified, status.st_size);
+
+    auto const with_headers = [&](drogon::HttpResponsePtr response) {
+        response->addHeader("ETag", etag);
+        response->addHeader("Last-Modified",
+                            drogon::utils::getHttpFullDate(trantor::Date(modified * 1'000'000)));
+        response->addHeader("Accept-Ranges", "bytes");
+        if (database) {
+            response->addHeader("Cache-Control", "no-cache");
+        }
+        return response;
+    };
+
+    auto const& if_none_match = req->getHeader("if-none-match");
+    auto const& if_modified_since = req->getHeader("if-modified-since");
+
+    bool not_modified = false;
+    if (!if_none_match.empty()) {
+        not_modified = matches_etag(if_none_match, etag);
+    } else if (!if_modified_since.empty()) {
+        auto const since = drogon::utils::getHttpDate(if_modified_since);
+        not_modified = since.microSecondsSinceEpoch() != std::numeric_limits<int64_t>::max()
+                       && since.secondsSinceEpoch() >= modified;
+    }
+
+    if (not_modified) {
+        auto response = drogon::HttpResponse::newHttpResponse();
+        response->setStatusCode(drogon::k304NotModified);
+        co_return with_headers(response);
+    }
+
+    // A range of an outdated copy would be spliced into the wrong file
+    auto const& if_range = req->getHeader("if-range");
+    auto const& range_header = if_range.empty() || if_range == etag ? req->getHeader("range")
+                                                                     : std::string();
+
+    if (database) {
+        auto* const loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+        auto content = co_await cached_database(path, generation, modified);
+        if (loop != nullptr && !loop->isInLoopThread()) {
+            co_await drogon::switchThreadCoro(loop);
+        }
+
+        if (content) {
+            auto const range = parse_range(range_header, content->size());
+
+            if (range.kind == ByteRange::Kind::Unsatisfiable) {
+                co_return make_range_not_satisfiable(content->size());
+            }
+
+            auto response = drogon::HttpResponse::newHttpResponse();
+            response->setContentTypeCode(drogon::CT_APPLICATION_OCTET_STREAM);
+
+            if (range.kind == ByteRange::Kind::Partial) {
+                response->setStatusCode(drogon::k206PartialContent);
+                response->addHeader("Content-Range",
+                                    fmt::format("bytes {}-{}/{}", range.offset,
+                                                range.offset + range.length - 1,
+                                                content->size()));
+                response->setBody(content->substr(range.offset, range.length));
+            } else {
+                response->setBody(*content);
+            }
+
+            co_return with_headers(response);
+        }
+    }
+
+    auto const size = static_cast<size_t>(status.st_size);
+    auto const range = parse_range(range_header, size);
+
+    if (range.kind == ByteRange::Kind::Unsatisfiable) {
+        co_return make_range_not_satisfiable(size);
+    }
+
+    // drogon sends file responses with sendfile
+    auto response = range.kind == ByteRange::Kind::Partial
+                        ? drogon::HttpResponse::newFileResponse(
+                              path.string(), range.offset, range.length, true, "",
+                              drogon::CT_APPLICATION_OCTET_STREAM)
+                        : drogon::HttpResponse::newFileResponse(
+                              path.string(), "", drogon::CT_APPLICATION_OCTET_STREAM);
+
+    co_return with_headers(response);
+}
+
+coro::task<std::shared_ptr<std::string const>> BoxController::cached_database(
+    std::filesystem::path path, uint64_t generation, std::time_t modified) {
+    if (m_cache_budget == 0) {
+        co_return nullptr;
+    }
+
+    // <repo>.db and <repo>.db.tar.zst share the entry
+    std::error_code ec;
+    auto const key = std::filesystem::canonical(path, ec).string();
+    if (ec) {
+        co_return nullptr;
+    }
+
+    {
+        std::lock_guard lock(m_cache_mutex);
+
+        auto const it = m_cache.find(key);
+        if (it != m_cache.end() && it->second.generation == generation
+            && it->second.modified == modified) {
+            co_return it->second.content;
+        }
+    }
+
+    co_await m_read_pool->schedule();
+
+    std::ifstream stream(key, std::ios::binary);
+    if (!stream) {
+        co_return nullptr;
+    }
+
+    auto content = std::make_shared<std::string const>(std::istreambuf_iterator<char>(stream),
+                                                       std::istreambuf_iterator<char>());
+
+    if (stream.bad() || content->size() > m_cache_budget) {
+        co_return nullptr;
+    }
+
+    std::lock_guard lock(m_cache_mutex);
+
+    if (auto const it = m_cache.find(key); it != m_cache.end()) {
+        m_cache_size -= it->second.content->size();
+        m_cache.erase(it);
+    }
+
+    // Databases are few and replaced rarely, any of them can make room
+    while (m_cache_size + content->size() > m_cache_budget && !m_cache.empty()) {
+        m_cache_size -= m_cache.begin()->second.content->size();
+        m_cache.erase(m_cache.begin());
+    }
+
+    m_cache_size += content->size();
+    m_cache.insert_or_assign(key, CachedDatabase {.generation = generation,
+                                                  .modified = modified,
+                                                  .content = content});
+
+    co_return content;
+}
+
+} // namespace bxt::Presentation
@@ -0,0 +1,75 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include "drogon/HttpController.h"
+#include "drogon/utils/coroutine.h"
+#include "parallel_hashmap/phmap.h"
+#include "persistence/box/BoxOptions.h"
+#include "persistence/box/export/ExporterBase.h"
+
+#include <coro/task.hpp>
+#include <coro/thread_pool.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace bxt::Presentation {
+
+// Read-only mirror of the box directory, so the repositories can be used
+// without a separate web server. Package files are sent with sendfile, the
+// databases are answered from memory until the exporter replaces them.
+class BoxController : public drogon::HttpController<BoxController, false> {
+public:
+    BoxController(Persistence::Box::BoxOptions& options, Persistence::Box::ExporterBase& exporter);
+
+    METHOD_LIST_BEGIN
+
+    ADD_METHOD_TO(BoxController::get_file, "/box/{1}/{2}/{3}/{4}", drogon::Get, drogon::Head);
+
+    METHOD_LIST_END
+
+    drogon::Task<drogon::HttpResponsePtr> get_file(drogon::HttpRequestPtr req,
+                                                   std::string branch,
+                                                   std::string repository,
+                                                   std::string architecture,
+                                                   std::string file_name);
+
+private:
+    struct CachedDatabase {
+        uint64_t generation = 0;
+        std::time_t modified = 0;
+        std::shared_ptr<std::string const> content;
+    };
+
+    // Returns the database from memory, reading it if it was published again.
+    // A read runs on the read pool and the caller resumes there.
+    coro::task<std::shared_ptr<std::string const>>
+        cached_database(std::filesystem::path path, uint64_t generation, std::time_t modified);
+
+    std::filesystem::path m_box_path;
+    Persistence::Box::ExporterBase& m_exporter;
+
+    // Generations start over with every run, the tag of the run keeps ETags unique
+    uint64_t m_run_tag;
+
+    std::mutex m_cache_mutex;
+    phmap::flat_hash_map<std::string, CachedDatabase> m_cache;
+    size_t m_cache_size = 0;
+    size_t m_cache_budget;
+
+    // Keeps file reads off the drogon event loops
+    std::unique_ptr<coro::thread_pool> m_read_pool =
+        std::make_unique<coro::thread_pool>(coro::thread_pool::options {.thread_count = 2});
+};
+
+} // namespace bxt::Presentation
@@ -14,6 +14,7 @@
 #include "presentation/Names.h"
 #include "utilities/drogon/Helpers.h"
 #include "utilities/drogon/Macro.h"
+#include "utilities/drogon/Upload.h"
 #include "utilities/log/Logging.h"
 #include "utilities/to_string.h"
 
@@ -59,6 +60,11 @@ drogon::Task<drogon::HttpResponsePtr>
     }
 
     std::map<int, PackageDTO> packages;
+    drogon_helpers::StagedUploads staged_uploads;
+
+    // Packages are staged once all signatures are known, they're part of the description
+    std::map<int, std::string> signatures;
+    std::vector<std::pair<int, HttpFile const*>> package_files;
 
     for (auto const& [name, file] : files_map) {
         if (!name.starts_with("package")) {
@@ -78,20 +84,36 @@ drogon::Task<drogon::HttpResponsePtr>
             packages.emplace(file_number, PackageDTO {});
         }
 
-        file.save();
-
         auto location = Core::Domain::PoolLocation::Overlay;
 
         PackagePoolEntryDTO& pool_entry = packages[file_number].pool_entries[location];
 
         if (parts.size() == 1 || parts[1] != "signature") {
-            pool_entry.filepath = app().getUploadPath() + "/" + file.getFileName();
+            package_files.emplace_back(file_number, &file);
 
         } else if (parts[1] == "signature") {
-            pool_entry.signature_path = app().getUploadPath() + "/" + file.getFileName();
+            auto const saved = drogon_helpers::save_upload(file);
+            if (!saved.has_value()) {
+                co_return drogon_helpers::make_error_response(saved.error());
+            }
+
+            staged_uploads.add(*saved);
+            pool_entry.signature_path = *saved;
+            signatures.insert_or_assign(file_number, std::string(file.fileContent()));
         }
     }
 
+    for (auto const& [file_number, file] : package_files) {
+        auto const staged = co_await drogon_helpers::stage_package(m_package_cache, *file,
+                                                                   signatures[file_number]);
+        if (!staged.has_value()) {
+            co_return drogon_helpers::make_error_response(staged.error());
+        }
+
+        staged_uploads.add(*staged);
+        packages[file_number].pool_entries[Core::Domain::PoolLocation::Overlay].filepath = *staged;
+    }
+
     for (auto const& [name, param] : params_map) {
         if (!name.starts_with("package")) {
             continue;
@@ -219,6 +241,8 @@ drogon::Task<drogon::HttpResponsePtr>
     if (!result.has_value()) {
         co_return drogon_helpers::make_error_response(result.error().what());
     }
+
+    staged_uploads.release();
     co_return drogon_helpers::make_ok_response();
 }
 
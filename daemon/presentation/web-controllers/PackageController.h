@@ -12,6 +12,7 @@
 #include "core/application/services/SyncService.h"
 #include "drogon/utils/coroutine.h"
 #include "drogon/utils/FunctionTraits.h"
+#include "utilities/alpmdb/ParsedPackageCache.h"
 #include "utilities/drogon/Macro.h"
 
 #include <drogon/drogon.h>
@@ -24,10 +25,12 @@ class PackageController : public drogon::HttpController<PackageController, false
 public:
     PackageController(Core::Application::PackageService& package_service,
                       Core::Application::SyncService& sync_service,
-                      Core::Application::PermissionService& permission_service)
+                      Core::Application::PermissionService& permission_service,
+                      Utilities::AlpmDb::ParsedPackageCache& package_cache)
         : m_package_service(package_service)
         , m_sync_service(sync_service)
-        , m_permission_service(permission_service) {};
+        , m_permission_service(permission_service)
+        , m_package_cache(package_cache) {};
 
     METHOD_LIST_BEGIN
 
@@ -66,6 +69,7 @@ private:
     Core::Application::PackageService& m_package_service;
     Core::Application::SyncService& m_sync_service;
     Core::Application::PermissionService& m_permission_service;
+    Utilities::AlpmDb::ParsedPackageCache& m_package_cache;
 };
 
 } // namespace bxt::Presentation
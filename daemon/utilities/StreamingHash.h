@@ -0,0 +1,61 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <openssl/evp.h>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace bxt {
+
+// Incremental digest over data that arrives in pieces, hex encoded like hash_from_file
+class StreamingHash {
+public:
+    explicit StreamingHash(EVP_MD const* algorithm = EVP_sha256())
+        : m_context(EVP_MD_CTX_new(), &EVP_MD_CTX_free) {
+        EVP_DigestInit_ex(m_context.get(), algorithm, nullptr);
+    }
+
+    StreamingHash& update(std::span<uint8_t const> data) {
+        EVP_DigestUpdate(m_context.get(), data.data(), data.size());
+        return *this;
+    }
+
+    StreamingHash& update(std::string_view data) {
+        EVP_DigestUpdate(m_context.get(), data.data(), data.size());
+        return *this;
+    }
+
+    // Finishes the digest, the object can't be updated after that
+    std::string hex_digest() {
+        std::array<unsigned char, EVP_MAX_MD_SIZE> digest {};
+        unsigned int length = 0;
+
+        EVP_DigestFinal_ex(m_context.get(), digest.data(), &length);
+
+        constexpr std::string_view digits = "0123456789abcdef";
+
+        std::string result;
+        result.reserve(length * 2);
+        for (unsigned int i = 0; i < length; ++i) {
+            result += digits[digest[i] >> 4];
+            result += digits[digest[i] & 0x0f];
+        }
+
+        return result;
+    }
+
+private:
+    std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> m_context;
+};
+
+} // namespace bxt
@@ -84,9 +84,9 @@ coro::task<Result<void>> save(phmap::parallel_flat_hash_map<std::string, Desc> d
     for (auto const& [name, description] : descriptions) {
         logd("Description for {} is being added...", name);
 
-        write_buffer_to_archive(db_writer, fmt::format("{}/desc", name), description.desc);
+        write_buffer_to_archive(db_writer, fmt::format("{}/desc", name), description.desc());
 
-        write_buffer_to_archive(files_writer, fmt::format("{}/files", name), description.files);
+        write_buffer_to_archive(files_writer, fmt::format("{}/files", name), description.files());
     }
 
     create_symlinks(path);
@@ -28,6 +28,7 @@
 #include <memory>
 #include <parallel_hashmap/phmap.h>
 #include <set>
+#include <span>
 #include <string>
 #include <string_view>
 #include <unordered_map>
@@ -62,7 +63,7 @@ Result<void> write_buffer_to_archive(Archive::Writer& writer,
                                                           DatabaseError::ErrorType::IOError);
     }
 
-    auto write_ok = entry->write({buffer.begin(), buffer.end()});
+    auto write_ok = entry->write(std::as_bytes(std::span(buffer)));
 
     if (!write_ok.has_value()) {
         return bxt::make_error_with_source<DatabaseError>(std::move(write_ok.error()),
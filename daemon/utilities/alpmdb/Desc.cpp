@@ -10,6 +10,7 @@
 #include "utilities/alpmdb/PkgInfo.h"
 #include "utilities/libarchive/Error.h"
 #include "utilities/libarchive/Reader.h"
+#include "utilities/StreamingHash.h"
 
 #include <boost/algorithm/string/join.hpp>
 #include <boost/iostreams/device/mapped_file.hpp>
@@ -21,90 +22,194 @@
 #include <optional>
 
 namespace bxt::Utilities::AlpmDb {
-std::optional<std::string> Desc::get(std::string const& key) const {
-    auto prepared_key = fmt::format("%{}%\n", key);
-    auto value_begin = desc.find(prepared_key);
+namespace {
 
-    if (value_begin == std::string::npos) {
-        return {};
+    // Finds the value lines that follow the key line at the offset, up to the
+    // blank line closing the field
+    std::string_view value_block(std::string_view desc, size_t offset) {
+        if (offset >= desc.size() || desc[offset] == '\n') {
+            return {};
+        }
+
+        auto const end = desc.find("\n\n", offset);
+        if (end == std::string_view::npos) {
+            auto const value = desc.substr(offset);
+            return value.ends_with('\n') ? value.substr(0, value.size() - 1) : value;
+        }
+
+        return desc.substr(offset, end - offset);
+    }
+
+} // namespace
+
+void Desc::index() {
+    m_fields.clear();
+
+    std::string_view const view = m_desc;
+
+    size_t position = 0;
+    while (position < view.size()) {
+        auto const line_end = view.find('\n', position);
+        if (line_end == std::string_view::npos) {
+            break;
+        }
+
+        auto const line = view.substr(position, line_end - position);
+        auto const line_offset = position;
+        position = line_end + 1;
+
+        if (line.size() < 2 || !line.starts_with('%') || !line.ends_with('%')) {
+            continue;
+        }
+
+        auto const value = value_block(view, position);
+
+        m_fields.emplace_back(Field {.key_offset = static_cast<uint32_t>(line_offset + 1),
+                                     .key_size = static_cast<uint32_t>(line.size() - 2),
+                                     .value_offset = static_cast<uint32_t>(position),
+                                     .value_size = static_cast<uint32_t>(value.size())});
+
+        position += value.size();
+    }
+}
+
+std::optional<std::string_view> Desc::block(std::string_view key) const {
+    std::string_view const view = m_desc;
+
+    for (auto const& field : m_fields) {
+        if (view.substr(field.key_offset, field.key_size) == key) {
+            return view.substr(field.value_offset, field.value_size);
+        }
     }
 
-    value_begin += prepared_key.size();
-    auto value_end = desc.find("\n", value_begin);
+    return {};
+}
 
-    if (value_end == std::string::npos) {
+std::optional<std::string_view> Desc::get(std::string_view key) const {
+    auto const value = block(key);
+    if (!value.has_value()) {
         return {};
     }
 
-    return desc.substr(value_begin, value_end - value_begin);
+    return value->substr(0, value->find('\n'));
 }
 
-Desc::Result<Desc> Desc::parse_package(std::filesystem::path const& filepath,
-                                       std::string const& signature,
-                                       bool create_files) {
-    std::ostringstream desc;
-    std::ostringstream files;
+namespace {
 
-    Archive::Reader file_reader;
+    // Reads the package through the reader the opener opens. The checksums are
+    // computed from the compressed blocks libarchive reads, so the package is read
+    // once for the description and the checksums.
+    template<typename TOpener>
+    Desc::Result<Desc> read_package(TOpener&& open,
+                                    std::filesystem::path const& filepath,
+                                    std::string const& signature,
+                                    bool create_files) {
+        using ParseError = Desc::ParseError;
 
-    archive_read_support_filter_all(file_reader);
-    archive_read_support_format_all(file_reader);
+        std::ostringstream files;
 
-    auto const package_infos = file_reader.open_filename(filepath);
+        Archive::Reader file_reader;
 
-    if (!package_infos.has_value()) {
-        return std::unexpected(
-            ParseError(ParseError::ErrorType::InvalidArchive, std::move(package_infos.error())));
-    }
+        archive_read_support_filter_all(file_reader);
+        archive_read_support_format_all(file_reader);
 
-    PkgInfo package_info;
+        StreamingHash md5(EVP_md5());
+        StreamingHash sha256(EVP_sha256());
 
-    bool found = false;
-    for (auto& [header, entry] : file_reader) {
-        if (!header) {
-            continue;
+        auto const package_infos =
+            open(file_reader, [&md5, &sha256](std::span<uint8_t const> block) {
+                md5.update(block);
+                sha256.update(block);
+            });
+
+        if (!package_infos.has_value()) {
+            return std::unexpected(ParseError(ParseError::ErrorType::InvalidArchive,
+                                              std::move(package_infos.error())));
         }
-        std::string pathname = archive_entry_pathname(*header);
 
-        if (!pathname.ends_with(".PKGINFO") && !pathname.starts_with("/.")) {
-            if (create_files) {
-                files << archive_entry_pathname(*header) << "\n";
+        PkgInfo package_info;
+
+        bool found = false;
+        for (auto& [header, entry] : file_reader) {
+            if (!header) {
+                continue;
             }
-            continue;
-        }
-        found = true;
-
-        auto contents = entry.read_all();
-
-        if (!contents.has_value()) {
-            if (auto const invalidentry =
-                    std::get_if<Archive::InvalidEntryError>(&contents.error())) {
-                return std::unexpected(
-                    ParseError(ParseError::ErrorType::InvalidArchive, std::move(*invalidentry)));
-            } else {
-                return std::unexpected(ParseError(
-                    ParseError::ErrorType::InvalidArchive,
-                    std::move(*std::get_if<Archive::LibArchiveError>(&contents.error()))));
+            std::string pathname = archive_entry_pathname(*header);
+
+            if (!pathname.ends_with(".PKGINFO") && !pathname.starts_with("/.")) {
+                if (create_files) {
+                    files << archive_entry_pathname(*header) << "\n";
+                }
+                continue;
+            }
+            found = true;
+
+            auto contents = entry.read_all();
+
+            if (!contents.has_value()) {
+                if (auto const invalidentry =
+                        std::get_if<Archive::InvalidEntryError>(&contents.error())) {
+                    return std::unexpected(ParseError(ParseError::ErrorType::InvalidArchive,
+                                                      std::move(*invalidentry)));
+                } else {
+                    return std::unexpected(ParseError(
+                        ParseError::ErrorType::InvalidArchive,
+                        std::move(*std::get_if<Archive::LibArchiveError>(&contents.error()))));
+                }
+            }
+
+            package_info.parse(
+                std::string_view {reinterpret_cast<char*>(contents->data()), contents->size()});
+
+            if (!create_files) {
+                break;
             }
         }
 
-        package_info.parse(
-            std::string_view {reinterpret_cast<char*>(contents->data()), contents->size()});
+        if (!found) {
+            return std::unexpected(ParseError(ParseError::ErrorType::NoPackageInfo));
+        }
 
-        if (!create_files) {
-            break;
+        // The rest of the package is only needed for the checksums
+        auto const size = file_reader.drain();
+        if (!size.has_value()) {
+            return std::unexpected(
+                ParseError(ParseError::ErrorType::InvalidArchive, std::move(size.error())));
         }
-    }
 
-    if (!found) {
-        return std::unexpected(ParseError(ParseError::ErrorType::NoPackageInfo));
+        DescFormatter formatter {
+            std::move(package_info), filepath, signature,
+            PackageDigest {.size = *size, .md5 = md5.hex_digest(), .sha256 = sha256.hex_digest()}};
+
+        return Desc(formatter.format(), files.str());
     }
 
-    DescFormatter formatter {package_info, filepath, signature};
+} // namespace
 
-    desc << formatter.format();
+Desc::Result<Desc> Desc::parse_package(std::filesystem::path const& filepath,
+                                       std::string const& signature,
+                                       bool create_files) {
+    return read_package(
+        [&filepath](Archive::Reader& reader, Archive::Reader::BlockObserver observer) {
+            return reader.open_filename(filepath, std::move(observer));
+        },
+        filepath, signature, create_files);
+}
 
-    return Desc {.desc = desc.str(), .files = files.str()};
+Desc::Result<Desc> Desc::parse_package(std::span<uint8_t const> content,
+                                       std::filesystem::path const& filepath,
+                                       std::string const& signature,
+                                       bool create_files,
+                                       Archive::Reader::BlockObserver observer) {
+    return read_package(
+        [&content, &observer](Archive::Reader& reader, Archive::Reader::BlockObserver hash) {
+            return reader.open_memory(content, [&observer, hash = std::move(hash)](
+                                                   std::span<uint8_t const> block) {
+                hash(block);
+                observer(block);
+            });
+        },
+        filepath, signature, create_files);
 }
 
 } // namespace bxt::Utilities::AlpmDb
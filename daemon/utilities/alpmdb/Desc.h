@@ -10,15 +10,20 @@
 #include "utilities/alpmdb/PkgInfo.h"
 #include "utilities/Error.h"
 #include "utilities/errors/Macro.h"
+#include "utilities/libarchive/Reader.h"
 
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/archive/text_oarchive.hpp>
 #include <cereal/access.hpp>
+#include <cstdint>
 #include <expected>
 #include <filesystem>
 #include <memory>
 #include <optional>
+#include <ranges>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace bxt::Utilities::AlpmDb {
@@ -28,10 +33,12 @@ struct Desc {
         enum class ErrorType {
             InvalidArchive,
             NoPackageInfo,
+            StorageError,
         };
 
         ParseError(ErrorType type)
             : error_type(type) {
+            message = error_messages.at(error_type).data();
         }
         explicit ParseError(ErrorType type, bxt::Error const&& source)
             : bxt::Error(std::make_unique<bxt::Error>(std::move(source)))
@@ -43,24 +50,88 @@ struct Desc {
         ErrorType error_type;
 
         // Define the error messages map
-        static constexpr frozen::unordered_map<ErrorType, std::string_view, 2> error_messages = {
+        static constexpr frozen::unordered_map<ErrorType, std::string_view, 3> error_messages = {
             {ErrorType::InvalidArchive, "This file is not a valid archive"},
             {ErrorType::NoPackageInfo, "No package info"},
+            {ErrorType::StorageError, "Can't store the package"},
         };
     };
     BXT_DECLARE_RESULT(ParseError)
 
+    Desc() = default;
+    explicit Desc(std::string desc, std::string files = {})
+        : m_desc(std::move(desc))
+        , m_files(std::move(files)) {
+        index();
+    }
+
     template<class Archive> void serialize(Archive& ar) {
-        ar(desc, files);
+        ar(m_desc, m_files);
+
+        if constexpr (Archive::is_loading::value) {
+            index();
+        }
     }
 
     static Result<Desc> parse_package(std::filesystem::path const& filepath,
                                       std::string const& signature = "",
                                       bool create_files = true);
 
-    std::optional<std::string> get(std::string const& key) const;
+    // Parses a package held in memory and passes every block to the observer as
+    // it's read. The path is where the package is stored, it names the package.
+    static Result<Desc> parse_package(std::span<uint8_t const> content,
+                                      std::filesystem::path const& filepath,
+                                      std::string const& signature,
+                                      bool create_files,
+                                      Archive::Reader::BlockObserver observer);
+
+    // First line of the field's value, a view into desc
+    std::optional<std::string_view> get(std::string_view key) const;
+
+    // All lines of a multi-value field such as DEPENDS, empty if it's missing.
+    // A lazy view over the indexed block, the lines are views into desc.
+    auto values(std::string_view key) const {
+        return block(key).value_or(std::string_view {}) | std::views::split('\n')
+               | std::views::transform([](auto const line) {
+                     return std::string_view(line.begin(), line.end());
+                 });
+    }
+
+    std::string const& desc() const {
+        return m_desc;
+    }
+
+    std::string const& files() const {
+        return m_files;
+    }
+
+    // The fields are indexed again for the new desc
+    void set_desc(std::string desc) {
+        m_desc = std::move(desc);
+        index();
+    }
+
+    void set_files(std::string files) {
+        m_files = std::move(files);
+    }
+
+private:
+    struct Field {
+        uint32_t key_offset = 0;
+        uint32_t key_size = 0;
+        uint32_t value_offset = 0;
+        uint32_t value_size = 0;
+    };
+
+    // Records where the fields are in desc, every change of desc goes through it
+    void index();
+
+    // The value lines of the field, without the blank line closing it
+    std::optional<std::string_view> block(std::string_view key) const;
+
+    std::string m_desc;
+    std::string m_files;
 
-    std::string desc;
-    std::string files;
+    std::vector<Field> m_fields;
 };
 } // namespace bxt::Utilities::AlpmDb
@@ -8,9 +8,6 @@
 #include "DescFormatter.h"
 
 #include "utilities/base64.h"
-#include "utilities/hash_from_file.h"
-
-#include <sstream>
 
 namespace bxt::Utilities::AlpmDb {
 
@@ -18,39 +15,45 @@ namespace bxt::Utilities::AlpmDb {
 // It follows the format used by repo-add.sh in pacman for compatibility:
 // https://gitlab.archlinux.org/pacman/pacman/-/blob/6ba5c20e7629ae9bdd7ceaf5a45484c434363ec5/scripts/repo-add.sh.in#L296-326
 std::string DescFormatter::format() const {
-    std::ostringstream oss;
-    oss << format_entry<"FILENAME">(m_filepath.filename().string());
-    oss << format_pkginfo_entry<"NAME", "pkgname">();
-    oss << format_pkginfo_entry<"BASE", "pkgbase">();
-    oss << format_pkginfo_entry<"VERSION", "pkgver">();
-    oss << format_pkginfo_entry<"DESC", "pkgdesc">();
-    oss << format_pkginfo_entry<"GROUPS", "groups">();
-    oss << format_entry<"CSIZE">(std::to_string(std::filesystem::file_size(m_filepath)));
-    oss << format_pkginfo_entry<"ISIZE", "size">();
+    auto const filename = m_filepath.filename().string();
+    auto const signature =
+        m_signature.empty() ? std::string() : bxt::Utilities::b64_encode(m_signature);
+
+    // Every value comes from .PKGINFO, the file name, the digest or the
+    // signature, with room for the keys
+    fmt::memory_buffer out;
+    out.reserve(m_pkg_info.size() + filename.size() + signature.size() + 512);
+
+    format_entry<"FILENAME">(out, filename);
+    format_pkginfo_entry<"NAME", "pkgname">(out);
+    format_pkginfo_entry<"BASE", "pkgbase">(out);
+    format_pkginfo_entry<"VERSION", "pkgver">(out);
+    format_pkginfo_entry<"DESC", "pkgdesc">(out);
+    format_pkginfo_entry<"GROUPS", "groups">(out);
+    auto const compressed_size = fmt::format_int(m_digest.size);
+    format_entry<"CSIZE">(out, {compressed_size.data(), compressed_size.size()});
+    format_pkginfo_entry<"ISIZE", "size">(out);
 
     // add checksums
-    oss << format_entry<"MD5SUM">(bxt::hash_from_file<MD5, MD5_DIGEST_LENGTH>(m_filepath.string()));
+    format_entry<"MD5SUM">(out, m_digest.md5);
 
-    oss << format_entry<"SHA256SUM">(
-        bxt::hash_from_file<SHA256, SHA256_DIGEST_LENGTH>(m_filepath.string()));
+    format_entry<"SHA256SUM">(out, m_digest.sha256);
 
     // add PGP sig
-    if (!m_signature.empty()) {
-        oss << format_entry<"PGPSIG">(bxt::Utilities::b64_encode(m_signature));
-    }
-
-    oss << format_pkginfo_entry<"URL", "url">();
-    oss << format_pkginfo_entry<"LICENSE", "license">();
-    oss << format_pkginfo_entry<"ARCH", "arch">();
-    oss << format_pkginfo_entry<"BUILDDATE", "builddate">();
-    oss << format_pkginfo_entry<"PACKAGER", "packager">();
-    oss << format_pkginfo_entry<"REPLACES", "replaces">();
-    oss << format_pkginfo_entry<"CONFLICTS", "conflict">();
-    oss << format_pkginfo_entry<"PROVIDES", "provides">();
-    oss << format_pkginfo_entry<"DEPENDS", "depend">();
-    oss << format_pkginfo_entry<"OPTDEPENDS", "optdepend">();
-    oss << format_pkginfo_entry<"MAKEDEPENDS", "makedepend">();
-    oss << format_pkginfo_entry<"CHECKDEPENDS", "checkdepend">();
-    return oss.str();
+    format_entry<"PGPSIG">(out, signature);
+
+    format_pkginfo_entry<"URL", "url">(out);
+    format_pkginfo_entry<"LICENSE", "license">(out);
+    format_pkginfo_entry<"ARCH", "arch">(out);
+    format_pkginfo_entry<"BUILDDATE", "builddate">(out);
+    format_pkginfo_entry<"PACKAGER", "packager">(out);
+    format_pkginfo_entry<"REPLACES", "replaces">(out);
+    format_pkginfo_entry<"CONFLICTS", "conflict">(out);
+    format_pkginfo_entry<"PROVIDES", "provides">(out);
+    format_pkginfo_entry<"DEPENDS", "depend">(out);
+    format_pkginfo_entry<"OPTDEPENDS", "optdepend">(out);
+    format_pkginfo_entry<"MAKEDEPENDS", "makedepend">(out);
+    format_pkginfo_entry<"CHECKDEPENDS", "checkdepend">(out);
+    return fmt::to_string(out);
 }
 } // namespace bxt::Utilities::AlpmDb
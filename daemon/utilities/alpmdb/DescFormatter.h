@@ -9,46 +9,75 @@
 #include "utilities/alpmdb/PkgInfo.h"
 #include "utilities/FixedString.h"
 
-#include <boost/algorithm/string/join.hpp>
+#include <cstdint>
 #include <filesystem>
 #include <fmt/format.h>
-#include <openssl/md5.h>
-#include <openssl/sha.h>
 #include <string>
+#include <string_view>
 
 namespace bxt::Utilities::AlpmDb {
+
+// Size and checksums of the package file, computed while it's read
+struct PackageDigest {
+    uint64_t size = 0;
+    std::string md5;
+    std::string sha256;
+};
+
 class DescFormatter {
 public:
-    DescFormatter(PkgInfo m_pkg_info, std::filesystem::path m_filepath, std::string m_signature)
+    DescFormatter(PkgInfo m_pkg_info,
+                  std::filesystem::path m_filepath,
+                  std::string m_signature,
+                  PackageDigest m_digest)
         : m_pkg_info(std::move(m_pkg_info))
         , m_filepath(std::move(m_filepath))
-        , m_signature(std::move(m_signature)) {
+        , m_signature(std::move(m_signature))
+        , m_digest(std::move(m_digest)) {
     }
 
-    static constexpr char format_string[] = "%{}%\n{}\n\n";
-
     template<FixedString desc_field, FixedString pkginfo_field>
-    std::string format_pkginfo_entry() const {
-        auto values = m_pkg_info.values(pkginfo_field.buf);
+    void format_pkginfo_entry(fmt::memory_buffer& out) const {
+        auto values = m_pkg_info.values(std::string_view(pkginfo_field.buf));
         if (values.empty()) {
-            return "";
+            return;
         }
 
-        return fmt::format(format_string, desc_field.buf, boost::join(values, "\n"));
+        append_key<desc_field>(out);
+        for (auto const value : values) {
+            append(out, value);
+            out.push_back('\n');
+        }
+        out.push_back('\n');
     }
-    template<FixedString desc_field> std::string format_entry(std::string const& value) const {
+    template<FixedString desc_field>
+    void format_entry(fmt::memory_buffer& out, std::string_view value) const {
         if (value.empty()) {
-            return "";
+            return;
         }
-        return fmt::format(format_string, desc_field.buf, value);
+
+        append_key<desc_field>(out);
+        append(out, value);
+        append(out, "\n\n");
     }
 
     std::string format() const;
 
 private:
+    static void append(fmt::memory_buffer& out, std::string_view value) {
+        out.append(value.data(), value.data() + value.size());
+    }
+
+    template<FixedString desc_field> static void append_key(fmt::memory_buffer& out) {
+        out.push_back('%');
+        append(out, desc_field.buf);
+        append(out, "%\n");
+    }
+
     PkgInfo m_pkg_info;
     std::filesystem::path m_filepath;
     std::string m_signature;
+    PackageDigest m_digest;
 };
 
 } // namespace bxt::Utilities::AlpmDb
@@ -0,0 +1,155 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "ParsedPackageCache.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bxt::Utilities::AlpmDb {
+
+Desc::Result<std::shared_ptr<Desc const>>
+    ParsedPackageCache::parse(std::filesystem::path const& filepath,
+                              std::string const& signature,
+                              bool create_files) {
+    struct stat file_stat {};
+
+    if (::stat(filepath.c_str(), &file_stat) != 0) {
+        auto desc = Desc::parse_package(filepath, signature, create_files);
+        if (!desc.has_value()) {
+            return std::unexpected(std::move(desc.error()));
+        }
+        return std::make_shared<Desc const>(std::move(*desc));
+    }
+
+    auto key = make_key(filepath, file_stat, signature, create_files);
+
+    {
+        std::lock_guard lock(m_mutex);
+        if (auto it = m_artifacts.find(key); it != m_artifacts.end()) {
+            return it->second;
+        }
+    }
+
+    auto desc = Desc::parse_package(filepath, signature, create_files);
+    if (!desc.has_value()) {
+        return std::unexpected(std::move(desc.error()));
+    }
+
+    auto artifact = std::make_shared<Desc const>(std::move(*desc));
+
+    remember(std::move(key), artifact);
+
+    return artifact;
+}
+
+Desc::Result<std::shared_ptr<Desc const>>
+    ParsedPackageCache::stage(std::span<uint8_t const> content,
+                              std::filesystem::path const& filepath,
+                              std::string const& signature,
+                              bool create_files) {
+    auto const storage_error = [&filepath](int error) {
+        ::unlink(filepath.c_str());
+
+        Desc::ParseError result(Desc::ParseError::ErrorType::StorageError);
+        result.message = fmt::format("Can't store {}: {}", filepath.string(), std::strerror(error));
+
+        return std::unexpected(std::move(result));
+    };
+
+    auto const descriptor =
+        ::open(filepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (descriptor < 0) {
+        return storage_error(errno);
+    }
+
+    // Blocks are written as the parser reads them
+    int write_error = 0;
+    auto desc = Desc::parse_package(
+        content, filepath, signature, create_files,
+        [descriptor, &write_error](std::span<uint8_t const> block) {
+            while (!block.empty() && write_error == 0) {
+                auto const written = ::write(descriptor, block.data(), block.size());
+                if (written < 0 && errno != EINTR) {
+                    write_error = errno;
+                } else if (written > 0) {
+                    block = block.subspan(static_cast<size_t>(written));
+                }
+            }
+        });
+
+    struct stat file_stat {};
+    if (::fstat(descriptor, &file_stat) != 0 && write_error == 0) {
+        write_error = errno;
+    }
+
+    if (::close(descriptor) != 0 && write_error == 0) {
+        write_error = errno;
+    }
+
+    if (write_error != 0) {
+        return storage_error(write_error);
+    }
+
+    if (!desc.has_value()) {
+        ::unlink(filepath.c_str());
+        return std::unexpected(std::move(desc.error()));
+    }
+
+    auto artifact = std::make_shared<Desc const>(std::move(*desc));
+
+    remember(make_key(filepath, file_stat, signature, create_files), artifact);
+
+    return artifact;
+}
+
+coro::task<Desc::Result<std::shared_ptr<Desc const>>>
+    ParsedPackageCache::stage_async(std::span<uint8_t const> content,
+                                    std::filesystem::path filepath,
+                                    std::string signature,
+                                    bool create_files) {
+    co_await m_stage_pool->schedule();
+
+    co_return stage(content, filepath, signature, create_files);
+}
+
+ParsedPackageCache::Key ParsedPackageCache::make_key(std::filesystem::path const& filepath,
+                                                     struct stat const& file_stat,
+                                                     std::string const& signature,
+                                                     bool create_files) {
+    return {.path = filepath.string(),
+            .device = file_stat.st_dev,
+            .inode = file_stat.st_ino,
+            .mtime_ns = static_cast<int64_t>(file_stat.st_mtim.tv_sec) * 1'000'000'000
+                        + file_stat.st_mtim.tv_nsec,
+            .size = static_cast<uintmax_t>(file_stat.st_size),
+            .signature_hash = std::hash<std::string> {}(signature),
+            .create_files = create_files};
+}
+
+void ParsedPackageCache::remember(Key key, std::shared_ptr<Desc const> const& artifact) {
+    std::lock_guard lock(m_mutex);
+    if (m_artifacts.try_emplace(key, artifact).second) {
+        m_insertion_order.push_back(std::move(key));
+    }
+
+    while (m_insertion_order.size() > m_capacity) {
+        m_artifacts.erase(m_insertion_order.front());
+        m_insertion_order.pop_front();
+    }
+}
+
+void ParsedPackageCache::clear() {
+    std::lock_guard lock(m_mutex);
+    m_artifacts.clear();
+    m_insertion_order.clear();
+}
+
+} // namespace bxt::Utilities::AlpmDb
@@ -0,0 +1,100 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "parallel_hashmap/phmap.h"
+#include "parallel_hashmap/phmap_utils.h"
+#include "utilities/alpmdb/Desc.h"
+
+#include <algorithm>
+#include <coro/task.hpp>
+#include <coro/thread_pool.hpp>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <thread>
+
+namespace bxt::Utilities::AlpmDb {
+
+// Keeps the result of Desc::parse_package for recently ingested files so the
+// package archive is decompressed and hashed once no matter how many times it
+// gets mapped during a single deployment/commit.
+class ParsedPackageCache {
+public:
+    struct Key {
+        std::string path;
+        dev_t device;
+        ino_t inode;
+        int64_t mtime_ns;
+        uintmax_t size;
+        size_t signature_hash;
+        bool create_files;
+
+        bool operator==(Key const& other) const = default;
+
+        friend size_t hash_value(Key const& key) {
+            return phmap::HashState().combine(0, key.path, key.device, key.inode,
+                                              key.mtime_ns, key.size, key.signature_hash,
+                                              key.create_files);
+        }
+    };
+
+    explicit ParsedPackageCache(size_t capacity = 256)
+        : m_capacity(capacity) {
+    }
+
+    // Returns the cached artifact if the file is unchanged since the last parse,
+    // parses it otherwise. Artifacts are immutable and shared between callers.
+    Desc::Result<std::shared_ptr<Desc const>> parse(std::filesystem::path const& filepath,
+                                                    std::string const& signature = "",
+                                                    bool create_files = true);
+
+    // Writes the package to the file path, hashing and parsing it in the same
+    // pass, and keeps the result for the written file. A later parse of the file
+    // is answered from the cache without reading it again.
+    Desc::Result<std::shared_ptr<Desc const>> stage(std::span<uint8_t const> content,
+                                                    std::filesystem::path const& filepath,
+                                                    std::string const& signature = "",
+                                                    bool create_files = true);
+
+    // Runs stage on the staging pool, the caller resumes there. The content has
+    // to stay valid until the task completes.
+    coro::task<Desc::Result<std::shared_ptr<Desc const>>>
+        stage_async(std::span<uint8_t const> content,
+                    std::filesystem::path filepath,
+                    std::string signature = "",
+                    bool create_files = true);
+
+    void clear();
+
+private:
+    static Key make_key(std::filesystem::path const& filepath,
+                        struct stat const& file_stat,
+                        std::string const& signature,
+                        bool create_files);
+
+    void remember(Key key, std::shared_ptr<Desc const> const& artifact);
+
+    size_t m_capacity;
+
+    std::mutex m_mutex;
+    phmap::flat_hash_map<Key, std::shared_ptr<Desc const>> m_artifacts;
+    std::deque<Key> m_insertion_order;
+
+    // Staging decompresses and hashes whole packages, it's kept off the caller's thread
+    std::unique_ptr<coro::thread_pool> m_stage_pool =
+        std::make_unique<coro::thread_pool>(coro::thread_pool::options {
+            .thread_count = std::max(std::thread::hardware_concurrency(), 1U)});
+};
+
+} // namespace bxt::Utilities::AlpmDb
@@ -7,19 +7,21 @@
 #include "PkgInfo.h"
 
 #include <algorithm>
-#include <boost/algorithm/string/regex.hpp>
-#include <iostream>
-#include <regex>
-#include <sstream>
 
 namespace bxt::Utilities::AlpmDb {
 
 void PkgInfo::parse(std::string_view contents) {
+    auto const base = m_contents.size();
+    m_contents.append(contents);
+
+    std::string_view const text = m_contents;
+
     std::string_view line;
-    std::size_t pos = 0, prev_pos = 0;
+    std::size_t pos = base, prev_pos = base;
 
-    while ((pos = contents.find('\n', prev_pos)) != std::string_view::npos) {
-        line = contents.substr(prev_pos, pos - prev_pos);
+    while ((pos = text.find('\n', prev_pos)) != std::string_view::npos) {
+        line = text.substr(prev_pos, pos - prev_pos);
+        auto const line_offset = prev_pos;
         prev_pos = pos + 1;
 
         if (line.starts_with("#")) {
@@ -31,19 +33,17 @@ void PkgInfo::parse(std::string_view contents) {
             continue;
         }
 
-        std::string_view key = line.substr(0, delim_pos);
-        std::string_view value = line.substr(delim_pos + 3);
-
-        m_values[std::string(key)].emplace_back(value);
+        m_entries.emplace_back(Entry {
+            .key_offset = static_cast<uint32_t>(line_offset),
+            .key_size = static_cast<uint32_t>(delim_pos),
+            .value_offset = static_cast<uint32_t>(line_offset + delim_pos + 3),
+            .value_size = static_cast<uint32_t>(line.size() - delim_pos - 3)});
     }
-}
 
-std::vector<std::string> PkgInfo::values(std::string const& key) const {
-    auto it = m_values.find(key);
-    if (it != m_values.end()) {
-        return it->second;
-    }
-    return {};
+    // Stable, so the values of a key keep the order of the file
+    std::ranges::stable_sort(m_entries, {}, [this](Entry const& entry) {
+        return view(entry.key_offset, entry.key_size);
+    });
 }
 
 } // namespace bxt::Utilities::AlpmDb
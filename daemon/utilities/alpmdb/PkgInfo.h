@@ -6,21 +6,54 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <ranges>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
 namespace bxt::Utilities::AlpmDb {
 
+// Keeps the .PKGINFO contents in one buffer and the entries as offsets into
+// it, sorted by key, so values are looked up and read without allocating
 class PkgInfo {
 public:
     PkgInfo() = default;
     void parse(std::string_view contents);
 
-    std::vector<std::string> values(std::string const& key) const;
+    // Views into the contents, valid as long as the object isn't modified
+    auto values(std::string_view key) const {
+        auto const entries = std::ranges::equal_range(m_entries, key, {},
+                                                      [this](Entry const& entry) {
+                                                          return view(entry.key_offset,
+                                                                      entry.key_size);
+                                                      });
+
+        return entries | std::views::transform([this](Entry const& entry) {
+                   return view(entry.value_offset, entry.value_size);
+               });
+    }
+
+    // Size of the parsed contents, a bound for the size of the values
+    size_t size() const {
+        return m_contents.size();
+    }
 
 private:
-    std::unordered_map<std::string, std::vector<std::string>> m_values;
+    struct Entry {
+        uint32_t key_offset = 0;
+        uint32_t key_size = 0;
+        uint32_t value_offset = 0;
+        uint32_t value_size = 0;
+    };
+
+    std::string_view view(uint32_t offset, uint32_t size) const {
+        return std::string_view(m_contents).substr(offset, size);
+    }
+
+    std::string m_contents;
+    std::vector<Entry> m_entries;
 };
 
 } // namespace bxt::Utilities::AlpmDb
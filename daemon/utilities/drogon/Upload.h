@@ -0,0 +1,118 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "utilities/alpmdb/ParsedPackageCache.h"
+
+#include <cstdint>
+#include <drogon/drogon.h>
+#include <drogon/HttpRequest.h>
+#include <drogon/utils/coroutine.h>
+#include <expected>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <trantor/net/EventLoop.h>
+#include <utility>
+#include <vector>
+
+namespace bxt::drogon_helpers {
+
+// Upload names come from the client, only plain file names are accepted so an
+// upload can't be written outside of the upload directory. Hidden names are
+// left to the temporary files of the box.
+inline bool is_safe_file_name(std::string_view file_name) {
+    return !file_name.empty() && !file_name.starts_with('.')
+           && file_name.find_first_of(std::string_view("/\\\0", 3)) == std::string_view::npos;
+}
+
+// The upload directory is the staging directory of the box, uploads are moved
+// into the pool by renaming them
+inline std::expected<std::string, std::string> upload_path(std::string const& file_name) {
+    if (!is_safe_file_name(file_name)) {
+        return std::unexpected(fmt::format("Invalid file name \"{}\"", file_name));
+    }
+
+    return ::drogon::app().getUploadPath() + "/" + file_name;
+}
+
+// Stores an uploaded file as is in the upload directory, for signatures
+inline std::expected<std::string, std::string> save_upload(::drogon::HttpFile const& file) {
+    auto path = upload_path(file.getFileName());
+    if (!path.has_value()) {
+        return path;
+    }
+
+    if (file.saveAs(*path) != 0) {
+        return std::unexpected(fmt::format("Can't store {}", file.getFileName()));
+    }
+
+    return path;
+}
+
+// Files a request staged, removed when the request ends unless a commit took
+// them over. Covers every early return of the controllers.
+class StagedUploads {
+public:
+    StagedUploads() = default;
+    StagedUploads(StagedUploads const&) = delete;
+    StagedUploads& operator=(StagedUploads const&) = delete;
+
+    ~StagedUploads() {
+        std::error_code ec;
+        for (auto const& path : m_paths) {
+            std::filesystem::remove(path, ec);
+        }
+    }
+
+    void add(std::string path) {
+        m_paths.emplace_back(std::move(path));
+    }
+
+    // The files belong to a commit or a deploy session now
+    void release() {
+        m_paths.clear();
+    }
+
+private:
+    std::vector<std::string> m_paths;
+};
+
+// Stores an uploaded package in the staging directory. It's hashed and parsed
+// while it's written, so the commit finds it validated and doesn't read it again.
+// The work runs on the cache's staging pool, the request continues on its loop.
+inline ::drogon::Task<std::expected<std::string, std::string>>
+    stage_package(Utilities::AlpmDb::ParsedPackageCache& cache,
+                  ::drogon::HttpFile const& file,
+                  std::string signature) {
+    auto path = upload_path(file.getFileName());
+    if (!path.has_value()) {
+        co_return path;
+    }
+
+    auto const content = file.fileContent();
+    auto* const loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+
+    auto const staged = co_await cache.stage_async(
+        std::span(reinterpret_cast<uint8_t const*>(content.data()), content.size()), *path,
+        std::move(signature));
+
+    if (loop != nullptr) {
+        co_await ::drogon::switchThreadCoro(loop);
+    }
+
+    if (!staged.has_value()) {
+        co_return std::unexpected(
+            fmt::format("Invalid package {}: {}", file.getFileName(), staged.error().what()));
+    }
+
+    co_return path;
+}
+
+} // namespace bxt::drogon_helpers
@@ -39,6 +39,20 @@ public:
         return header;
     }
 
+    // Same metadata for every entry, so equal contents produce equal archives
+    static Header reproducible_file() {
+        Header header;
+
+        archive_entry_set_filetype(header, AE_IFREG);
+        archive_entry_set_mtime(header, 0, 0);
+        archive_entry_set_perm(header, 0644);
+
+        archive_entry_set_gid(header, 0);
+        archive_entry_set_uid(header, 0);
+
+        return header;
+    }
+
     operator archive_entry*() {
         return m_entry.get();
     }
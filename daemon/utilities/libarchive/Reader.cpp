@@ -8,7 +8,11 @@
 
 #include "utilities/libarchive/Error.h"
 
+#include <algorithm>
 #include <archive.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
 #include <variant>
 
 namespace Archive {
@@ -22,6 +26,115 @@ Reader::Result<void> Reader::open_filename(std::filesystem::path const& path) {
     return {};
 }
 
+// Large enough for the decompressors to work on whole blocks
+constexpr size_t source_block_size = 128 * 1024;
+
+Reader::BlockSource::~BlockSource() {
+    if (descriptor >= 0) {
+        ::close(descriptor);
+    }
+}
+
+std::span<uint8_t const> Reader::BlockSource::next() {
+    std::span<uint8_t const> block;
+
+    if (descriptor < 0) {
+        block = memory.subspan(size, std::min(source_block_size, memory.size() - size));
+    } else {
+        ssize_t actual = 0;
+        do {
+            actual = ::read(descriptor, buffer.data(), buffer.size());
+        } while (actual < 0 && errno == EINTR);
+
+        if (actual < 0) {
+            error = errno;
+            return {};
+        }
+
+        block = std::span<uint8_t const>(buffer.data(), static_cast<size_t>(actual));
+    }
+
+    if (block.empty()) {
+        return {};
+    }
+
+    size += block.size();
+    observer(block);
+
+    return block;
+}
+
+Reader::Result<void> Reader::open_filename(std::filesystem::path const& path,
+                                           BlockObserver observer) {
+    auto source = std::make_unique<BlockSource>();
+    source->descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (source->descriptor < 0) {
+        archive_set_error(m_archive.get(), errno, "Can't open %s", path.c_str());
+        return std::unexpected(LibArchiveError(m_archive.get()));
+    }
+
+    ::posix_fadvise(source->descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    source->observer = std::move(observer);
+    source->buffer.resize(source_block_size);
+
+    return open_source(std::move(source));
+}
+
+Reader::Result<void> Reader::open_memory(std::span<uint8_t const> content,
+                                         BlockObserver observer) {
+    auto source = std::make_unique<BlockSource>();
+    source->memory = content;
+    source->observer = std::move(observer);
+
+    return open_source(std::move(source));
+}
+
+Reader::Result<void> Reader::open_source(std::unique_ptr<BlockSource> source) {
+    m_source = std::move(source);
+
+    // No skip callback: libarchive reads over skipped data instead of seeking past it
+    int status = archive_read_open2(
+        m_archive.get(), m_source.get(), nullptr,
+        [](struct archive* archive, void* data, void const** block) -> la_ssize_t {
+            auto* source = static_cast<BlockSource*>(data);
+
+            auto const read = source->next();
+            if (source->error != 0) {
+                archive_set_error(archive, source->error, "Can't read the archive");
+                return -1;
+            }
+
+            *block = read.data();
+            return static_cast<la_ssize_t>(read.size());
+        },
+        nullptr, nullptr);
+
+    if (status != ARCHIVE_OK) {
+        return std::unexpected(LibArchiveError(m_archive.get()));
+    }
+
+    return {};
+}
+
+Reader::Result<uint64_t> Reader::drain() {
+    if (!m_source) {
+        archive_set_error(m_archive.get(), EINVAL, "The archive isn't read with an observer");
+        return std::unexpected(LibArchiveError(m_archive.get()));
+    }
+
+    while (!m_source->next().empty()) {
+    }
+
+    if (m_source->error != 0) {
+        archive_set_error(m_archive.get(), m_source->error, "Can't read the archive");
+        return std::unexpected(LibArchiveError(m_archive.get()));
+    }
+
+    return m_source->size;
+}
+
 Reader::Result<void> Reader::open_memory(std::vector<uint8_t> const& byte_array) {
     int status = archive_read_open_memory(m_archive.get(), byte_array.data(), byte_array.size());
 
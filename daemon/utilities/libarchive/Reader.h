@@ -14,9 +14,11 @@
 #include <array>
 #include <expected>
 #include <filesystem>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <optional>
+#include <span>
 #include <variant>
 #include <vector>
 
@@ -147,10 +149,25 @@ public:
         archive* m_archive = nullptr;
     };
 
+    // Receives the raw blocks of the file in order, before libarchive decodes them
+    using BlockObserver = std::function<void(std::span<uint8_t const>)>;
+
     Reader() = default;
     BXT_DECLARE_RESULT(LibArchiveError)
 
     Result<void> open_filename(std::filesystem::path const& path);
+
+    // Opens the file so that every byte of it is read exactly once and passed
+    // to the observer. Skipping is disabled to not leave gaps in the stream.
+    Result<void> open_filename(std::filesystem::path const& path, BlockObserver observer);
+
+    // Same for content in memory, the blocks passed are views into it
+    Result<void> open_memory(std::span<uint8_t const> content, BlockObserver observer);
+
+    // Passes the rest of the content opened with an observer, that the archive
+    // wasn't read up to, and returns the size of the whole content
+    Result<uint64_t> drain();
+
     Result<void> open_memory(std::vector<uint8_t> const& byte_array);
     Result<void> open_memory(uint8_t* data, size_t length);
 
@@ -181,6 +198,29 @@ public:
     }
 
 private:
+    // Content read with an observer, either a file or memory
+    struct BlockSource {
+        BlockSource() = default;
+        BlockSource(BlockSource const&) = delete;
+        BlockSource& operator=(BlockSource const&) = delete;
+        ~BlockSource();
+
+        // Reads the next block and passes it to the observer, empty at the end
+        // of the content or on an error
+        std::span<uint8_t const> next();
+
+        int descriptor = -1;
+        std::span<uint8_t const> memory;
+        int error = 0;
+        BlockObserver observer;
+        std::vector<uint8_t> buffer;
+        uint64_t size = 0;
+    };
+
+    Result<void> open_source(std::unique_ptr<BlockSource> source);
+
+    // Declared first so it outlives the archive, which reads from it until freed
+    std::unique_ptr<BlockSource> m_source;
     std::unique_ptr<struct archive, decltype(&archive_read_free)> m_archive {archive_read_new(),
                                                                              archive_read_free};
 };
@@ -36,7 +36,41 @@ Writer::Result<Writer::Entry> Writer::start_write(Header& header) {
     return entry;
 }
 
-Writer::Entry::Result<void> Writer::Entry::write(std::vector<uint8_t> const& data) {
+Writer::Entry::Result<void> Writer::write_entry(Header& header,
+                                               std::initializer_list<std::string_view> pieces) {
+    size_t size = 0;
+    for (auto const& piece : pieces) {
+        size += piece.size();
+    }
+    archive_entry_set_size(header, static_cast<la_int64_t>(size));
+
+    auto entry = start_write(header);
+    if (!entry.has_value()) {
+        return std::unexpected(std::move(entry.error()));
+    }
+
+    for (auto const& piece : pieces) {
+        if (auto written = entry->write(piece); !written) {
+            return written;
+        }
+    }
+
+    return entry->finish();
+}
+
+Writer::Result<void> Writer::close() {
+    if (archive_write_close(m_archive.get()) != ARCHIVE_OK) {
+        return std::unexpected(LibArchiveError(m_archive.get()));
+    }
+
+    return {};
+}
+
+Writer::Entry::Result<void> Writer::Entry::write(std::span<std::byte const> data) {
+    if (!m_writer) {
+        return std::unexpected(InvalidEntryError {});
+    }
+
     auto const status = archive_write_data(m_writer, data.data(), data.size());
 
     if (static_cast<int64_t>(status) < 0) {
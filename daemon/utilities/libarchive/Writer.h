@@ -11,10 +11,14 @@
 #include "utilities/errors/Macro.h"
 
 #include <archive.h>
+#include <cstddef>
 #include <expected>
 #include <filesystem>
+#include <initializer_list>
 #include <memory>
 #include <ostream>
+#include <span>
+#include <string_view>
 #include <variant>
 #include <vector>
 
@@ -33,8 +37,15 @@ public:
 
         template<typename T> using Result = std::expected<T, ArchiveError>;
 
-        // Use the Result template for function return type
-        Result<void> write(std::vector<uint8_t> const& data);
+        // Use the Result template for function return type. Data can be written in
+        // several calls, the pieces are appended to the entry.
+        Result<void> write(std::span<std::byte const> data);
+        Result<void> write(std::string_view data) {
+            return write(std::as_bytes(std::span(data)));
+        }
+        Result<void> write(std::vector<uint8_t> const& data) {
+            return write(std::as_bytes(std::span(data)));
+        }
         Result<void> operator>>(std::vector<uint8_t> const& data);
 
         Result<void> finish() {
@@ -70,6 +81,14 @@ public:
 
     Result<Entry> start_write(Header& header);
 
+    // Writes a whole entry given in consecutive pieces without joining them
+    // first. Sets the size of the header, which can be reused for the next entry.
+    Entry::Result<void> write_entry(Header& header,
+                                    std::initializer_list<std::string_view> pieces);
+
+    // Flushes and closes the output, the archive is only complete after this succeeds
+    Result<void> close();
+
 private:
     static Result<void> deleter(archive* a) {
         int const status = archive_write_free(a);
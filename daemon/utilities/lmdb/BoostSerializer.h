@@ -14,6 +14,7 @@
 #include "utilities/Error.h"
 #include "utilities/errors/Macro.h"
 #include "utilities/lmdb/Error.h"
+#include "utilities/lmdb/ViewStreambuf.h"
 
 #include <boost/archive/archive_exception.hpp>
 #include <boost/archive/text_iarchive.hpp>
@@ -99,7 +100,8 @@ template<typename TSerializable> struct BoostSerializer {
 
     static Result<TSerializable> deserialize(std::string_view value) {
         try {
-            std::stringstream entity_stream((std::string(value)));
+            ViewStreambuf entity_buffer(value);
+            std::istream entity_stream(&entity_buffer);
             boost::archive::text_iarchive entity_archive(entity_stream);
 
             TSerializable result;
@@ -9,12 +9,16 @@
 #include "utilities/Error.h"
 #include "utilities/errors/Macro.h"
 #include "utilities/lmdb/Error.h"
+#include "utilities/lmdb/ViewStreambuf.h"
 
 #include <cereal/archives/binary.hpp>
 #include <cereal/details/helpers.hpp>
 #include <cereal/types/string.hpp>
 #include <filesystem>
+#include <istream>
+#include <optional>
 #include <sstream>
+#include <string_view>
 
 namespace bxt::Utilities::LMDB {
 
@@ -41,9 +45,10 @@ template<typename TSerializable> struct CerealSerializer {
         }
     }
 
-    static Result<TSerializable> deserialize(std::string const& value) {
+    static Result<TSerializable> deserialize(std::string_view value) {
         try {
-            std::stringstream entity_stream(value);
+            ViewStreambuf entity_buffer(value);
+            std::istream entity_stream(&entity_buffer);
             TSerializable result;
             {
                 cereal::BinaryInputArchive entity_archive(entity_stream);
@@ -56,4 +61,24 @@ template<typename TSerializable> struct CerealSerializer {
         }
     }
 };
+
+// Reads a string saved by cereal as a view into the archive's buffer
+inline std::optional<std::string_view> load_string_view(cereal::BinaryInputArchive& archive,
+                                                        ViewStreambuf& buffer) {
+    cereal::size_type size = 0;
+    archive(cereal::make_size_tag(size));
+    return buffer.take(size);
+}
+
+// The bytes of a std::string value stored with CerealSerializer, in place
+inline std::optional<std::string_view> string_view_of(std::string_view value) {
+    try {
+        ViewStreambuf buffer(value);
+        std::istream stream(&buffer);
+        cereal::BinaryInputArchive archive(stream);
+        return load_string_view(archive, buffer);
+    } catch (cereal::Exception const&) {
+        return std::nullopt;
+    }
+}
 }; // namespace bxt::Utilities::LMDB
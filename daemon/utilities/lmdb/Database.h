@@ -14,12 +14,16 @@
 #include "utilities/errors/Macro.h"
 #include "utilities/lmdb/CerealSerializer.h"
 #include "utilities/lmdb/Error.h"
+#include "utilities/lmdb/ViewStreambuf.h"
 #include "utilities/log/Logging.h"
 #include "utilities/NavigationAction.h"
 
 #include <exception>
 #include <lmdbxx/lmdb++.h>
+#include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 namespace bxt::Utilities::LMDB {
 
 template<typename TEntity, typename TSerializer = CerealSerializer<TEntity>> class Database {
@@ -27,8 +31,11 @@ public:
     using Serializer = TSerializer;
     BXT_DECLARE_RESULT(bxt::DatabaseError)
 
-    Database(std::shared_ptr<Environment> env, std::string_view name = "")
-        : m_env(env) {
+    Database(std::shared_ptr<Environment> env,
+             std::string_view name = "",
+             TSerializer serializer = {})
+        : m_env(env)
+        , m_serializer(std::move(serializer)) {
         auto txn = coro::sync_wait(m_env->begin_rw_txn());
 
         m_dbi = name.empty() ? lmdb::dbi::open(txn->value, nullptr, MDB_CREATE)
@@ -39,7 +46,7 @@ public:
     coro::task<Result<bool>> put(lmdb::txn& txn, std::string_view key, TEntity const value) {
         bool result;
         try {
-            auto value_string = TSerializer::serialize(value);
+            auto value_string = m_serializer.serialize(value);
 
             if (!value_string.has_value()) {
                 co_return bxt::make_error_with_source<DatabaseError>(
@@ -47,7 +54,7 @@ public:
                     DatabaseError::ErrorType::DatabaseMalformedError);
             }
 
-            result = m_dbi.put(txn, key, *value_string);
+            result = m_env->put(txn, m_dbi.handle(), key, *value_string);
 
         } catch (lmdb::error const& err) {
             loge("LMDB::Database::put: {}", err.what());
@@ -61,10 +68,48 @@ public:
         co_return result;
     }
 
+    // Writes entries sorted by key, appending at the end of the tree while the
+    // keys are past the last stored one
+    coro::task<Result<void>>
+        put_sorted(lmdb::txn& txn, std::vector<std::pair<std::string, TEntity>> const& entries) {
+        try {
+            std::string last_stored_key;
+            bool appending = false;
+            {
+                auto cursor = lmdb::cursor::open(txn, m_dbi);
+
+                std::string_view last_key;
+                std::string_view last_value;
+                appending = !cursor.get(last_key, last_value, MDB_LAST);
+                last_stored_key = last_key;
+            }
+
+            for (auto const& [key, value] : entries) {
+                auto value_string = m_serializer.serialize(value);
+
+                if (!value_string.has_value()) {
+                    co_return bxt::make_error_with_source<DatabaseError>(
+                        std::move(value_string.error()),
+                        DatabaseError::ErrorType::DatabaseMalformedError);
+                }
+
+                appending = appending || key > last_stored_key;
+
+                m_env->put(txn, m_dbi.handle(), key, *value_string, appending ? MDB_APPEND : 0);
+            }
+        } catch (lmdb::error const& err) {
+            loge("LMDB::Database::put_sorted: {}", err.what());
+            co_return bxt::make_error_with_source<DatabaseError>(
+                LMDB::Error(std::move(err)), DatabaseError::ErrorType::DatabaseMalformedError);
+        }
+
+        co_return {};
+    }
+
     coro::task<Result<bool>> del(lmdb::txn& txn, std::string_view key) {
         bool result;
         try {
-            result = m_dbi.del(txn, key);
+            result = m_env->del(txn, m_dbi.handle(), key);
 
         } catch (lmdb::error const& err) {
             co_return bxt::make_error_with_source<DatabaseError>(
@@ -77,6 +122,18 @@ public:
         co_return result;
     }
 
+    coro::task<Result<bool>> contains(lmdb::txn& txn, std::string_view key) {
+        try {
+            std::string_view value_string;
+
+            co_return m_dbi.get(txn, key, value_string);
+
+        } catch (lmdb::error const& err) {
+            co_return bxt::make_error_with_source<DatabaseError>(
+                LMDB::Error(std::move(err)), DatabaseError::ErrorType::DatabaseMalformedError);
+        }
+    }
+
     coro::task<Result<TEntity>> get(lmdb::txn& txn, std::string_view key) {
         try {
             std::string_view value_string;
@@ -85,7 +142,7 @@ public:
                 co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::EntityNotFound);
             }
 
-            auto result = TSerializer::deserialize(std::string(value_string));
+            auto result = decode(value_string);
 
             if (!result.has_value()) {
                 co_return bxt::make_error_with_source<DatabaseError>(
@@ -123,7 +180,7 @@ public:
             }
 
             do {
-                auto res = TSerializer::deserialize(std::string(value));
+                auto res = decode(value);
 
                 if (!res.has_value()) {
                     co_return bxt::make_error_with_source<DatabaseError>(
@@ -157,8 +214,22 @@ public:
         return m_env;
     };
 
+    TSerializer const& serializer() const {
+        return m_serializer;
+    }
+
 private:
+    // Values are decoded in place from the mapped page when the serializer allows it
+    auto decode(std::string_view value) const {
+        if constexpr (ViewDeserializer<TSerializer>) {
+            return m_serializer.deserialize(value);
+        } else {
+            return m_serializer.deserialize(std::string(value));
+        }
+    }
+
     std::shared_ptr<Environment> m_env;
+    TSerializer m_serializer;
     lmdb::dbi m_dbi;
 };
 
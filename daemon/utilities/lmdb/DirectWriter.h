@@ -0,0 +1,46 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <lmdbxx/lmdb++.h>
+#include <optional>
+#include <string_view>
+
+namespace bxt::Utilities::LMDB {
+
+// Same writes as Environment's, straight into the txn without a journal. For
+// tools like dbcli that open the database without an Environment.
+struct DirectWriter {
+    bool put(lmdb::txn& txn,
+             MDB_dbi dbi,
+             std::string_view key,
+             std::string_view value,
+             unsigned int flags = 0) {
+        MDB_val key_value {key.size(), const_cast<char*>(key.data())};
+        MDB_val data {value.size(), const_cast<char*>(value.data())};
+        return lmdb::dbi_put(txn.handle(), dbi, &key_value, &data, flags);
+    }
+
+    bool del(lmdb::txn& txn,
+             MDB_dbi dbi,
+             std::string_view key,
+             std::optional<std::string_view> value = std::nullopt) {
+        MDB_val key_value {key.size(), const_cast<char*>(key.data())};
+        if (!value) {
+            return lmdb::dbi_del(txn.handle(), dbi, &key_value, nullptr);
+        }
+
+        MDB_val data {value->size(), const_cast<char*>(value->data())};
+        return lmdb::dbi_del(txn.handle(), dbi, &key_value, &data);
+    }
+
+    void drop(lmdb::txn& txn, MDB_dbi dbi) {
+        lmdb::dbi_drop(txn.handle(), dbi, false);
+    }
+};
+
+} // namespace bxt::Utilities::LMDB
@@ -0,0 +1,289 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "Environment.h"
+
+#include "utilities/log/Logging.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace bxt::Utilities::LMDB {
+
+namespace {
+    constexpr size_t MiB = 1024UL * 1024UL;
+} // namespace
+
+void Environment::open(LMDBOptions const& options) {
+    m_growth_step = std::max<int64_t>(options.map_growth, 1) * MiB;
+
+    m_env.set_mapsize(std::max<int64_t>(options.map_size, 1) * MiB);
+    m_env.set_max_dbs(std::max<int64_t>(options.max_dbs, 1));
+
+    unsigned int flags = MDB_NOTLS;
+    if (options.no_sync) {
+        flags |= MDB_NOSYNC;
+    }
+    if (options.no_meta_sync) {
+        flags |= MDB_NOMETASYNC;
+    }
+    if (options.write_map) {
+        flags |= MDB_WRITEMAP;
+    }
+    if (options.no_read_ahead) {
+        flags |= MDB_NORDAHEAD;
+    }
+
+    m_env.open(options.lmdb_path.c_str(), flags, 0664);
+}
+
+Environment::~Environment() {
+    {
+        std::lock_guard lock(m_sync_mutex);
+        m_stopping = true;
+    }
+    m_sync_stopped.notify_all();
+
+    if (m_sync_thread.joinable()) {
+        m_sync_thread.join();
+    }
+}
+
+void Environment::sync() {
+    try {
+        m_env.sync(true);
+    } catch (lmdb::error const& error) {
+        loge("LMDB: Sync failed, the error is \"{}\"", error.what());
+    }
+}
+
+void Environment::start_periodic_sync(std::chrono::seconds interval) {
+    if (m_sync_thread.joinable()) {
+        return;
+    }
+
+    // A flush can take a while, it's kept away from the threads serving requests
+    m_sync_thread = std::thread([this, interval] {
+        std::unique_lock lock(m_sync_mutex);
+        while (!m_sync_stopped.wait_for(lock, interval, [this] { return m_stopping; })) {
+            lock.unlock();
+            sync();
+            lock.lock();
+        }
+    });
+}
+
+void Environment::release_ro_txn(lmdb::txn&& txn) {
+    // Take ownership so a txn that doesn't fit the pool is freed here, not by the caller
+    lmdb::txn released = std::move(txn);
+    if (released.handle() == nullptr) {
+        return;
+    }
+
+    released.reset();
+    reader_left();
+
+    std::lock_guard lock(m_ro_pool_mutex);
+    if (m_ro_pool.size() < MaxPooledReadTxns) {
+        m_ro_pool.emplace_back(std::move(released));
+    }
+}
+
+lmdb::txn Environment::acquire_ro_txn() {
+    {
+        std::unique_lock lock(m_readers_mutex);
+        // A write waiting to grow the map goes first, it waits a bounded time
+        m_readers_changed.wait(lock, [this] { return !m_draining; });
+        ++m_active_readers;
+    }
+
+    std::optional<lmdb::txn> pooled;
+    {
+        std::lock_guard lock(m_ro_pool_mutex);
+        if (!m_ro_pool.empty()) {
+            pooled.emplace(std::move(m_ro_pool.back()));
+            m_ro_pool.pop_back();
+        }
+    }
+
+    try {
+        if (!pooled) {
+            return lmdb::txn::begin(m_env, nullptr, MDB_RDONLY);
+        }
+
+        pooled->renew();
+        return std::move(*pooled);
+    } catch (...) {
+        reader_left();
+        throw;
+    }
+}
+
+void Environment::reader_left() {
+    std::lock_guard lock(m_readers_mutex);
+    if (--m_active_readers == 0) {
+        m_readers_changed.notify_all();
+    }
+}
+
+bool Environment::put(
+    lmdb::txn& txn, MDB_dbi dbi, std::string_view key, std::string_view value, unsigned int flags) {
+    JournalEntry entry {.operation = JournalEntry::Operation::Put,
+                        .dbi = dbi,
+                        .key = std::string(key),
+                        .value = std::string(value),
+                        .flags = flags};
+
+    auto const result = write(txn, [&] { return apply(txn, entry); });
+    m_journal.emplace_back(std::move(entry));
+
+    return result;
+}
+
+bool Environment::del(lmdb::txn& txn,
+                      MDB_dbi dbi,
+                      std::string_view key,
+                      std::optional<std::string_view> value) {
+    JournalEntry entry {.operation = JournalEntry::Operation::Delete,
+                        .dbi = dbi,
+                        .key = std::string(key),
+                        .value = value.transform([](auto view) { return std::string(view); })};
+
+    auto const result = write(txn, [&] { return apply(txn, entry); });
+    m_journal.emplace_back(std::move(entry));
+
+    return result;
+}
+
+void Environment::drop(lmdb::txn& txn, MDB_dbi dbi) {
+    JournalEntry entry {.operation = JournalEntry::Operation::Drop, .dbi = dbi};
+
+    write(txn, [&] { return apply(txn, entry); });
+    m_journal.emplace_back(std::move(entry));
+}
+
+void Environment::commit(lmdb::txn& txn) {
+    write(txn, [&] {
+        txn.commit();
+        return true;
+    });
+    m_journal.clear();
+}
+
+bool Environment::apply(lmdb::txn& txn, JournalEntry const& entry) {
+    MDB_val key {entry.key.size(), const_cast<char*>(entry.key.data())};
+
+    switch (entry.operation) {
+    case JournalEntry::Operation::Put: {
+        MDB_val value {entry.value->size(), const_cast<char*>(entry.value->data())};
+        return lmdb::dbi_put(txn.handle(), entry.dbi, &key, &value, entry.flags);
+    }
+    case JournalEntry::Operation::Delete: {
+        if (!entry.value) {
+            return lmdb::dbi_del(txn.handle(), entry.dbi, &key, nullptr);
+        }
+
+        MDB_val value {entry.value->size(), const_cast<char*>(entry.value->data())};
+        return lmdb::dbi_del(txn.handle(), entry.dbi, &key, &value);
+    }
+    case JournalEntry::Operation::Drop:
+        lmdb::dbi_drop(txn.handle(), entry.dbi, false);
+        return true;
+    }
+
+    return false;
+}
+
+bool Environment::grow_and_replay(lmdb::txn& txn) {
+    for (size_t attempt = 0; attempt < MaxGrowthAttempts; ++attempt) {
+        // A top-level write txn that failed a commit is already finished,
+        // aborting it again is a no-op for LMDB
+        txn.abort();
+
+        MDB_envinfo info;
+        lmdb::env_info(m_env.handle(), &info);
+
+        // Readers keep the old map mapped, it can only grow once they're done
+        if (!resize(info.me_mapsize + m_growth_step, true)) {
+            return false;
+        }
+
+        txn = lmdb::txn::begin(m_env);
+
+        try {
+            for (auto const& entry : m_journal) {
+                apply(txn, entry);
+            }
+            return true;
+        } catch (lmdb::map_full_error const&) {
+            continue;
+        }
+    }
+
+    return false;
+}
+
+void Environment::ensure_headroom() {
+    MDB_envinfo info;
+    MDB_stat stat;
+    lmdb::env_info(m_env.handle(), &info);
+    lmdb::env_stat(m_env.handle(), &stat);
+
+    size_t pending = 0;
+    {
+        std::lock_guard lock(m_readers_mutex);
+        pending = m_pending_size;
+    }
+
+    auto const used = (info.me_last_pgno + 1) * stat.ms_psize;
+    if (pending <= info.me_mapsize && used + m_growth_step <= info.me_mapsize) {
+        return;
+    }
+
+    // Best effort, the write txn recovers from MDB_MAP_FULL anyway
+    resize(std::max(pending, info.me_mapsize + m_growth_step));
+}
+
+bool Environment::resize(size_t size, bool wait_for_readers) {
+    std::unique_lock lock(m_readers_mutex);
+
+    if (m_active_readers > 0 && wait_for_readers) {
+        logi("LMDB: The map is full, waiting for {} readers to grow it", m_active_readers);
+
+        m_draining = true;
+        m_readers_changed.wait_for(lock, ReaderDrainTimeout,
+                                   [this] { return m_active_readers == 0; });
+    }
+
+    auto const resized = [&] {
+        if (m_active_readers > 0) {
+            if (m_pending_size < size) {
+                logd("LMDB: Map resize postponed until the next write, readers are active");
+            }
+            m_pending_size = std::max(m_pending_size, size);
+            return false;
+        }
+
+        try {
+            m_env.set_mapsize(size);
+            m_pending_size = 0;
+            logi("LMDB: Map size grown to {} MiB", size / MiB);
+            return true;
+        } catch (lmdb::error const& error) {
+            loge("LMDB: Cannot grow the map, the error is \"{}\"", error.what());
+            return false;
+        }
+    }();
+
+    // Lets the readers held back by the wait in
+    if (std::exchange(m_draining, false)) {
+        m_readers_changed.notify_all();
+    }
+
+    return resized;
+}
+
+} // namespace bxt::Utilities::LMDB
@@ -6,45 +6,159 @@
  */
 #pragma once
 
+#include "utilities/lmdb/LMDBOptions.h"
 #include "utilities/locked.h"
 
-#include <coro/io_scheduler.hpp>
+#include <chrono>
+#include <condition_variable>
 #include <coro/mutex.hpp>
-#include <coro/shared_mutex.hpp>
 #include <coro/task.hpp>
+#include <cstddef>
 #include <kangaru/autowire.hpp>
 #include <lmdbxx/lmdb++.h>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 namespace bxt::Utilities::LMDB {
 class Environment {
 public:
-    Environment(std::shared_ptr<coro::io_scheduler> scheduler)
-        : m_env(lmdb::env::create())
-        , m_mutex(scheduler) {
+    // Reset read-only txns kept around for reuse. Requires the env to be opened with MDB_NOTLS
+    // as pooled txns are renewed on whatever thread picks them up.
+    static constexpr size_t MaxPooledReadTxns = 64;
+
+    // How many times a write is retried with a grown map before MDB_MAP_FULL is reported
+    static constexpr size_t MaxGrowthAttempts = 8;
+
+    // How long a write that filled the map waits for the readers to release their
+    // snapshots so the map can grow. New readers wait for it meanwhile.
+    static constexpr std::chrono::seconds ReaderDrainTimeout {30};
+
+    Environment()
+        : m_env(lmdb::env::create()) {
     }
 
+    ~Environment();
+
+    Environment(Environment const&) = delete;
+    Environment& operator=(Environment const&) = delete;
+
+    // Configures and opens the environment, throws lmdb::error on failure
+    void open(LMDBOptions const& options);
+
+    // Flushes commits made without a sync to disk
+    void sync();
+
+    // Flushes on a thread of its own every interval until the environment is destroyed
+    void start_periodic_sync(std::chrono::seconds interval);
+
+    // Only writers are serialized, LMDB allows a single write txn at a time
     coro::task<std::unique_ptr<locked<lmdb::txn>>> begin_rw_txn() {
-        auto result =
-            std::make_unique<locked<lmdb::txn>>(co_await m_mutex.lock(), lmdb::txn::begin(m_env));
+        auto lock = co_await m_write_mutex.lock();
+
+        m_journal.clear();
+        ensure_headroom();
 
-        co_return result;
+        co_return std::make_unique<locked<lmdb::txn>>(std::move(lock), lmdb::txn::begin(m_env));
     }
 
+    // Readers work on their own MVCC snapshot and never wait for the writer,
+    // except while a write that filled the map waits to grow it
     coro::task<std::unique_ptr<locked<lmdb::txn>>> begin_ro_txn() {
-        auto result = std::make_unique<locked<lmdb::txn>>(
-            co_await m_mutex.lock_shared(), lmdb::txn::begin(m_env, nullptr, MDB_RDONLY));
-
-        co_return result;
+        co_return std::make_unique<locked<lmdb::txn>>(std::nullopt, acquire_ro_txn());
     }
 
+    // Gives a finished read-only txn back to the pool instead of freeing it
+    void release_ro_txn(lmdb::txn&& txn);
+
+    // Writes of the current write txn. They are journaled so the txn can be
+    // replayed into a grown map when it hits MDB_MAP_FULL, which makes the growth
+    // transparent to callers: the txn object they hold is replaced in place.
+    // The journal holds a copy of every key and value until the txn finishes,
+    // so a txn costs about twice its payload in memory. Every write of a write
+    // txn has to go through here, a replay would silently lose the others.
+    bool put(lmdb::txn& txn,
+             MDB_dbi dbi,
+             std::string_view key,
+             std::string_view value,
+             unsigned int flags = 0);
+    bool del(lmdb::txn& txn,
+             MDB_dbi dbi,
+             std::string_view key,
+             std::optional<std::string_view> value = std::nullopt);
+    void drop(lmdb::txn& txn, MDB_dbi dbi);
+    void commit(lmdb::txn& txn);
+
     lmdb::env& env() {
         return m_env;
     }
 
 private:
+    struct JournalEntry {
+        enum class Operation { Put, Delete, Drop };
+
+        Operation operation;
+        MDB_dbi dbi;
+        std::string key;
+        std::optional<std::string> value;
+        unsigned int flags = 0;
+    };
+
+    template<typename TOperation> auto write(lmdb::txn& txn, TOperation&& operation) {
+        for (size_t attempt = 0;; ++attempt) {
+            try {
+                return operation();
+            } catch (lmdb::map_full_error const&) {
+                if (attempt >= MaxGrowthAttempts || !grow_and_replay(txn)) {
+                    throw;
+                }
+            }
+        }
+    }
+
+    static bool apply(lmdb::txn& txn, JournalEntry const& entry);
+
+    // Aborts the failed txn, grows the map and replays the journal into a new txn
+    bool grow_and_replay(lmdb::txn& txn);
+
+    // Grows the map ahead of a write txn if it's close to being full or a
+    // growth is still pending
+    void ensure_headroom();
+
+    // Remaps the file with the new size if no reader has a snapshot open.
+    // Otherwise the size is remembered for the next write txn, unless the caller
+    // can't go on without it: then new readers are held back and the active ones
+    // are waited for up to ReaderDrainTimeout.
+    bool resize(size_t size, bool wait_for_readers = false);
+
+    lmdb::txn acquire_ro_txn();
+    void reader_left();
+
     lmdb::env m_env;
-    coro::shared_mutex<coro::io_scheduler> m_mutex;
+    coro::mutex m_write_mutex;
+    size_t m_growth_step = 1024UL * 1024UL * 1024UL;
+
+    // Only touched by the holder of the write mutex
+    std::vector<JournalEntry> m_journal;
+
+    std::mutex m_ro_pool_mutex;
+    std::vector<lmdb::txn> m_ro_pool;
+
+    // Readers with a live snapshot, a resize must not remap the file under them
+    std::mutex m_readers_mutex;
+    std::condition_variable m_readers_changed;
+    size_t m_active_readers = 0;
+    size_t m_pending_size = 0;
+    bool m_draining = false;
+
+    std::mutex m_sync_mutex;
+    std::condition_variable m_sync_stopped;
+    bool m_stopping = false;
+    std::thread m_sync_thread;
 };
 
 } // namespace bxt::Utilities::LMDB
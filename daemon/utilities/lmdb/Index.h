@@ -0,0 +1,111 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "coro/sync_wait.hpp"
+#include "Environment.h"
+#include "lmdb.h"
+#include "utilities/errors/DatabaseError.h"
+#include "utilities/errors/Macro.h"
+#include "utilities/lmdb/Error.h"
+
+#include <lmdbxx/lmdb++.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bxt::Utilities::LMDB {
+
+// Secondary index: a MDB_DUPSORT database mapping an attribute to the keys of
+// the records having it. Kept up to date by the owner inside its write txns.
+class Index {
+public:
+    BXT_DECLARE_RESULT(bxt::DatabaseError)
+
+    Index(std::shared_ptr<Environment> env, std::string_view name)
+        : m_env(env) {
+        auto txn = coro::sync_wait(m_env->begin_rw_txn());
+
+        m_dbi = lmdb::dbi::open(txn->value, name, MDB_CREATE | MDB_DUPSORT);
+
+        txn->value.commit();
+    }
+
+    coro::task<Result<void>>
+        add(lmdb::txn& txn, std::string_view attribute, std::string_view key) {
+        try {
+            m_env->put(txn, m_dbi.handle(), attribute, key, MDB_NODUPDATA);
+        } catch (lmdb::error const& err) {
+            co_return bxt::make_error_with_source<DatabaseError>(
+                LMDB::Error(std::move(err)), DatabaseError::ErrorType::DatabaseMalformedError);
+        }
+
+        co_return {};
+    }
+
+    coro::task<Result<void>>
+        remove(lmdb::txn& txn, std::string_view attribute, std::string_view key) {
+        try {
+            m_env->del(txn, m_dbi.handle(), attribute, key);
+        } catch (lmdb::error const& err) {
+            co_return bxt::make_error_with_source<DatabaseError>(
+                LMDB::Error(std::move(err)), DatabaseError::ErrorType::DatabaseMalformedError);
+        }
+
+        co_return {};
+    }
+
+    coro::task<Result<std::vector<std::string>>> find(lmdb::txn& txn,
+                                                      std::string_view attribute) {
+        std::vector<std::string> result;
+        try {
+            auto cursor = lmdb::cursor::open(txn, m_dbi);
+
+            std::string_view key = attribute;
+            std::string_view value;
+
+            if (!cursor.get(key, value, MDB_SET_KEY)) {
+                co_return result;
+            }
+
+            do {
+                result.emplace_back(value);
+            } while (cursor.get(key, value, MDB_NEXT_DUP));
+
+        } catch (lmdb::error const& err) {
+            co_return bxt::make_error_with_source<DatabaseError>(
+                LMDB::Error(std::move(err)), DatabaseError::ErrorType::DatabaseMalformedError);
+        }
+
+        co_return result;
+    }
+
+    coro::task<Result<void>> clear(lmdb::txn& txn) {
+        try {
+            m_env->drop(txn, m_dbi.handle());
+        } catch (lmdb::error const& err) {
+            co_return bxt::make_error_with_source<DatabaseError>(
+                LMDB::Error(std::move(err)), DatabaseError::ErrorType::DatabaseMalformedError);
+        }
+
+        co_return {};
+    }
+
+    bool empty(lmdb::txn& txn) {
+        return m_dbi.size(txn) == 0;
+    }
+
+    lmdb::dbi& dbi() {
+        return m_dbi;
+    }
+
+private:
+    std::shared_ptr<Environment> m_env;
+    lmdb::dbi m_dbi;
+};
+
+} // namespace bxt::Utilities::LMDB
@@ -9,6 +9,7 @@
 
 #include "utilities/configuration/Configuration.h"
 
+#include <cstdint>
 #include <filesystem>
 namespace bxt::Utilities::LMDB {
 
@@ -17,11 +18,57 @@ struct LMDBOptions {
     virtual ~LMDBOptions() = default;
     std::filesystem::path lmdb_path = "bxtd.lmdb";
 
+    // Initial map size and the step it grows by when it fills up, in MiB
+    int64_t map_size = 50 * 1024;
+    int64_t map_growth = 1024;
+    int64_t max_dbs = 128;
+
+    // Durability modes, see README.md for the trade-offs
+    bool no_sync = false;
+    bool no_meta_sync = false;
+    bool write_map = false;
+    bool no_read_ahead = false;
+
+    // How often unsynced commits are flushed to disk, in seconds
+    int64_t sync_interval = 5;
+
+    // Small writes are grouped into one txn for up to this many milliseconds
+    // or until the batch reaches the given size
+    int64_t group_commit_delay = 2;
+    int64_t group_commit_size = 64;
+
     void serialize(Configuration& config) {
         config.set("lmdb-path", lmdb_path.string());
+        config.set("lmdb-map-size", map_size);
+        config.set("lmdb-map-growth", map_growth);
+        config.set("lmdb-max-dbs", max_dbs);
+        config.set("lmdb-no-sync", no_sync);
+        config.set("lmdb-no-meta-sync", no_meta_sync);
+        config.set("lmdb-write-map", write_map);
+        config.set("lmdb-no-read-ahead", no_read_ahead);
+        config.set("lmdb-sync-interval", sync_interval);
+        config.set("lmdb-group-commit-delay", group_commit_delay);
+        config.set("lmdb-group-commit-size", group_commit_size);
     }
     void deserialize(Configuration const& config) {
         lmdb_path = config.get<std::string>("lmdb-path").value_or(lmdb_path);
+        map_size = config.get<int64_t>("lmdb-map-size").value_or(map_size);
+        map_growth = config.get<int64_t>("lmdb-map-growth").value_or(map_growth);
+        max_dbs = config.get<int64_t>("lmdb-max-dbs").value_or(max_dbs);
+        no_sync = config.get<bool>("lmdb-no-sync").value_or(no_sync);
+        no_meta_sync = config.get<bool>("lmdb-no-meta-sync").value_or(no_meta_sync);
+        write_map = config.get<bool>("lmdb-write-map").value_or(write_map);
+        no_read_ahead = config.get<bool>("lmdb-no-read-ahead").value_or(no_read_ahead);
+        sync_interval = config.get<int64_t>("lmdb-sync-interval").value_or(sync_interval);
+        group_commit_delay =
+            config.get<int64_t>("lmdb-group-commit-delay").value_or(group_commit_delay);
+        group_commit_size =
+            config.get<int64_t>("lmdb-group-commit-size").value_or(group_commit_size);
+    }
+
+    // Unsynced commits need the periodic flusher to bound the loss window
+    bool needs_periodic_sync() const {
+        return (no_sync || no_meta_sync) && sync_interval > 0;
     }
 };
 
@@ -0,0 +1,88 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <ios>
+#include <optional>
+#include <streambuf>
+#include <string_view>
+
+namespace bxt::Utilities::LMDB {
+
+// Read-only streambuf over memory owned by someone else (e.g. an LMDB page),
+// lets stream-based archives decode values without copying them first
+class ViewStreambuf : public std::streambuf {
+public:
+    explicit ViewStreambuf(std::string_view view) {
+        auto* begin = const_cast<char*>(view.data());
+        setg(begin, begin, begin + view.size());
+    }
+
+    // Hands out the next bytes in place instead of copying them
+    std::optional<std::string_view> take(size_t count) {
+        if (static_cast<size_t>(egptr() - gptr()) < count) {
+            return std::nullopt;
+        }
+
+        std::string_view const view(gptr(), count);
+        setg(eback(), gptr() + count, egptr());
+        return view;
+    }
+
+protected:
+    std::streamsize xsgetn(char_type* s, std::streamsize count) override {
+        auto const available = std::min<std::streamsize>(count, egptr() - gptr());
+        std::char_traits<char>::copy(s, gptr(), available);
+        gbump(static_cast<int>(available));
+        return available;
+    }
+
+    pos_type seekoff(off_type offset,
+                     std::ios_base::seekdir direction,
+                     std::ios_base::openmode which = std::ios_base::in) override {
+        if (!(which & std::ios_base::in)) {
+            return pos_type(off_type(-1));
+        }
+
+        char* target = nullptr;
+        switch (direction) {
+        case std::ios_base::beg:
+            target = eback() + offset;
+            break;
+        case std::ios_base::cur:
+            target = gptr() + offset;
+            break;
+        case std::ios_base::end:
+            target = egptr() + offset;
+            break;
+        default:
+            return pos_type(off_type(-1));
+        }
+
+        if (target < eback() || target > egptr()) {
+            return pos_type(off_type(-1));
+        }
+
+        setg(eback(), target, egptr());
+        return pos_type(target - eback());
+    }
+
+    pos_type seekpos(pos_type position, std::ios_base::openmode which) override {
+        return seekoff(off_type(position), std::ios_base::beg, which);
+    }
+};
+
+// Serializers satisfying this can decode straight from the mapped value
+template<typename TSerializer>
+concept ViewDeserializer = requires(TSerializer const& serializer, std::string_view view) {
+    { serializer.deserialize(view) };
+};
+
+} // namespace bxt::Utilities::LMDB
@@ -6,13 +6,12 @@
  */
 #pragma once
 
-#include "coro/io_scheduler.hpp"
-
 #include <coro/mutex.hpp>
-#include <coro/shared_mutex.hpp>
+#include <optional>
 namespace bxt::Utilities {
 template<typename T> struct locked {
-    coro::shared_scoped_lock<coro::io_scheduler> lock;
+    // Empty for values that don't need exclusive access (e.g. read-only txns)
+    std::optional<coro::scoped_lock> lock;
 
     T value;
 };
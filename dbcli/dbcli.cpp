@@ -5,7 +5,11 @@
  *
  */
 #include "persistence/box/record/PackageRecord.h"
+#include "persistence/box/record/PackageRecordSerializer.h"
+#include "persistence/box/record/RecordMigration.h"
+#include "persistence/box/record/SectionRegistry.h"
 #include "utilities/lmdb/CerealSerializer.h"
+#include "utilities/lmdb/DirectWriter.h"
 #include "utilities/to_string.h"
 
 #include <coro/io_scheduler.hpp>
@@ -17,17 +21,41 @@
 #include <lmdbxx/lmdb++.h>
 #include <string>
 
-using Serializer = bxt::Utilities::LMDB::CerealSerializer<bxt::Persistence::Box::PackageRecord>;
+using Serializer = bxt::Persistence::Box::PackageRecordSerializer;
+using bxt::Persistence::Box::SectionRegistry;
 
-int validate_and_rebuild(lmdb::txn& transaction, lmdb::dbi& db, bool rebuild_descfile = false) {
+// Human readable form of both binary and legacy text keys
+std::string format_key(SectionRegistry const& registry, std::string_view key) {
+    if (auto id = registry.id_for(key)) {
+        return id->to_string();
+    }
+    return fmt::format("<unknown section>/{}",
+                       key.substr(std::min(key.size(), SectionRegistry::PrefixSize)));
+}
+
+// Accepts keys in the "branch/repository/architecture/name" form
+std::string encode_key(SectionRegistry const& registry, std::string const& text) {
+    if (auto id = bxt::Persistence::Box::PackageRecord::Id::from_string(text)) {
+        if (auto key = registry.key_for(*id)) {
+            return *key;
+        }
+    }
+    return text;
+}
+
+int validate_and_rebuild(lmdb::txn& transaction,
+                         lmdb::dbi& db,
+                         SectionRegistry const& registry,
+                         Serializer const& serializer,
+                         bool rebuild_descfile = false) {
     auto cursor = lmdb::cursor::open(transaction, db);
     std::string_view key, value;
 
     int error_count = 0;
 
     while (cursor.get(key, value, MDB_NEXT)) {
-        fmt::print("Checking record: {}\n", key);
-        auto record = Serializer::deserialize(std::string(value));
+        fmt::print("Checking record: {}\n", format_key(registry, key));
+        auto record = serializer.deserialize(value);
         if (!record) {
             fmt::print(stderr, fg(fmt::terminal_color::red),
                        "{}: Failed to deserialize record: {}\n", record->id.to_string(),
@@ -98,7 +126,7 @@ int validate_and_rebuild(lmdb::txn& transaction, lmdb::dbi& db, bool rebuild_des
                 continue;
             }
 
-            if (desc_result->desc != description.descfile.desc) {
+            if (desc_result->desc() != description.descfile.desc()) {
                 fmt::print(stderr, fg(fmt::terminal_color::red),
                            "{} ({}): Desc-file mismatch for: {}\n", record->id.to_string(),
                            bxt::to_string(location), description.filepath.string());
@@ -112,7 +140,7 @@ int validate_and_rebuild(lmdb::txn& transaction, lmdb::dbi& db, bool rebuild_des
                 // Save db desc file
                 std::ofstream db_file(package_dir / "db");
                 if (db_file.is_open()) {
-                    db_file << description.descfile.desc;
+                    db_file << description.descfile.desc();
                     db_file.close();
                 } else {
                     fmt::print(stderr, fg(fmt::terminal_color::red),
@@ -123,7 +151,7 @@ int validate_and_rebuild(lmdb::txn& transaction, lmdb::dbi& db, bool rebuild_des
                 // Save pkg desc file
                 std::ofstream pkg_file(package_dir / "pkg");
                 if (pkg_file.is_open()) {
-                    pkg_file << desc_result->desc;
+                    pkg_file << desc_result->desc();
                     pkg_file.close();
                 } else {
                     fmt::print(stderr, fg(fmt::terminal_color::red),
@@ -148,12 +176,13 @@ int validate_and_rebuild(lmdb::txn& transaction, lmdb::dbi& db, bool rebuild_des
                 fmt::print("{} ({}): Rebuilding desc-file for: {}\n", record->id.to_string(),
                            bxt::to_string(location), record->id.to_string());
                 description.descfile = std::move(*desc_result);
+                description.extract_fields();
                 needs_update = true;
             }
         }
 
         if (needs_update) {
-            auto serialized = Serializer::serialize(*record);
+            auto serialized = serializer.serialize(*record);
             if (!serialized) {
                 fmt::print(stderr, fg(fmt::terminal_color::red),
                            "{}: Failed to serialize record: {}\n", record->id.to_string(),
@@ -162,13 +191,20 @@ int validate_and_rebuild(lmdb::txn& transaction, lmdb::dbi& db, bool rebuild_des
             }
 
             try {
-                auto new_key = record->id.to_string();
+                auto new_key = registry.key_for(record->id);
+                if (!new_key) {
+                    fmt::print(stderr, fg(fmt::terminal_color::red),
+                               "{}: Section has no id, run migrate first\n",
+                               record->id.to_string());
+                    return 1;
+                }
 
                 cursor.del();
 
-                db.put(transaction, new_key, *serialized);
+                db.put(transaction, *new_key, *serialized);
 
-                fmt::print(fg(fmt::terminal_color::green), "{}: Updated\n", new_key);
+                fmt::print(fg(fmt::terminal_color::green), "{}: Updated\n",
+                           record->id.to_string());
 
             } catch (std::exception const& e) {
                 fmt::print(stderr, fg(fmt::terminal_color::red),
@@ -180,7 +216,55 @@ int validate_and_rebuild(lmdb::txn& transaction, lmdb::dbi& db, bool rebuild_des
     return error_count;
 }
 
+int migrate(lmdb::txn& transaction,
+            lmdb::dbi& db,
+            SectionRegistry& registry,
+            Serializer const& serializer) {
+    bxt::Utilities::LMDB::DirectWriter writer;
+    auto const result =
+        bxt::Persistence::Box::migrate_records_v2(writer, transaction, db, registry, serializer);
+
+    for (auto const& key : result.failed) {
+        fmt::print(stderr, fg(fmt::terminal_color::red), "{}: Failed to migrate record\n", key);
+    }
+
+    if (!result.failed.empty()) {
+        return 1;
+    }
+
+    // Indexes reference the old keys, the daemon rebuilds them when empty
+    for (auto const* name : {"bxt::Box::ByName", "bxt::Box::ByPoolPath"}) {
+        auto index = lmdb::dbi::open(transaction, name, MDB_CREATE | MDB_DUPSORT);
+        lmdb::dbi_drop(transaction, index.handle(), false);
+    }
+
+    auto version = bxt::Utilities::LMDB::CerealSerializer<std::string>::serialize(
+        std::to_string(Serializer::SchemaVersion));
+    if (!version) {
+        return 1;
+    }
+
+    auto meta = lmdb::dbi::open(transaction, "bxt::Box::Meta", MDB_CREATE);
+    meta.put(transaction, "schema-version", *version);
+
+    fmt::print(fg(fmt::terminal_color::green), "Migrated {} records to schema v{}.\n",
+               result.migrated, Serializer::SchemaVersion);
+
+    return 0;
+}
+
 int main(int argc, char** argv) {
+    std::filesystem::path box_path = "box";
+    if (argc >= 3 && std::string_view(argv[1]) == "--box-path") {
+        box_path = argv[2];
+        argv[2] = argv[0];
+        argc -= 2;
+        argv += 2;
+    }
+
+    // Stored pool paths are relative to the box root
+    Serializer const serializer(std::filesystem::weakly_canonical(box_path));
+
     auto lmdbenv = lmdb::env::create();
 
     lmdbenv.set_mapsize(50UL * 1024UL * 1024UL * 1024UL);
@@ -197,36 +281,40 @@ int main(int argc, char** argv) {
     auto transaction = lmdb::txn::begin(lmdbenv);
     auto db = lmdb::dbi::open(transaction, "bxt::Box");
 
+    SectionRegistry registry(lmdb::dbi::open(transaction, "bxt::Box::Sections", MDB_CREATE));
+    registry.load(transaction);
+
     if (argc < 2) {
-        fmt::print("Usage: {} <command> [options]\n", argv[0]);
+        fmt::print("Usage: {} [--box-path <path>] <command> [options]\n", argv[0]);
         return 1;
     }
 
     std::string command = argv[1];
     if (command == "list") {
         auto cursor = lmdb::cursor::open(transaction, db);
-        if (argc >= 3) {
-            std::string_view key = argv[2];
-            if (!cursor.get(key, MDB_SET_RANGE) || !key.starts_with(argv[2])) {
-                fmt::print(stderr, "No packages found with prefix {}\n", key);
-                return 1;
-            }
-            do {
-                fmt::print("{}\n", key);
-            } while (cursor.get(key, MDB_NEXT) && key.starts_with(argv[2]));
-        } else {
-            std::string_view key;
-            while (cursor.get(key, MDB_NEXT)) {
-                fmt::print("{}\n", key);
+        std::string_view const prefix = argc >= 3 ? argv[2] : "";
+
+        bool found = false;
+        std::string_view key;
+        while (cursor.get(key, MDB_NEXT)) {
+            auto const formatted = format_key(registry, key);
+            if (formatted.starts_with(prefix)) {
+                fmt::print("{}\n", formatted);
+                found = true;
             }
         }
+
+        if (!found && !prefix.empty()) {
+            fmt::print(stderr, "No packages found with prefix {}\n", prefix);
+            return 1;
+        }
     } else if (command == "get") {
         if (argc != 3) {
             fmt::print(stderr, "Usage: {} get <key>\n", argv[0]);
             return 1;
         }
 
-        std::string key = argv[2];
+        std::string key = encode_key(registry, argv[2]);
         std::string_view data;
         auto result = db.get(transaction, key, data);
         if (!result) {
@@ -234,7 +322,7 @@ int main(int argc, char** argv) {
             return 1;
         }
 
-        auto const package = Serializer::deserialize(std::string(data));
+        auto const package = serializer.deserialize(data);
         if (!package.has_value()) {
             fmt::print(stderr, "Failed to deserialize package.\n");
             return 1;
@@ -246,7 +334,7 @@ int main(int argc, char** argv) {
             fmt::print("==={}===\nFilepath: {}\nSignature path: "
                        "{}\nDescfile:\n\n{}\n",
                        bxt::to_string(key), value.filepath.string(), value.signature_path->string(),
-                       value.descfile.desc);
+                       value.descfile.desc());
         }
     } else if (command == "del") {
         if (argc != 3) {
@@ -254,7 +342,7 @@ int main(int argc, char** argv) {
             return 1;
         }
 
-        std::string_view key = argv[2];
+        std::string key = encode_key(registry, argv[2]);
         auto result = db.del(transaction, key);
         if (result) {
             fmt::print("Value deleted successfully.\n", argv[0]);
@@ -263,7 +351,7 @@ int main(int argc, char** argv) {
         }
     } else if (command == "validate") {
         if (argc == 2) {
-            auto error_count = validate_and_rebuild(transaction, db, false);
+            auto error_count = validate_and_rebuild(transaction, db, registry, serializer, false);
 
             if (error_count == 0) {
                 fmt::print("No errors found.\n");
@@ -277,7 +365,7 @@ int main(int argc, char** argv) {
 
     } else if (command == "rebuild") {
         if (argc == 2) {
-            if (validate_and_rebuild(transaction, db, true) == 0) {
+            if (validate_and_rebuild(transaction, db, registry, serializer, true) == 0) {
                 fmt::print("Successfully rebuilt all packages.\n");
                 transaction.commit();
             } else {
@@ -288,6 +376,19 @@ int main(int argc, char** argv) {
             return 1;
         }
 
+    } else if (command == "migrate") {
+        if (argc == 2) {
+            if (migrate(transaction, db, registry, serializer) == 0) {
+                transaction.commit();
+            } else {
+                fmt::print(stderr, "Failed to migrate packages, nothing was changed.\n");
+                return 1;
+            }
+        } else {
+            fmt::print(stderr, "Usage: {} migrate\n", argv[0]);
+            return 1;
+        }
+
     } else {
         fmt::print(stderr, "Unknown command: {}\n", command);
         return 1;